@@ -0,0 +1,120 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#include <eosio/chain/block_log.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/program_options.hpp>
+
+#include <iostream>
+
+using namespace eosio::chain;
+namespace bpo = boost::program_options;
+
+/**
+ * Measures the time to rebuild the index of a synthetic block log. The log is made of blocks padded with a
+ * header extension to the requested block size, so a multi-GB log can be generated without running a chain.
+ */
+struct block_log_benchmark {
+    fc::path blocks_dir;
+    uint64_t log_size_mb = 4096;
+    uint32_t block_size = 8192;
+    bool keep = false;
+    fc::path backup_dir;
+
+    void generate() {
+        const uint32_t num_blocks = std::max<uint64_t>(1, log_size_mb * 1024 * 1024 / block_size);
+        ilog("Generating synthetic block log of ${n} blocks in '${d}'", ("n", num_blocks)("d", blocks_dir.generic_string()));
+
+        fc::remove_all(blocks_dir);
+        block_log blog(blocks_dir);
+        blog.reset(genesis_state(), signed_block_ptr());
+
+        block_id_type previous;
+        auto timestamp = block_timestamp_type(fc::time_point::now());
+        for (uint32_t i = 0; i < num_blocks; ++i) {
+            auto b = std::make_shared<signed_block>();
+            b->timestamp = timestamp.next();
+            timestamp = b->timestamp;
+            b->producer = N(eosio);
+            b->previous = previous;
+            b->header_extensions.emplace_back(0, vector<char>(block_size));
+            previous = b->id();
+            blog.append(b);
+        }
+    }
+
+    fc::variant_object run() {
+        const auto block_file = blocks_dir / "blocks.log";
+        const auto index_file = blocks_dir / "blocks.index";
+
+        auto start = fc::time_point::now();
+        block_log::construct_index(block_file, index_file);
+        auto index_time = fc::time_point::now() - start;
+
+        fc::remove_all(index_file);
+        start = fc::time_point::now();
+        backup_dir = block_log::repair_log(blocks_dir);
+        auto repair_time = fc::time_point::now() - start;
+
+        return fc::mutable_variant_object()
+                ("log_size_bytes", fc::file_size(block_file))
+                ("index_entries", fc::file_size(index_file) / sizeof(uint64_t))
+                ("construct_index_us", index_time.count())
+                ("repair_log_us", repair_time.count());
+    }
+};
+
+int main(int argc, char **argv) {
+    bpo::options_description cli("block_log_benchmark command line options");
+    block_log_benchmark bench;
+    std::string dir;
+    cli.add_options()
+            ("blocks-dir", bpo::value<std::string>(&dir)->default_value("block_log_benchmark"),
+             "the directory the synthetic block log is generated in")
+            ("log-size-mb", bpo::value<uint64_t>(&bench.log_size_mb)->default_value(bench.log_size_mb),
+             "the size of the synthetic block log in MiB")
+            ("block-size", bpo::value<uint32_t>(&bench.block_size)->default_value(bench.block_size),
+             "the size of each synthetic block in bytes")
+            ("keep", bpo::bool_switch(&bench.keep)->default_value(false),
+             "keep the generated block log after the run")
+            ("help", "Print this help message and exit.");
+    try {
+        bpo::variables_map vmap;
+        bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+        bpo::notify(vmap);
+        if (vmap.count("help") > 0) {
+            cli.print(std::cerr);
+            return 0;
+        }
+        bench.blocks_dir = fc::absolute(fc::path(dir));
+
+        bench.generate();
+        auto result = bench.run();
+        std::cout << fc::json::to_string(result) << std::endl;
+
+        if (!bench.keep) {
+            fc::remove_all(bench.blocks_dir);
+            fc::remove_all(bench.backup_dir);
+        }
+    } catch (const fc::exception &e) {
+        elog("${e}", ("e", e.to_detail_string()));
+        return -1;
+    } catch (const boost::exception &e) {
+        elog("${e}", ("e", boost::diagnostic_information(e)));
+        return -1;
+    } catch (const std::exception &e) {
+        elog("${e}", ("e", e.what()));
+        return -1;
+    } catch (...) {
+        elog("unknown exception");
+        return -1;
+    }
+    return 0;
+}
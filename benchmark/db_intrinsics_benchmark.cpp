@@ -0,0 +1,226 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#include <eosio/testing/tester.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+using namespace eosio::chain;
+using namespace eosio::testing;
+namespace bpo = boost::program_options;
+
+/**
+ * Contract running one db intrinsic in a loop, selected by the action name: 0 stores ${rows} rows in a primary table
+ * (table 1) with an idx64 (table 2) and an idx128 (table 3) secondary index, 1 runs the loop without any intrinsic,
+ * and the others look the rows up ${lookups} times.
+ */
+static const char db_intrinsics_wast[] = R"=====(
+(module
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_find_i64" (func $db_find_i64 (param i64 i64 i64 i64) (result i32)))
+ (import "env" "db_idx64_store" (func $db_idx64_store (param i64 i64 i64 i64 i32) (result i32)))
+ (import "env" "db_idx64_find_secondary" (func $db_idx64_find_secondary (param i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_idx128_store" (func $db_idx128_store (param i64 i64 i64 i64 i32) (result i32)))
+ (import "env" "db_idx128_find_secondary" (func $db_idx128_find_secondary (param i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_idx128_lowerbound" (func $db_idx128_lowerbound (param i64 i64 i64 i32 i32) (result i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (local $i i64)
+  (local $k i64)
+  (local $n i64)
+  (set_local $n (select (i64.const ${rows}) (i64.const ${lookups}) (i64.eqz (get_local $2))))
+  (block $done
+   (loop $next
+    (br_if $done (i64.ge_u (get_local $i) (get_local $n)))
+    (set_local $k (i64.rem_u (get_local $i) (i64.const ${rows})))
+    (if (i64.eq (get_local $2) (i64.const 5)) (then (set_local $k (i64.const 0))))
+    (i64.store (i32.const 0) (get_local $k))
+    (i64.store (i32.const 16) (get_local $k))
+    (i64.store (i32.const 24) (i64.const 0))
+    (if (i64.eqz (get_local $2)) (then
+     (drop (call $db_store_i64 (get_local $0) (i64.const 1) (get_local $0) (get_local $k) (i32.const 0) (i32.const 8)))
+     (drop (call $db_idx64_store (get_local $0) (i64.const 2) (get_local $0) (get_local $k) (i32.const 0)))
+     (drop (call $db_idx128_store (get_local $0) (i64.const 3) (get_local $0) (get_local $k) (i32.const 16)))
+    ))
+    (if (i64.eq (get_local $2) (i64.const 2)) (then
+     (drop (call $db_find_i64 (get_local $0) (get_local $0) (i64.const 1) (get_local $k)))
+    ))
+    (if (i64.eq (get_local $2) (i64.const 3)) (then
+     (drop (call $db_idx64_find_secondary (get_local $0) (get_local $0) (i64.const 2) (i32.const 0) (i32.const 32)))
+    ))
+    (if (i64.ge_u (get_local $2) (i64.const 4)) (then
+     (if (i64.le_u (get_local $2) (i64.const 5)) (then
+      (drop (call $db_idx128_find_secondary (get_local $0) (get_local $0) (i64.const 3) (i32.const 16) (i32.const 32)))
+     ))
+    ))
+    (if (i64.eq (get_local $2) (i64.const 6)) (then
+     (drop (call $db_idx128_lowerbound (get_local $0) (get_local $0) (i64.const 3) (i32.const 16) (i32.const 32)))
+    ))
+    (set_local $i (i64.add (get_local $i) (i64.const 1)))
+    (br $next)
+   )
+  )
+ )
+)
+)=====";
+
+/**
+ * Measures the per-call cost of the db intrinsics contracts spend most of their time in, once for each wasm runtime.
+ * Every operation runs in its own transaction, which loops over a lookup intrinsic; the time of the same loop without
+ * the intrinsic is subtracted before dividing by the number of calls.
+ */
+struct db_intrinsics_benchmark {
+    uint32_t rows = 500;
+    uint32_t lookups = 2000;
+    uint32_t iterations = 50;
+
+    static const vector<pair<uint64_t, std::string>> &operations() {
+        static const vector<pair<uint64_t, std::string>> ops = {
+                {2, "db_find_i64"},
+                {3, "db_idx64_find_secondary"},
+                {4, "db_idx128_find_secondary"},
+                {5, "db_idx128_find_secondary_same_key"},
+                {6, "db_idx128_lowerbound"}
+        };
+        return ops;
+    }
+
+    std::string contract() const {
+        std::string wast = db_intrinsics_wast;
+        auto replace_all = [&](const std::string &from, const std::string &to) {
+            for (auto pos = wast.find(from); pos != std::string::npos; pos = wast.find(from, pos + to.size()))
+                wast.replace(pos, from.size(), to);
+        };
+        replace_all("${rows}", std::to_string(rows));
+        replace_all("${lookups}", std::to_string(lookups));
+        return wast;
+    }
+
+    controller::config make_config(const fc::path &dir, wasm_interface::vm_type runtime) {
+        controller::config cfg;
+        cfg.blocks_dir = dir / config::default_blocks_dir_name;
+        cfg.state_dir = dir / config::default_state_dir_name;
+        cfg.state_size = 1024ull * 1024 * 1024;
+        cfg.state_guard_size = 0;
+        cfg.reversible_cache_size = 1024 * 1024 * 64;
+        cfg.reversible_guard_size = 0;
+        cfg.genesis.initial_timestamp = fc::time_point::from_iso_string("2020-01-01T00:00:00.000");
+        cfg.genesis.initial_key = base_tester::get_public_key(config::system_account_name, "active");
+        cfg.wasm_runtime = runtime;
+        return cfg;
+    }
+
+    // runs the operation in its own transaction, returning the elapsed time of the action
+    int64_t push(tester &chain, uint64_t op, uint32_t i) {
+        static const name account = N(dbbench);
+        signed_transaction trx;
+        action act;
+        act.account = account;
+        act.name = op;
+        act.authorization = vector<permission_level>{{account, config::active_name}};
+        trx.actions.emplace_back(std::move(act));
+        chain.set_transaction_headers(trx);
+        trx.max_net_usage_words = 100000 + i;
+        trx.sign(base_tester::get_private_key(account, "active"), chain.control->get_chain_id());
+        auto trace = chain.push_transaction(trx, fc::time_point::maximum(), 0, true);
+        return trace->action_traces.at(0).elapsed.count();
+    }
+
+    int64_t median_us(tester &chain, uint64_t op) {
+        vector<int64_t> elapsed;
+        push(chain, op, 0);
+        for (uint32_t i = 1; i <= iterations; ++i) {
+            elapsed.push_back(push(chain, op, i));
+            if (i % 50 == 0)
+                chain.produce_block();
+        }
+        chain.produce_block();
+        std::sort(elapsed.begin(), elapsed.end());
+        return elapsed[elapsed.size() / 2];
+    }
+
+    fc::variant_object run(wasm_interface::vm_type runtime) {
+        fc::temp_directory dir;
+        tester chain(make_config(dir.path(), runtime));
+        chain.execute_setup_policy(setup_policy::full);
+
+        chain.create_account(N(dbbench));
+        chain.produce_block();
+        chain.set_code(N(dbbench), contract().c_str());
+        chain.produce_block();
+        push(chain, 0, 0);
+        chain.produce_block();
+
+        const auto baseline = median_us(chain, 1);
+        fc::mutable_variant_object result;
+        result("loop_us", baseline);
+        for (const auto &op : operations()) {
+            const auto elapsed = median_us(chain, op.first);
+            result(op.second + "_ns", std::max<int64_t>(0, elapsed - baseline) * 1000 / lookups);
+        }
+        return result;
+    }
+};
+
+int main(int argc, char **argv) {
+    bpo::options_description cli("db_intrinsics_benchmark command line options");
+    db_intrinsics_benchmark bench;
+    std::vector<std::string> runtimes;
+    cli.add_options()
+            ("rows", bpo::value<uint32_t>(&bench.rows)->default_value(bench.rows),
+             "the number of rows in each table")
+            ("lookups", bpo::value<uint32_t>(&bench.lookups)->default_value(bench.lookups),
+             "the number of intrinsic calls made by each transaction")
+            ("iterations", bpo::value<uint32_t>(&bench.iterations)->default_value(bench.iterations),
+             "the number of transactions measured for each intrinsic")
+            ("wasm-runtime", bpo::value<std::vector<std::string>>(&runtimes)->composing(),
+             "a runtime to measure (wavm/wabt), may be specified multiple times. Defaults to both")
+            ("help", "Print this help message and exit.");
+    try {
+        bpo::variables_map vmap;
+        bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+        if (vmap.count("help") > 0) {
+            cli.print(std::cerr);
+            return 0;
+        }
+        bpo::notify(vmap);
+        EOS_ASSERT(bench.rows > 0 && bench.lookups > 0 && bench.iterations > 0, fc::invalid_arg_exception,
+                   "rows, lookups and iterations must be greater than 0");
+        if (runtimes.empty())
+            runtimes = {"wavm", "wabt"};
+
+        fc::mutable_variant_object result;
+        for (const auto &r : runtimes) {
+            std::istringstream in(r);
+            wasm_interface::vm_type runtime;
+            in >> runtime;
+            EOS_ASSERT(!in.fail(), fc::invalid_arg_exception, "unknown wasm runtime ${r}", ("r", r));
+            result(r, bench.run(runtime));
+        }
+        std::cout << fc::json::to_string(result) << std::endl;
+    } catch (const fc::exception &e) {
+        elog("${e}", ("e", e.to_detail_string()));
+        return -1;
+    } catch (const boost::exception &e) {
+        elog("${e}", ("e", boost::diagnostic_information(e)));
+        return -1;
+    } catch (const std::exception &e) {
+        elog("${e}", ("e", e.what()));
+        return -1;
+    } catch (...) {
+        elog("unknown exception");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,323 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#include <eosio/chain/intrinsic_profiler.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+using namespace eosio::chain;
+using namespace eosio::testing;
+namespace bpo = boost::program_options;
+
+// every allocation made by the process is counted, so the allocations of a transaction can be read off around it
+static std::atomic<uint64_t> allocation_count{0};
+static std::atomic<uint64_t> allocated_bytes{0};
+
+void *operator new(std::size_t size) {
+    ++allocation_count;
+    allocated_bytes += size;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+/**
+ * Replays a workload of contract actions on a fresh chain, once for each wasm runtime, and reports the execution
+ * time of every action type. The workload is a JSON file:
+ *
+ *   {
+ *     "accounts":  ["fio.address", ...],
+ *     "contracts": [{"account": "fio.address", "wasm": "path/fio.address.wasm", "abi": "path/fio.address.abi"}, ...],
+ *     "setup":     [<action>, ...],
+ *     "actions":   [<action>, ...]
+ *   }
+ *
+ * where an action is {"account", "name", "actor", "data", "iterations"}. The setup actions run once, the others
+ * are measured. String values in "data" may use ${i} for the iteration number, ${a} for the iteration number
+ * spelled in the letters a-z (for names), and ${key:<account>} for the active public key of an account. Paths
+ * are relative to the workload file. With --profile-intrinsics each action also reports its intrinsic calls.
+ */
+struct wasm_action_benchmark {
+    fc::path workload_file;
+    fc::variant_object workload;
+    uint32_t trxs_per_block = 50;
+
+    struct action_result {
+        std::string action;
+        uint32_t iterations = 0;
+        uint32_t failures = 0;
+        int64_t first_us = 0;
+        std::vector<int64_t> elapsed_us;
+        std::vector<int64_t> cpu_usage_us;
+        uint64_t allocations = 0;
+        uint64_t allocated_bytes = 0;
+        fc::optional<std::string> last_error;
+        std::vector<intrinsic_profiler::entry> intrinsics;
+
+        fc::variant_object to_variant() {
+            std::sort(elapsed_us.begin(), elapsed_us.end());
+            auto percentile = [&](double p) {
+                return elapsed_us.empty() ? 0 : elapsed_us[std::min<size_t>(elapsed_us.size() - 1,
+                                                                            size_t(p * elapsed_us.size()))];
+            };
+            int64_t total = 0, cpu_total = 0;
+            for (auto e : elapsed_us)
+                total += e;
+            for (auto c : cpu_usage_us)
+                cpu_total += c;
+            const auto n = std::max<size_t>(1, elapsed_us.size());
+            fc::mutable_variant_object result;
+            result("action", action)
+                  ("iterations", iterations)
+                  ("failures", failures)
+                  ("first_us", first_us)
+                  ("first_call_overhead_us", first_us - percentile(0.5))
+                  ("mean_us", total / int64_t(n))
+                  ("min_us", percentile(0))
+                  ("p50_us", percentile(0.5))
+                  ("p90_us", percentile(0.9))
+                  ("p99_us", percentile(0.99))
+                  ("max_us", elapsed_us.empty() ? 0 : elapsed_us.back())
+                  ("mean_cpu_usage_us", cpu_total / int64_t(std::max<size_t>(1, cpu_usage_us.size())))
+                  ("allocations_per_trx", allocations / std::max<uint32_t>(1, iterations))
+                  ("allocated_bytes_per_trx", allocated_bytes / std::max<uint32_t>(1, iterations));
+            if (last_error)
+                result("last_error", *last_error);
+            if (!intrinsics.empty()) {
+                // per transaction, across every receiver the action notified
+                fc::variants calls;
+                for (const auto &e : intrinsics)
+                    calls.emplace_back(fc::mutable_variant_object()
+                                               ("receiver", e.receiver)
+                                               ("intrinsic", e.intrinsic)
+                                               ("calls", double(e.calls) / std::max<uint32_t>(1, iterations))
+                                               ("bytes", double(e.bytes) / std::max<uint32_t>(1, iterations))
+                                               ("time_ns", e.time_ns / std::max<uint32_t>(1, iterations)));
+                result("intrinsics", calls);
+            }
+            return result;
+        }
+    };
+
+    static std::string letters(uint32_t i) {
+        std::string s;
+        do {
+            s.insert(s.begin(), char('a' + i % 26));
+            i /= 26;
+        } while (i);
+        return s;
+    }
+
+    static void replace_all(std::string &s, const std::string &from, const std::string &to) {
+        for (auto pos = s.find(from); pos != std::string::npos; pos = s.find(from, pos + to.size()))
+            s.replace(pos, from.size(), to);
+    }
+
+    static fc::variant substitute(const fc::variant &v, uint32_t i) {
+        if (v.is_string()) {
+            auto s = v.get_string();
+            replace_all(s, "${i}", std::to_string(i));
+            replace_all(s, "${a}", letters(i));
+            for (auto pos = s.find("${key:"); pos != std::string::npos; pos = s.find("${key:", pos)) {
+                const auto end = s.find('}', pos);
+                EOS_ASSERT(end != std::string::npos, fc::invalid_arg_exception, "unterminated ${key: in ${s}",
+                           ("s", v.get_string()));
+                const auto key = std::string(base_tester::get_public_key(
+                        name(s.substr(pos + 6, end - pos - 6)), "active"));
+                s.replace(pos, end - pos + 1, key);
+                pos += key.size();
+            }
+            return fc::variant(s);
+        }
+        if (v.is_object()) {
+            fc::mutable_variant_object o;
+            for (const auto &entry : v.get_object())
+                o(entry.key(), substitute(entry.value(), i));
+            return fc::variant(o);
+        }
+        if (v.is_array()) {
+            fc::variants a;
+            for (const auto &entry : v.get_array())
+                a.emplace_back(substitute(entry, i));
+            return fc::variant(a);
+        }
+        return v;
+    }
+
+    controller::config make_config(const fc::path &dir, wasm_interface::vm_type runtime) {
+        controller::config cfg;
+        cfg.blocks_dir = dir / config::default_blocks_dir_name;
+        cfg.state_dir = dir / config::default_state_dir_name;
+        cfg.state_size = 1024ull * 1024 * 1024;
+        cfg.state_guard_size = 0;
+        cfg.reversible_cache_size = 1024 * 1024 * 64;
+        cfg.reversible_guard_size = 0;
+        cfg.genesis.initial_timestamp = fc::time_point::from_iso_string("2020-01-01T00:00:00.000");
+        cfg.genesis.initial_key = base_tester::get_public_key(config::system_account_name, "active");
+        cfg.wasm_runtime = runtime;
+        return cfg;
+    }
+
+    // pushes one action in its own transaction, objectively billed. Unique per iteration so none is a duplicate
+    transaction_trace_ptr push(tester &chain, const fc::variant_object &act, uint32_t i) {
+        const name actor = act["actor"].as_string();
+        signed_transaction trx;
+        trx.actions.emplace_back(chain.get_action(name(act["account"].as_string()), name(act["name"].as_string()),
+                                                  {permission_level{actor, config::active_name}},
+                                                  substitute(act["data"], i).get_object()));
+        chain.set_transaction_headers(trx);
+        trx.max_net_usage_words = 100000 + i;
+        trx.sign(base_tester::get_private_key(actor, "active"), chain.control->get_chain_id());
+        return chain.push_transaction(trx, fc::time_point::maximum(), 0, true);
+    }
+
+    fc::variants run(wasm_interface::vm_type runtime) {
+        fc::temp_directory dir;
+        tester chain(make_config(dir.path(), runtime));
+        chain.execute_setup_policy(setup_policy::full);
+
+        for (const auto &account : workload["accounts"].get_array())
+            chain.create_account(name(account.as_string()));
+        chain.produce_block();
+
+        const auto base_dir = workload_file.parent_path();
+        for (const auto &c : workload["contracts"].get_array()) {
+            const auto &contract = c.get_object();
+            const name account = contract["account"].as_string();
+            chain.set_code(account, read_wasm((base_dir / contract["wasm"].as_string()).generic_string().c_str()));
+            chain.set_abi(account, read_abi((base_dir / contract["abi"].as_string()).generic_string().c_str()).data());
+            chain.produce_block();
+        }
+
+        uint32_t pushed = 0;
+        auto maybe_produce = [&]() {
+            if (++pushed % trxs_per_block == 0)
+                chain.produce_block();
+        };
+
+        for (const auto &s : workload["setup"].get_array()) {
+            const auto &act = s.get_object();
+            const auto iterations = act.contains("iterations") ? act["iterations"].as<uint32_t>() : 1;
+            for (uint32_t i = 0; i < iterations; ++i) {
+                auto trace = push(chain, act, i);
+                EOS_ASSERT(!trace->except, fc::invalid_arg_exception, "setup action ${a} failed: ${e}",
+                           ("a", act["name"])("e", trace->except->to_detail_string()));
+                maybe_produce();
+            }
+        }
+        chain.produce_block();
+
+        fc::variants results;
+        for (const auto &a : workload["actions"].get_array()) {
+            const auto &act = a.get_object();
+            action_result result;
+            result.action = act["account"].as_string() + "::" + act["name"].as_string();
+            result.iterations = act.contains("iterations") ? act["iterations"].as<uint32_t>() : 100;
+            intrinsic_profiler::snapshot(true);
+            for (uint32_t i = 0; i < result.iterations; ++i) {
+                const auto allocations_before = allocation_count.load();
+                const auto bytes_before = allocated_bytes.load();
+                auto trace = push(chain, act, i);
+                result.allocations += allocation_count.load() - allocations_before;
+                result.allocated_bytes += allocated_bytes.load() - bytes_before;
+
+                if (trace->except) {
+                    ++result.failures;
+                    result.last_error = trace->except->to_string();
+                } else {
+                    int64_t elapsed = 0;
+                    for (const auto &at : trace->action_traces)
+                        elapsed += at.elapsed.count();
+                    if (i == 0)
+                        result.first_us = elapsed;
+                    else
+                        result.elapsed_us.push_back(elapsed);
+                    if (trace->receipt)
+                        result.cpu_usage_us.push_back(trace->receipt->cpu_usage_us);
+                }
+                maybe_produce();
+            }
+            result.intrinsics = intrinsic_profiler::snapshot(true);
+            results.emplace_back(result.to_variant());
+        }
+        return results;
+    }
+};
+
+int main(int argc, char **argv) {
+    bpo::options_description cli("wasm_action_benchmark command line options");
+    wasm_action_benchmark bench;
+    std::string workload_file;
+    std::vector<std::string> runtimes;
+    bool profile_intrinsics = false;
+    cli.add_options()
+            ("workload", bpo::value<std::string>(&workload_file)->required(),
+             "the JSON workload file describing the contracts and actions to run")
+            ("wasm-runtime", bpo::value<std::vector<std::string>>(&runtimes)->composing(),
+             "a runtime to measure (wavm/wabt), may be specified multiple times. Defaults to both")
+            ("trxs-per-block", bpo::value<uint32_t>(&bench.trxs_per_block)->default_value(bench.trxs_per_block),
+             "the number of transactions pushed before a block is produced")
+            ("profile-intrinsics", bpo::bool_switch(&profile_intrinsics),
+             "report the calls, bytes and time of each intrinsic per action (skews the timings)")
+            ("help", "Print this help message and exit.");
+    try {
+        bpo::variables_map vmap;
+        bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+        if (vmap.count("help") > 0) {
+            cli.print(std::cerr);
+            return 0;
+        }
+        bpo::notify(vmap);
+        EOS_ASSERT(bench.trxs_per_block > 0, fc::invalid_arg_exception, "trxs-per-block must be greater than 0");
+        if (runtimes.empty())
+            runtimes = {"wavm", "wabt"};
+        intrinsic_profiler::set_enabled(profile_intrinsics);
+
+        bench.workload_file = fc::absolute(fc::path(workload_file));
+        bench.workload = fc::json::from_file(bench.workload_file).get_object();
+
+        fc::mutable_variant_object result;
+        for (const auto &r : runtimes) {
+            std::istringstream in(r);
+            wasm_interface::vm_type runtime;
+            in >> runtime;
+            EOS_ASSERT(!in.fail(), fc::invalid_arg_exception, "unknown wasm runtime ${r}", ("r", r));
+            result(r, bench.run(runtime));
+        }
+        std::cout << fc::json::to_string(result) << std::endl;
+    } catch (const fc::exception &e) {
+        elog("${e}", ("e", e.to_detail_string()));
+        return -1;
+    } catch (const boost::exception &e) {
+        elog("${e}", ("e", boost::diagnostic_information(e)));
+        return -1;
+    } catch (const std::exception &e) {
+        elog("${e}", ("e", e.what()));
+        return -1;
+    } catch (...) {
+        elog("unknown exception");
+        return -1;
+    }
+    return 0;
+}
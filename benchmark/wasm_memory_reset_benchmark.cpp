@@ -0,0 +1,148 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/program_options.hpp>
+
+#include "IR/Module.h"
+#include "IR/Validate.h"
+#include "WASM/WASM.h"
+#include "Inline/Serialization.h"
+#include "Platform/Platform.h"
+#include "Runtime/Runtime.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace eosio::chain;
+namespace bpo = boost::program_options;
+
+/**
+ * Measures the per-action cost of restoring a contract's linear memory, once with the zero-and-copy reset and once
+ * with the copy-on-write image reset. Between resets a number of pages are written to, standing in for the pages an
+ * action dirties. Run it against the FIO system contracts to see the overhead a short action like trnsfiopubky pays.
+ */
+struct wasm_memory_reset_benchmark {
+    uint32_t iterations = 10000;
+    uint32_t dirty_pages = 4;
+
+    fc::variant_object run(const std::string &wasm_file) {
+        std::string code;
+        fc::read_file_contents(wasm_file, code);
+
+        IR::Module module;
+        try {
+            Serialization::MemoryInputStream stream((const U8 *) code.data(), code.size());
+            WASM::serialize(stream, module);
+        } catch (const Serialization::FatalSerializationException &e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+        } catch (const IR::ValidationException &e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+        }
+        EOS_ASSERT(module.memories.defs.size(), wasm_exception, "${f} declares no memory", ("f", wasm_file));
+
+        IR::MemoryType memory_type = module.memories.defs[0].type;
+        const size_t memory_size = size_t(memory_type.size.min) << IR::numBytesPerPageLog2;
+        std::vector<U8> image;
+        for (const IR::DataSegment &data_segment : module.dataSegments) {
+            const size_t end = data_segment.baseOffset.i32 + data_segment.data.size();
+            EOS_ASSERT(end <= memory_size, wasm_exception, "data segment outside of memory");
+            if (end > image.size())
+                image.resize(end, 0);
+            memcpy(image.data() + data_segment.baseOffset.i32, data_segment.data.data(), data_segment.data.size());
+        }
+
+        Runtime::MemoryInstance *memory = Runtime::createMemory(memory_type);
+        EOS_ASSERT(memory != nullptr, wasm_exception, "unable to create memory");
+        U8 *base = Runtime::getMemoryBaseAddress(memory);
+        const size_t page_size = size_t(1) << Platform::getPageSizeLog2();
+        const size_t stride = std::max(page_size, memory_size / std::max<uint32_t>(dirty_pages, 1));
+
+        auto dirty = [&]() {
+            for (uint32_t i = 0; i < dirty_pages; ++i)
+                base[(i * stride) % memory_size] = uint8_t(i + 1);
+        };
+
+        auto start = fc::time_point::now();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            dirty();
+            Runtime::resetMemory(memory, memory_type);
+            memcpy(base, image.data(), image.size());
+        }
+        auto copy_time = fc::time_point::now() - start;
+
+        Platform::MemoryImage *memory_image = Platform::createMemoryImage(image.data(), image.size(), memory_size);
+        fc::microseconds image_time;
+        bool image_supported = memory_image != nullptr;
+        if (image_supported) {
+            start = fc::time_point::now();
+            for (uint32_t i = 0; i < iterations; ++i) {
+                dirty();
+                image_supported = Runtime::resetMemoryFromImage(memory, memory_type, memory_image);
+                EOS_ASSERT(image_supported, wasm_exception, "unable to map memory image");
+            }
+            image_time = fc::time_point::now() - start;
+            EOS_ASSERT(memcmp(base, image.data(), image.size()) == 0, wasm_exception,
+                       "image reset did not restore the initial memory");
+            Platform::destroyMemoryImage(memory_image);
+        }
+
+        return fc::mutable_variant_object()
+                ("wasm", wasm_file)
+                ("initial_pages", memory_type.size.min)
+                ("data_bytes", image.size())
+                ("dirty_pages", dirty_pages)
+                ("copy_reset_ns", copy_time.count() * 1000 / iterations)
+                ("image_reset_ns", image_supported ? fc::variant(image_time.count() * 1000 / iterations)
+                                                   : fc::variant());
+    }
+};
+
+int main(int argc, char **argv) {
+    bpo::options_description cli("wasm_memory_reset_benchmark command line options");
+    wasm_memory_reset_benchmark bench;
+    std::vector<std::string> wasm_files;
+    cli.add_options()
+            ("wasm", bpo::value<std::vector<std::string>>(&wasm_files)->composing()->required(),
+             "a contract wasm to measure, may be specified multiple times")
+            ("iterations", bpo::value<uint32_t>(&bench.iterations)->default_value(bench.iterations),
+             "the number of resets measured for each contract")
+            ("dirty-pages", bpo::value<uint32_t>(&bench.dirty_pages)->default_value(bench.dirty_pages),
+             "the number of pages written between resets")
+            ("help", "Print this help message and exit.");
+    try {
+        bpo::variables_map vmap;
+        bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+        if (vmap.count("help") > 0) {
+            cli.print(std::cerr);
+            return 0;
+        }
+        bpo::notify(vmap);
+        EOS_ASSERT(bench.iterations > 0, fc::invalid_arg_exception, "iterations must be greater than 0");
+
+        fc::variants results;
+        for (const auto &wasm_file : wasm_files)
+            results.emplace_back(bench.run(wasm_file));
+        std::cout << fc::json::to_string(results) << std::endl;
+    } catch (const fc::exception &e) {
+        elog("${e}", ("e", e.to_detail_string()));
+        return -1;
+    } catch (const boost::exception &e) {
+        elog("${e}", ("e", boost::diagnostic_information(e)));
+        return -1;
+    } catch (const std::exception &e) {
+        elog("${e}", ("e", e.what()));
+        return -1;
+    } catch (...) {
+        elog("unknown exception");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/wasm_eosio_injection.hpp>
+#include <eosio/chain/wasm_eosio_validation.hpp>
+
+#include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/program_options.hpp>
+
+#include "IR/Module.h"
+#include "IR/Validate.h"
+#include "WASM/WASM.h"
+#include "Inline/Serialization.h"
+
+#include <iostream>
+
+using namespace eosio::chain;
+namespace bpo = boost::program_options;
+
+/**
+ * Measures the eosio validation and injection passes a contract goes through on setcode and on its first use, once
+ * serially and once spread over a thread pool of each given size. Run it against large contracts, such as the FIO
+ * system contracts or unittests/contracts/eosio.system, to see what a system contract upgrade costs the block it is
+ * in. The parallel passes are checked to produce the same code as the serial ones.
+ */
+struct wasm_setcode_benchmark {
+    uint32_t iterations = 20;
+    std::vector<uint32_t> threads;
+
+    static IR::Module parse(const std::string &code) {
+        IR::Module module;
+        try {
+            Serialization::MemoryInputStream stream((const U8 *) code.data(), code.size());
+            WASM::serialize(stream, module);
+        } catch (const Serialization::FatalSerializationException &e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+        } catch (const IR::ValidationException &e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+        }
+        return module;
+    }
+
+    static std::vector<U8> serialize(IR::Module &module) {
+        std::vector<U8> bytes;
+        try {
+            Serialization::ArrayOutputStream stream;
+            WASM::serialize(stream, module);
+            bytes = stream.getBytes();
+        } catch (const Serialization::FatalSerializationException &e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+        } catch (const IR::ValidationException &e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+        }
+        return bytes;
+    }
+
+    // average microseconds of validating and of injecting the code, with the injected code of the last iteration
+    fc::variant_object measure(const std::string &code, boost::asio::io_context *pool, uint32_t pool_threads,
+                               std::vector<U8> &injected) {
+        fc::microseconds validate_time, inject_time;
+        for (uint32_t i = 0; i < iterations; ++i) {
+            IR::Module validated = parse(code);
+            auto start = fc::time_point::now();
+            wasm_validations::wasm_binary_validation validator(validated, true);
+            validator.validate(pool, pool_threads, 0);
+            validate_time += fc::time_point::now() - start;
+
+            IR::Module module = parse(code);
+            start = fc::time_point::now();
+            wasm_injections::wasm_binary_injection injector(module);
+            injector.inject(pool, pool_threads, 0);
+            inject_time += fc::time_point::now() - start;
+            injected = serialize(module);
+        }
+        return fc::mutable_variant_object()
+                ("validate_us", validate_time.count() / iterations)
+                ("inject_us", inject_time.count() / iterations);
+    }
+
+    fc::variant_object run(const std::string &wasm_file) {
+        std::string code;
+        fc::read_file_contents(wasm_file, code);
+        const IR::Module module = parse(code);
+
+        std::vector<U8> serial_code;
+        fc::mutable_variant_object result;
+        result("wasm", wasm_file)
+              ("functions", module.functions.defs.size())
+              ("code_bytes", wasm_ops::function_code_size(module))
+              ("serial", measure(code, nullptr, 0, serial_code));
+        for (auto t : threads) {
+            named_thread_pool pool("bench", t);
+            std::vector<U8> parallel_code;
+            result("threads_" + std::to_string(t), measure(code, &pool.get_executor(), t, parallel_code));
+            EOS_ASSERT(parallel_code == serial_code, wasm_exception,
+                       "parallel injection of ${f} with ${t} threads differs from the serial injection",
+                       ("f", wasm_file)("t", t));
+        }
+        return result;
+    }
+};
+
+int main(int argc, char **argv) {
+    bpo::options_description cli("wasm_setcode_benchmark command line options");
+    wasm_setcode_benchmark bench;
+    std::vector<std::string> wasm_files;
+    cli.add_options()
+            ("wasm", bpo::value<std::vector<std::string>>(&wasm_files)->composing()->required(),
+             "a contract wasm to measure, may be specified multiple times")
+            ("threads", bpo::value<std::vector<uint32_t>>(&bench.threads)->composing(),
+             "a thread pool size to measure, may be specified multiple times. Defaults to 2 and 4")
+            ("iterations", bpo::value<uint32_t>(&bench.iterations)->default_value(bench.iterations),
+             "the number of times each pass is measured")
+            ("help", "Print this help message and exit.");
+    try {
+        bpo::variables_map vmap;
+        bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+        if (vmap.count("help") > 0) {
+            cli.print(std::cerr);
+            return 0;
+        }
+        bpo::notify(vmap);
+        EOS_ASSERT(bench.iterations > 0, fc::invalid_arg_exception, "iterations must be greater than 0");
+        if (bench.threads.empty())
+            bench.threads = {2, 4};
+        for (auto t : bench.threads)
+            EOS_ASSERT(t > 0, fc::invalid_arg_exception, "threads must be greater than 0");
+
+        fc::variants results;
+        for (const auto &wasm_file : wasm_files)
+            results.emplace_back(bench.run(wasm_file));
+        std::cout << fc::json::to_string(results) << std::endl;
+    } catch (const fc::exception &e) {
+        elog("${e}", ("e", e.to_detail_string()));
+        return -1;
+    } catch (const boost::exception &e) {
+        elog("${e}", ("e", boost::diagnostic_information(e)));
+        return -1;
+    } catch (const std::exception &e) {
+        elog("${e}", ("e", e.what()));
+        return -1;
+    } catch (...) {
+        elog("unknown exception");
+        return -1;
+    }
+    return 0;
+}
@@ -33,9 +33,23 @@ namespace eosio {
             }
         }
 
+        /// a scheduled (with its transaction) or cancelled deferred transaction, as compared by action_effects
+        static bytes deferred_effect(bool cancel, const uint128_t &sender_id, account_name account,
+                                     const transaction *trx) {
+            bytes effect{char(cancel)};
+            auto append = [&](const bytes &b) { effect.insert(effect.end(), b.begin(), b.end()); };
+            append(fc::raw::pack(uint64_t(sender_id >> 64)));
+            append(fc::raw::pack(uint64_t(sender_id)));
+            append(fc::raw::pack(account));
+            if (trx)
+                append(fc::raw::pack(*trx));
+            return effect;
+        }
+
         apply_context::apply_context(controller &con, transaction_context &trx_ctx, uint32_t action_ordinal,
                                      uint32_t depth)
-                : control(con), db(con.mutable_db()), trx_context(trx_ctx), recurse_depth(depth),
+                : control(con), db(con.mutable_db()), trx_context(trx_ctx), lookup_cache(trx_ctx.lookup_cache),
+                  recurse_depth(depth),
                   first_receiver_action_ordinal(action_ordinal), action_ordinal(action_ordinal), idx64(*this),
                   idx128(*this), idx256(*this), idx_double(*this), idx_long_double(*this) {
             action_trace &trace = trx_ctx.get_action_trace(action_ordinal);
@@ -104,10 +118,7 @@ namespace eosio {
                             control.check_contract_list(receiver);
                             control.check_action_list(act->account, act->name);
                         }
-                        try {
-                            control.get_wasm_interface().apply(receiver_account->code_hash, receiver_account->vm_type,
-                                                               receiver_account->vm_version, *this);
-                        } catch (const wasm_exit &) {}
+                        apply_contract(*receiver_account);
                     }
 
                     if (!privileged && control.is_builtin_activated(builtin_protocol_feature_t::ram_restrictions)) {
@@ -178,6 +189,131 @@ namespace eosio {
             }
         }
 
+        void apply_context::apply_contract(const account_metadata_object &receiver_account) {
+            auto run_wasm = [&]() {
+                try {
+                    control.get_wasm_interface().apply(receiver_account.code_hash, receiver_account.vm_type,
+                                                       receiver_account.vm_version, *this);
+                } catch (const wasm_exit &) {}
+            };
+
+            auto &natives = control.get_native_contracts();
+            const auto *native = receiver == act->account ? natives.find(receiver_account.code_hash, act->name)
+                                                          : nullptr;
+            if (!native) {
+                run_wasm();
+            } else if (natives.mode() == native_contract_mode::native) {
+                natives.record_native_run();
+                (*native)(*this);
+            } else if (control.skip_db_sessions()) {
+                // the native run could not be undone
+                run_wasm();
+            } else {
+                shadow_native_contract(*native, run_wasm);
+            }
+        }
+
+        void apply_context::shadow_native_contract(const native_contracts::handler &native,
+                                                   const std::function<void()> &run_wasm) {
+            // the native run is not billed, the wasm run is what the action is charged for
+            action_effects native_effects;
+            trx_context.pause_billing_timer();
+            record_effects(native_effects, [&]() { native(*this); }, false);
+            trx_context.resume_billing_timer();
+
+            action_effects wasm_effects;
+            auto wasm_failure = record_effects(wasm_effects, run_wasm, true);
+
+            const auto difference = native_effects.difference(wasm_effects);
+            auto &natives = control.get_native_contracts();
+            natives.record_shadow_run(!difference.empty());
+            if (!difference.empty()) {
+                const auto &receiver_account = db.get<account_metadata_object, by_name>(receiver);
+                elog("native ${contract}::${action} (${hash}) differs from the wasm in ${field}, native: ${native} wasm: ${wasm}",
+                     ("contract", receiver)("action", act->name)("hash", receiver_account.code_hash)
+                     ("field", difference)("native", native_effects)("wasm", wasm_effects));
+            }
+            if (wasm_failure)
+                std::rethrow_exception(wasm_failure);
+        }
+
+        std::exception_ptr
+        apply_context::record_effects(action_effects &effects, const std::function<void()> &run, bool keep) {
+            const auto traces = trx_context.trace->action_traces.size();
+            const auto notified = _notified.size();
+            const auto inline_actions = _inline_actions.size();
+            const auto cfa_inline_actions = _cfa_inline_actions.size();
+            const auto ram_deltas = _account_ram_deltas;
+            const auto console = _pending_console_output;
+            const auto response = _response;
+            const auto validate_ram_usage = trx_context.validate_ram_usage;
+            // an undone run must not leave its tables in the conflict data of the transaction
+            optional<table_access_set> table_access;
+            if (!keep && trx_context.trace->table_access)
+                table_access = *trx_context.trace->table_access;
+
+            optional<chainbase::database::session> session;
+            if (!keep)
+                session = db.start_undo_session(true);
+
+            std::exception_ptr failure;
+            _effects = &effects;
+            try {
+                run();
+            } catch (const fc::exception &e) {
+                failure = std::current_exception();
+                effects.except = e.to_string();
+            } catch (const std::exception &e) {
+                failure = std::current_exception();
+                effects.except = e.what();
+            } catch (...) {
+                failure = std::current_exception();
+                effects.except = "unknown exception";
+            }
+            _effects = nullptr;
+
+            for (auto i = notified; i < _notified.size(); ++i)
+                effects.notified.push_back(_notified[i].first);
+            for (auto i = inline_actions; i < _inline_actions.size(); ++i)
+                effects.inline_actions.push_back(trx_context.get_action_trace(_inline_actions[i]).act);
+            for (auto i = cfa_inline_actions; i < _cfa_inline_actions.size(); ++i)
+                effects.cfa_inline_actions.push_back(trx_context.get_action_trace(_cfa_inline_actions[i]).act);
+            for (const auto &d : _account_ram_deltas) {
+                auto itr = ram_deltas.find(d);
+                const auto delta = d.delta - (itr != ram_deltas.end() ? itr->delta : 0);
+                if (delta != 0)
+                    effects.ram_deltas.emplace_back(d.account, delta);
+            }
+            effects.console = _pending_console_output.substr(std::min(console.size(), _pending_console_output.size()));
+            effects.response = _response;
+
+            if (!keep) {
+                session->undo();
+                auto &action_traces = trx_context.trace->action_traces;
+                action_traces.erase(action_traces.begin() + traces, action_traces.end());
+                act = &trx_context.get_action_trace(action_ordinal).act;
+                _notified.erase(_notified.begin() + notified, _notified.end());
+                _inline_actions.erase(_inline_actions.begin() + inline_actions, _inline_actions.end());
+                _cfa_inline_actions.erase(_cfa_inline_actions.begin() + cfa_inline_actions, _cfa_inline_actions.end());
+                _account_ram_deltas = ram_deltas;
+                _pending_console_output = console;
+                _response = response;
+                trx_context.validate_ram_usage = validate_ram_usage;
+                if (table_access)
+                    *trx_context.trace->table_access = std::move(*table_access);
+
+                // iterators and cached lookups may refer to rows the undo removed
+                keyval_cache = iterator_cache<key_value_object>();
+                idx64.reset_cache();
+                idx128.reset_cache();
+                idx256.reset_cache();
+                idx_double.reset_cache();
+                idx_long_double.reset_cache();
+                lookup_cache.clear();
+            }
+            return failure;
+        }
+
         void apply_context::finalize_trace(action_trace &trace, const fc::time_point &start) {
             trace.account_ram_deltas = std::move(_account_ram_deltas);
             _account_ram_deltas.clear();
@@ -568,6 +704,8 @@ namespace eosio {
                        "Cannot charge RAM to other accounts during notify."
             );
             add_ram_usage(payer, (config::billable_size_v<generated_transaction_object> + trx_size));
+            if (BOOST_UNLIKELY(_effects != nullptr))
+                _effects->deferred.emplace_back(deferred_effect(false, sender_id, payer, &trx));
         }
 
         bool apply_context::cancel_deferred_transaction(const uint128_t &sender_id, account_name sender) {
@@ -578,6 +716,8 @@ namespace eosio {
                               -(config::billable_size_v<generated_transaction_object> + gto->packed_trx.size()));
                 generated_transaction_idx.remove(*gto);
             }
+            if (BOOST_UNLIKELY(_effects != nullptr))
+                _effects->deferred.emplace_back(deferred_effect(true, sender_id, sender, nullptr));
             return gto;
         }
 
@@ -603,29 +743,50 @@ namespace eosio {
         }
 
         const table_id_object *apply_context::find_table(name code, name scope, name table) {
-            return db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+            record_table_read(code, scope, table);
+            const table_id_object *tab = nullptr;
+            if (!lookup_cache.find_table(code, scope, table, tab)) {
+                tab = db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+                lookup_cache.cache_table(code, scope, table, tab);
+            }
+            return tab;
         }
 
         const table_id_object &
         apply_context::find_or_create_table(name code, name scope, name table, const account_name &payer) {
-            const auto *existing_tid = db.find<table_id_object, by_code_scope_table>(
-                    boost::make_tuple(code, scope, table));
+            record_table_write(code, scope, table);
+            const table_id_object *existing_tid = nullptr;
+            if (!lookup_cache.find_table(code, scope, table, existing_tid))
+                existing_tid = db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
             if (existing_tid != nullptr) {
                 return *existing_tid;
             }
 
             update_db_usage(payer, config::billable_size_v<table_id_object>);
 
-            return db.create<table_id_object>([&](table_id_object &t_id) {
+            const auto &tid = db.create<table_id_object>([&](table_id_object &t_id) {
                 t_id.code = code;
                 t_id.scope = scope;
                 t_id.table = table;
                 t_id.payer = payer;
             });
+            lookup_cache.cache_table(code, scope, table, &tid);
+            return tid;
+        }
+
+        void apply_context::record_table_read(name code, name scope, name table) {
+            if (trx_context.trace->table_access)
+                trx_context.trace->table_access->reads.emplace(code, scope, table);
+        }
+
+        void apply_context::record_table_write(name code, name scope, name table) {
+            if (trx_context.trace->table_access)
+                trx_context.trace->table_access->writes.emplace(code, scope, table);
         }
 
         void apply_context::remove_table(const table_id_object &tid) {
             update_db_usage(tid.payer, -config::billable_size_v<table_id_object>);
+            lookup_cache.cache_table(tid.code, tid.scope, tid.table, nullptr);
             db.remove(tid);
         }
 
@@ -724,6 +885,8 @@ namespace eosio {
 
             int64_t billable_size = (int64_t) (buffer_size + config::billable_size_v<key_value_object>);
             update_db_usage(payer, billable_size);
+            record_table_effect(contract_table_write::store, key_value_object::type_id, tab, id, payer, buffer,
+                                buffer_size);
 
             keyval_cache.cache_table(tab);
             return keyval_cache.add(obj);
@@ -734,6 +897,7 @@ namespace eosio {
 
             const auto &table_obj = keyval_cache.get_table(obj.t_id);
             EOS_ASSERT(table_obj.code == receiver, table_access_violation, "db access violation");
+            record_table_write(table_obj.code, table_obj.scope, table_obj.table);
 
 //   require_write_lock( table_obj.scope );
 
@@ -757,6 +921,8 @@ namespace eosio {
                 o.value.assign(buffer, buffer_size);
                 o.payer = payer;
             });
+            record_table_effect(contract_table_write::update, key_value_object::type_id, table_obj, obj.primary_key,
+                                payer, buffer, buffer_size);
         }
 
         void apply_context::db_remove_i64(int iterator) {
@@ -764,6 +930,7 @@ namespace eosio {
 
             const auto &table_obj = keyval_cache.get_table(obj.t_id);
             EOS_ASSERT(table_obj.code == receiver, table_access_violation, "db access violation");
+            record_table_write(table_obj.code, table_obj.scope, table_obj.table);
 
 //   require_write_lock( table_obj.scope );
 
@@ -772,6 +939,8 @@ namespace eosio {
             db.modify(table_obj, [&](auto &t) {
                 --t.count;
             });
+            record_table_effect(contract_table_write::remove, key_value_object::type_id, table_obj, obj.primary_key,
+                                obj.payer, nullptr, 0);
             db.remove(obj);
 
             if (table_obj.count == 0) {
@@ -4,8 +4,14 @@
  */
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <fstream>
+#include <future>
+#include <thread>
 #include <fc/io/raw.hpp>
+#include <boost/filesystem.hpp>
 
 #define LOG_READ  (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
@@ -25,8 +31,365 @@ namespace eosio {
         const uint32_t block_log::max_supported_version = 2;
 
         namespace detail {
+
+            /**
+             * Read the header of a block log, leaving the stream positioned right after the genesis state (and
+             * before the totem of version 2+ logs).
+             */
+            void read_log_header(std::istream &block_stream, uint32_t &version, uint32_t &first_block_num,
+                                 genesis_state &gs) {
+                version = 0;
+                block_stream.read((char *) &version, sizeof(version));
+                EOS_ASSERT(version > 0, block_log_exception, "Block log was not setup properly");
+                EOS_ASSERT(version >= block_log::min_supported_version && version <= block_log::max_supported_version,
+                           block_log_unsupported_version,
+                           "Unsupported version of block log. Block log version is ${version} while code supports version(s) [${min},${max}]",
+                           ("version", version)("min", block_log::min_supported_version)("max",
+                                                                                         block_log::max_supported_version));
+
+                first_block_num = 1;
+                if (version != 1) {
+                    block_stream.read((char *) &first_block_num, sizeof(first_block_num));
+                }
+
+                fc::raw::unpack(block_stream, gs);
+            }
+
+            /**
+             * Copy the bytes of a block stored at [pos, end_pos) to buffer starting at prefix_size. The block number
+             * is checked using the fixed size leading fields of the header so the block is never unpacked.
+             */
+            void read_serialized_block(std::istream &block_stream, uint64_t pos, uint64_t end_pos, uint32_t block_num,
+                                       std::vector<char> &buffer, size_t prefix_size) {
+                EOS_ASSERT(end_pos > pos, block_log_exception,
+                           "Invalid block position range in block log.",
+                           ("block_num", block_num)("start", pos)("end", end_pos));
+
+                const size_t block_size = end_pos - pos;
+                buffer.resize(prefix_size + block_size);
+                block_stream.seekg(pos);
+                block_stream.read(buffer.data() + prefix_size, block_size);
+
+                fc::datastream<const char *> ds(buffer.data() + prefix_size, block_size);
+                block_timestamp_type timestamp;
+                account_name producer;
+                uint16_t confirmed = 0;
+                block_id_type previous;
+                fc::raw::unpack(ds, timestamp);
+                fc::raw::unpack(ds, producer);
+                fc::raw::unpack(ds, confirmed);
+                fc::raw::unpack(ds, previous);
+                EOS_ASSERT(block_header::num_from_id(previous) + 1 == block_num, reversible_blocks_exception,
+                           "Wrong block was read from block log.",
+                           ("returned", block_header::num_from_id(previous) + 1)("expected", block_num));
+            }
+
+            constexpr uint64_t index_rebuild_chunk_size = 64 * 1024 * 1024;
+            constexpr size_t index_write_buffer_entries = 1024 * 1024;
+
+            /**
+             * Writes index entries starting from the head block and going back to the first block. Entries are
+             * buffered so each write to the index file is a single large sequential write.
+             */
+            class reverse_index_writer {
+            public:
+                reverse_index_writer(const fc::path &index_file, uint32_t num_blocks)
+                        : next_entry(num_blocks) {
+                    index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+                    index_stream.open(index_file.generic_string().c_str(),
+                                      std::ios::out | std::ios::binary | std::ios::trunc);
+                    buffer.reserve(index_write_buffer_entries);
+                }
+
+                void write(uint64_t pos) {
+                    buffer.push_back(pos);
+                    if (buffer.size() == index_write_buffer_entries)
+                        flush();
+                }
+
+                void flush() {
+                    if (buffer.empty())
+                        return;
+                    std::reverse(buffer.begin(), buffer.end());
+                    next_entry -= buffer.size();
+                    index_stream.seekp(uint64_t(next_entry) * sizeof(uint64_t));
+                    index_stream.write((const char *) buffer.data(), buffer.size() * sizeof(uint64_t));
+                    buffer.clear();
+                }
+
+            private:
+                std::ofstream index_stream;
+                std::vector<uint64_t> buffer;
+                uint32_t next_entry;
+            };
+
+            /**
+             * Build the index by following the position trailers from the head block back to the first block.
+             * The log is read backwards in large chunks and no block is deserialized. Returns false if the
+             * trailers do not form a consistent chain of num_blocks blocks.
+             */
+            bool build_index_backward(std::istream &block_stream, uint64_t first_block_pos, uint64_t head_pos,
+                                      uint32_t num_blocks, const fc::path &index_file) {
+                reverse_index_writer index(index_file, num_blocks);
+                const uint32_t progress_interval = std::max(1u, num_blocks / 10);
+
+                std::vector<char> chunk;
+                uint64_t chunk_start = head_pos; // chunk holds the bytes [chunk_start, chunk_start + chunk.size())
+                uint64_t pos = head_pos;
+                uint32_t count = 0;
+                while (true) {
+                    index.write(pos);
+                    if (++count % progress_interval == 0)
+                        ilog("Block log index walked back ${c} of ${n} blocks", ("c", count)("n", num_blocks));
+                    if (pos == first_block_pos)
+                        break;
+                    if (count == num_blocks || pos < first_block_pos + sizeof(uint64_t))
+                        return false;
+
+                    const uint64_t trailer_pos = pos - sizeof(uint64_t);
+                    if (trailer_pos < chunk_start) {
+                        chunk_start = std::max(first_block_pos, pos > index_rebuild_chunk_size ? pos - index_rebuild_chunk_size : 0);
+                        chunk.resize(pos - chunk_start);
+                        block_stream.seekg(chunk_start);
+                        block_stream.read(chunk.data(), chunk.size());
+                    }
+
+                    uint64_t prev_pos;
+                    memcpy(&prev_pos, chunk.data() + (trailer_pos - chunk_start), sizeof(prev_pos));
+                    if (prev_pos >= trailer_pos || prev_pos < first_block_pos)
+                        return false;
+                    pos = prev_pos;
+                }
+                if (count != num_blocks)
+                    return false;
+
+                index.flush();
+                return true;
+            }
+
+            /**
+             * Check in parallel that the header of every indexed block has the expected block number and links to
+             * the block before it, and that the block is followed by a trailer pointing back at it. The index is
+             * read index_write_buffer_entries positions at a time and block bodies are not deserialized.
+             */
+            bool validate_index(const fc::path &block_file, const fc::path &index_file, uint32_t first_block_num,
+                                uint32_t num_blocks, uint64_t blocks_end) {
+                const uint32_t num_threads = std::min<uint32_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                                                num_blocks);
+                const uint32_t blocks_per_thread = (num_blocks + num_threads - 1) / num_threads;
+                const uint32_t progress_interval = std::max(1u, num_blocks / 10);
+                std::atomic<uint32_t> validated{0};
+
+                auto validate_range = [&](uint32_t begin, uint32_t end) -> bool {
+                    try {
+                        std::ifstream block_stream;
+                        std::ifstream index_stream;
+                        block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+                        index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+                        block_stream.open(block_file.generic_string().c_str(), LOG_READ);
+                        index_stream.open(index_file.generic_string().c_str(), LOG_READ);
+
+                        std::vector<uint64_t> positions;
+                        block_header header;
+                        block_id_type previous;
+                        if (begin > 0) {
+                            // the first block of the range links to the last block of the range before it
+                            uint64_t prev_pos = 0;
+                            index_stream.seekg(uint64_t(begin - 1) * sizeof(uint64_t));
+                            index_stream.read((char *) &prev_pos, sizeof(prev_pos));
+                            block_stream.seekg(prev_pos);
+                            fc::raw::unpack(block_stream, header);
+                            previous = header.id();
+                        }
+                        for (uint32_t chunk_begin = begin; chunk_begin < end; chunk_begin += index_write_buffer_entries) {
+                            const uint32_t chunk_end = std::min<uint64_t>(end, chunk_begin + index_write_buffer_entries);
+                            // one extra entry gives the end of the last block of the chunk
+                            const uint32_t entries = std::min(chunk_end + 1, num_blocks) - chunk_begin;
+                            positions.resize(entries);
+                            index_stream.seekg(uint64_t(chunk_begin) * sizeof(uint64_t));
+                            index_stream.read((char *) positions.data(), entries * sizeof(uint64_t));
+
+                            for (uint32_t i = chunk_begin; i < chunk_end; ++i) {
+                                const uint64_t pos = positions[i - chunk_begin];
+                                const uint64_t next_pos =
+                                        i + 1 < num_blocks ? positions[i + 1 - chunk_begin] : blocks_end;
+                                block_stream.seekg(pos);
+                                fc::raw::unpack(block_stream, header);
+                                const uint64_t header_end = block_stream.tellg();
+                                uint64_t trailer = 0;
+                                if (header_end + sizeof(trailer) <= next_pos) {
+                                    block_stream.seekg(next_pos - sizeof(trailer));
+                                    block_stream.read((char *) &trailer, sizeof(trailer));
+                                }
+                                const bool linked = i == 0 || header.previous == previous;
+                                if (header.block_num() != first_block_num + i || trailer != pos || !linked) {
+                                    elog("Block log is inconsistent at block ${n}", ("n", first_block_num + i));
+                                    return false;
+                                }
+                                previous = header.id();
+                                if (++validated % progress_interval == 0)
+                                    ilog("Block log validated ${c} of ${n} blocks",
+                                         ("c", validated.load())("n", num_blocks));
+                            }
+                        }
+                        return true;
+                    } catch (const fc::exception &e) {
+                        elog("Unable to validate block log: ${e}", ("e", e.to_detail_string()));
+                    } catch (const std::exception &e) {
+                        elog("Unable to validate block log: ${e}", ("e", e.what()));
+                    }
+                    return false;
+                };
+
+                std::vector<std::future<bool>> results;
+                for (uint32_t begin = 0; begin < num_blocks; begin += blocks_per_thread) {
+                    results.emplace_back(std::async(std::launch::async, validate_range, begin,
+                                                    std::min(num_blocks, begin + blocks_per_thread)));
+                }
+                bool valid = true;
+                for (auto &r : results)
+                    valid = r.get() && valid;
+                return valid;
+            }
+
+            /// true when the last position in the log is the totem that ends the header
+            bool log_has_no_blocks(const fc::path &block_file) {
+                std::ifstream block_stream;
+                block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+                block_stream.open(block_file.generic_string().c_str(), LOG_READ);
+                block_stream.seekg(0, std::ios::end);
+                if (static_cast<uint64_t>(block_stream.tellg()) < sizeof(uint64_t))
+                    return false;
+                uint64_t end_pos = 0;
+                block_stream.seekg(-sizeof(end_pos), std::ios::end);
+                block_stream.read((char *) &end_pos, sizeof(end_pos));
+                return end_pos == block_log::npos;
+            }
+
+            /**
+             * Try to build the index of a block log with a backward walk over the position trailers followed by a
+             * parallel validation of all blocks. Returns false if the log is inconsistent.
+             */
+            bool construct_index_parallel(const fc::path &block_file, const fc::path &index_file) {
+                try {
+                    std::ifstream block_stream;
+                    block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+                    block_stream.open(block_file.generic_string().c_str(), LOG_READ);
+
+                    block_stream.seekg(0, std::ios::end);
+                    const uint64_t file_size = block_stream.tellg();
+                    if (file_size < sizeof(uint64_t))
+                        return false;
+
+                    uint64_t head_pos;
+                    block_stream.seekg(file_size - sizeof(uint64_t));
+                    block_stream.read((char *) &head_pos, sizeof(head_pos));
+
+                    block_stream.seekg(0);
+                    uint32_t version = 0;
+                    uint32_t first_block_num = 0;
+                    genesis_state gs;
+                    read_log_header(block_stream, version, first_block_num, gs);
+                    if (version > 1) {
+                        uint64_t totem;
+                        block_stream.read((char *) &totem, sizeof(totem));
+                    }
+                    const uint64_t first_block_pos = block_stream.tellg();
+
+                    if (head_pos == block_log::npos || head_pos < first_block_pos || head_pos >= file_size)
+                        return false;
+
+                    block_header head_header;
+                    block_stream.seekg(head_pos);
+                    fc::raw::unpack(block_stream, head_header);
+                    if (head_header.block_num() < first_block_num)
+                        return false;
+                    const uint32_t num_blocks = head_header.block_num() - first_block_num + 1;
+
+                    auto start = fc::time_point::now();
+                    if (!build_index_backward(block_stream, first_block_pos, head_pos, num_blocks, index_file))
+                        return false;
+                    ilog("Block log index of ${n} blocks built in ${t}ms, validating",
+                         ("n", num_blocks)("t", (fc::time_point::now() - start).count() / 1000));
+
+                    if (!validate_index(block_file, index_file, first_block_num, num_blocks,
+                                        file_size))
+                        return false;
+                    ilog("Block log index of ${n} blocks built and validated in ${t}ms",
+                         ("n", num_blocks)("t", (fc::time_point::now() - start).count() / 1000));
+                    return true;
+                } catch (const fc::exception &e) {
+                    wlog("Unable to build block log index from position trailers: ${e}", ("e", e.to_detail_string()));
+                } catch (const std::exception &e) {
+                    wlog("Unable to build block log index from position trailers: ${e}", ("e", e.what()));
+                }
+                return false;
+            }
+
+            struct block_log_segment {
+                uint32_t first_block_num = 0;
+                uint32_t last_block_num = 0;
+                fc::path block_file;
+                fc::path index_file;
+            };
+
+            /**
+             * Read-only access to the segments split off from blocks.log, ordered by block number.
+             */
+            class block_log_catalog {
+            public:
+                fc::path retained_dir;
+                fc::path archive_dir;
+                uint16_t max_retained_files = std::numeric_limits<uint16_t>::max();
+
+                void open(const fc::path &retained, const fc::path &archive, uint16_t max_files);
+
+                /// true if dir holds any block log segment
+                static bool contains_segments(const fc::path &dir);
+
+                bool empty() const { return segments.empty(); }
+
+                uint32_t first_block_num() const { return segments.empty() ? 0 : segments.begin()->first; }
+
+                uint32_t last_block_num() const { return segments.empty() ? 0 : segments.rbegin()->second.last_block_num; }
+
+                bool contains(uint32_t block_num) const {
+                    return !segments.empty() && block_num >= first_block_num() && block_num <= last_block_num();
+                }
+
+                genesis_state extract_genesis_state() const;
+
+                signed_block_ptr read_block_by_num(uint32_t block_num);
+
+                bool read_serialized_block_by_num(uint32_t block_num, std::vector<char> &buffer, size_t prefix_size);
+
+                void add(uint32_t first, uint32_t last, const fc::path &block_file, const fc::path &index_file);
+
+            private:
+                /// opens the segment holding block_num and returns the position range of the block in it
+                std::pair<uint64_t, uint64_t> locate(uint32_t block_num);
+
+                void close() {
+                    if (block_stream.is_open())
+                        block_stream.close();
+                    if (index_stream.is_open())
+                        index_stream.close();
+                    active.reset();
+                }
+
+                void prune();
+
+                std::map<uint32_t, block_log_segment> segments; ///< keyed by first block number
+                optional<uint32_t> active;                      ///< segment the streams are opened on
+                std::ifstream block_stream;
+                std::ifstream index_stream;
+            };
+
             class block_log_impl {
             public:
+                block_log_catalog catalog;
+                genesis_state genesis;
+                uint32_t stride = 0;
                 signed_block_ptr head;
                 block_id_type head_id;
                 std::fstream block_stream;
@@ -70,12 +433,215 @@ namespace eosio {
 
                 open_files = true;
             }
+
+            static fc::path segment_file(const fc::path &dir, uint32_t first, uint32_t last, const char *ext) {
+                return dir / ("blocks-" + std::to_string(first) + "-" + std::to_string(last) + ext);
+            }
+
+            /// true if name is a block log segment file name with the given extension
+            static bool parse_segment_name(const std::string &name, const char *ext, uint32_t &first, uint32_t &last) {
+                return std::sscanf(name.c_str(), "blocks-%u-%u.", &first, &last) == 2 &&
+                       name == segment_file(fc::path(), first, last, ext).generic_string();
+            }
+
+            bool block_log_catalog::contains_segments(const fc::path &dir) {
+                if (!fc::is_directory(dir))
+                    return false;
+                using boost::filesystem::directory_iterator;
+                for (directory_iterator enditr, itr{dir}; itr != enditr; ++itr) {
+                    uint32_t first = 0, last = 0;
+                    if (boost::filesystem::is_regular_file(itr->status()) &&
+                        parse_segment_name(itr->path().filename().generic_string(), ".log", first, last))
+                        return true;
+                }
+                return false;
+            }
+
+            void block_log_catalog::open(const fc::path &retained, const fc::path &archive, uint16_t max_files) {
+                close();
+                segments.clear();
+                retained_dir = retained;
+                archive_dir = archive;
+                max_retained_files = max_files;
+
+                if (!fc::is_directory(retained_dir))
+                    fc::create_directories(retained_dir);
+
+                using boost::filesystem::directory_iterator;
+                for (directory_iterator enditr, itr{retained_dir}; itr != enditr; ++itr) {
+                    if (!boost::filesystem::is_regular_file(itr->status()))
+                        continue;
+                    const auto name = itr->path().filename().generic_string();
+                    uint32_t first = 0, last = 0;
+                    if (!parse_segment_name(name, ".log", first, last))
+                        continue;
+                    if (first == 0 || last < first) {
+                        wlog("Ignoring invalid block log segment '${f}'", ("f", name));
+                        continue;
+                    }
+                    segments[first] = block_log_segment{first, last, retained_dir / name,
+                                                        segment_file(retained_dir, first, last, ".index")};
+                }
+
+                // segments are contiguous, anything before a gap cannot be served
+                for (auto itr = segments.rbegin(); itr != segments.rend(); ++itr) {
+                    auto prev = std::next(itr);
+                    if (prev != segments.rend() && prev->second.last_block_num + 1 != itr->first) {
+                        wlog("Block log segments are not contiguous after block ${n}, ignoring older segments",
+                             ("n", prev->second.last_block_num));
+                        segments.erase(segments.begin(), prev.base());
+                        break;
+                    }
+                }
+
+                // the index of each segment is independent, rebuild the ones that are missing or incomplete in parallel
+                std::vector<const block_log_segment *> stale;
+                for (const auto &s : segments) {
+                    const auto &seg = s.second;
+                    const uint64_t expected_size = uint64_t(seg.last_block_num - seg.first_block_num + 1) * sizeof(uint64_t);
+                    if (!fc::exists(seg.index_file) || fc::file_size(seg.index_file) != expected_size)
+                        stale.push_back(&seg);
+                }
+                const size_t max_parallel = std::max(1u, std::thread::hardware_concurrency());
+                for (size_t i = 0; i < stale.size(); i += max_parallel) {
+                    std::vector<std::future<void>> rebuilds;
+                    for (size_t j = i; j < std::min(stale.size(), i + max_parallel); ++j) {
+                        ilog("Reconstructing index of block log segment '${f}'", ("f", stale[j]->block_file.generic_string()));
+                        rebuilds.emplace_back(std::async(std::launch::async, [seg = stale[j]]() {
+                            block_log::construct_index(seg->block_file, seg->index_file);
+                        }));
+                    }
+                    for (auto &f : rebuilds)
+                        f.get();
+                }
+
+                prune();
+
+                if (!segments.empty()) {
+                    ilog("Block log segments cover blocks ${f} to ${l}", ("f", first_block_num())("l", last_block_num()));
+                }
+            }
+
+            genesis_state block_log_catalog::extract_genesis_state() const {
+                EOS_ASSERT(!segments.empty(), block_log_not_found, "No block log segments available");
+                std::ifstream block_stream;
+                block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+                block_stream.open(segments.rbegin()->second.block_file.generic_string().c_str(), LOG_READ);
+                uint32_t version = 0;
+                uint32_t first_block_num = 0;
+                genesis_state gs;
+                read_log_header(block_stream, version, first_block_num, gs);
+                return gs;
+            }
+
+            std::pair<uint64_t, uint64_t> block_log_catalog::locate(uint32_t block_num) {
+                auto itr = segments.upper_bound(block_num);
+                EOS_ASSERT(itr != segments.begin(), block_log_exception,
+                           "Block ${n} is not in a block log segment", ("n", block_num));
+                const auto &seg = (--itr)->second;
+
+                if (!active || *active != seg.first_block_num) {
+                    close();
+                    block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+                    index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+                    block_stream.open(seg.block_file.generic_string().c_str(), LOG_READ);
+                    index_stream.open(seg.index_file.generic_string().c_str(), LOG_READ);
+                    active = seg.first_block_num;
+                }
+
+                uint64_t pos = 0;
+                index_stream.seekg(sizeof(uint64_t) * (block_num - seg.first_block_num));
+                index_stream.read((char *) &pos, sizeof(pos));
+
+                uint64_t end_pos = 0;
+                if (block_num == seg.last_block_num) {
+                    block_stream.seekg(0, std::ios::end);
+                    end_pos = uint64_t(block_stream.tellg()) - sizeof(uint64_t);
+                } else {
+                    index_stream.read((char *) &end_pos, sizeof(end_pos));
+                    end_pos -= sizeof(uint64_t);
+                }
+                return {pos, end_pos};
+            }
+
+            signed_block_ptr block_log_catalog::read_block_by_num(uint32_t block_num) {
+                if (!contains(block_num))
+                    return {};
+                auto range = locate(block_num);
+                block_stream.seekg(range.first);
+                auto b = std::make_shared<signed_block>();
+                fc::raw::unpack(block_stream, *b);
+                EOS_ASSERT(b->block_num() == block_num, reversible_blocks_exception,
+                           "Wrong block was read from block log segment.",
+                           ("returned", b->block_num())("expected", block_num));
+                return b;
+            }
+
+            bool block_log_catalog::read_serialized_block_by_num(uint32_t block_num, std::vector<char> &buffer,
+                                                                 size_t prefix_size) {
+                if (!contains(block_num))
+                    return false;
+                auto range = locate(block_num);
+                read_serialized_block(block_stream, range.first, range.second, block_num, buffer, prefix_size);
+                return true;
+            }
+
+            void block_log_catalog::add(uint32_t first, uint32_t last, const fc::path &block_file,
+                                        const fc::path &index_file) {
+                EOS_ASSERT(segments.empty() || last_block_num() + 1 == first, block_log_exception,
+                           "Block log segment ${f}-${l} does not follow the last segment ending at ${e}",
+                           ("f", first)("l", last)("e", last_block_num()));
+                block_log_segment seg{first, last, segment_file(retained_dir, first, last, ".log"),
+                                      segment_file(retained_dir, first, last, ".index")};
+                fc::rename(block_file, seg.block_file);
+                fc::rename(index_file, seg.index_file);
+                segments[first] = seg;
+                ilog("Split block log segment with blocks ${f} to ${l}", ("f", first)("l", last));
+                prune();
+            }
+
+            void block_log_catalog::prune() {
+                while (segments.size() > max_retained_files) {
+                    const auto seg = segments.begin()->second;
+                    if (active && *active == seg.first_block_num)
+                        close();
+                    if (archive_dir.empty()) {
+                        ilog("Removing block log segment with blocks ${f} to ${l}",
+                             ("f", seg.first_block_num)("l", seg.last_block_num));
+                        fc::remove(seg.block_file);
+                        fc::remove(seg.index_file);
+                    } else {
+                        if (!fc::is_directory(archive_dir))
+                            fc::create_directories(archive_dir);
+                        ilog("Archiving block log segment with blocks ${f} to ${l} to '${d}'",
+                             ("f", seg.first_block_num)("l", seg.last_block_num)("d", archive_dir.generic_string()));
+                        fc::rename(seg.block_file, archive_dir / seg.block_file.filename());
+                        fc::rename(seg.index_file, archive_dir / seg.index_file.filename());
+                    }
+                    segments.erase(segments.begin());
+                }
+            }
         }
 
-        block_log::block_log(const fc::path &data_dir)
+        block_log::block_log(const fc::path &data_dir, const block_log_config &config)
                 : my(new detail::block_log_impl()) {
             my->block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
             my->index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+            my->stride = config.stride;
+            auto to_absolute = [&data_dir](const fc::path &p) {
+                if (p.empty() || !p.is_relative())
+                    return p;
+                return data_dir / p;
+            };
+            fc::path retained_dir = config.retained_dir.empty() ? data_dir : to_absolute(config.retained_dir);
+            if (my->stride) {
+                my->catalog.open(retained_dir, to_absolute(config.archive_dir), config.max_retained_files);
+            } else {
+                // blocks.log continues from the last segment, without them the blocks they hold could not be served
+                EOS_ASSERT(!detail::block_log_catalog::contains_segments(retained_dir), block_log_exception,
+                           "Block log segments exist in '${d}' but the block log stride is 0, set a stride to keep "
+                           "serving them", ("d", retained_dir.generic_string()));
+            }
             open(data_dir);
         }
 
@@ -126,25 +692,15 @@ namespace eosio {
             if (log_size) {
                 ilog("Log is nonempty");
                 my->block_stream.seekg(0);
-                my->version = 0;
-                my->block_stream.read((char *) &my->version, sizeof(my->version));
-                EOS_ASSERT(my->version > 0, block_log_exception, "Block log was not setup properly");
-                EOS_ASSERT(my->version >= min_supported_version && my->version <= max_supported_version,
-                           block_log_unsupported_version,
-                           "Unsupported version of block log. Block log version is ${version} while code supports version(s) [${min},${max}]",
-                           ("version", my->version)("min", block_log::min_supported_version)("max",
-                                                                                             block_log::max_supported_version));
-
+                detail::read_log_header(my->block_stream, my->version, my->first_block_num, my->genesis);
 
                 my->genesis_written_to_block_log = true; // Assume it was constructed properly.
-                if (my->version > 1) {
-                    my->first_block_num = 0;
-                    my->block_stream.read((char *) &my->first_block_num, sizeof(my->first_block_num));
-                    EOS_ASSERT(my->first_block_num > 0, block_log_exception,
-                               "Block log is malformed, first recorded block number is 0 but must be greater than or equal to 1");
-                } else {
-                    my->first_block_num = 1;
-                }
+                EOS_ASSERT(my->first_block_num > 0, block_log_exception,
+                           "Block log is malformed, first recorded block number is 0 but must be greater than or equal to 1");
+                EOS_ASSERT(my->catalog.empty() || my->catalog.last_block_num() + 1 == my->first_block_num,
+                           block_log_exception,
+                           "Block log starting at block ${n} does not follow the block log segments ending at block ${e}",
+                           ("n", my->first_block_num)("e", my->catalog.last_block_num()));
 
                 my->head = read_head();
                 if (my->head) {
@@ -174,11 +730,19 @@ namespace eosio {
                     ilog("Index is empty");
                     construct_index();
                 }
-            } else if (index_size) {
-                ilog("Index is nonempty, remove and recreate it");
-                my->close();
-                fc::remove_all(my->index_file);
-                my->reopen();
+            } else {
+                if (index_size) {
+                    ilog("Index is nonempty, remove and recreate it");
+                    my->close();
+                    fc::remove_all(my->index_file);
+                    my->reopen();
+                }
+                if (!my->catalog.empty()) {
+                    ilog("Log is empty, continuing after the last block log segment");
+                    reset(my->catalog.extract_genesis_state(), signed_block_ptr(), my->catalog.last_block_num() + 1);
+                    my->head = read_head();
+                    my->head_id = my->head->id();
+                }
             }
         }
 
@@ -206,11 +770,27 @@ namespace eosio {
 
                 flush();
 
+                if (my->stride && b->block_num() % my->stride == 0) {
+                    split_log();
+                }
+
                 return pos;
             }
             FC_LOG_AND_RETHROW()
         }
 
+        void block_log::split_log() {
+            auto head = my->head;
+            auto head_id = my->head_id;
+            my->close();
+            my->catalog.add(my->first_block_num, head->block_num(), my->block_file, my->index_file);
+
+            // the new log continues with the next block, blocks up to the head are served from the segments
+            reset(my->genesis, signed_block_ptr(), head->block_num() + 1);
+            my->head = head;
+            my->head_id = head_id;
+        }
+
         void block_log::flush() {
             my->block_stream.flush();
             my->index_stream.flush();
@@ -225,6 +805,7 @@ namespace eosio {
             my->reopen();
 
             auto data = fc::raw::pack(gs);
+            my->genesis = gs;
             my->version = 0; // version of 0 is invalid; it indicates that the genesis was not properly written to the block log
             my->first_block_num = first_block_num;
             my->block_stream.seekp(0, std::ios::end);
@@ -267,6 +848,9 @@ namespace eosio {
 
         signed_block_ptr block_log::read_block_by_num(uint32_t block_num) const {
             try {
+                if (block_num < my->first_block_num && my->catalog.contains(block_num))
+                    return my->catalog.read_block_by_num(block_num);
+
                 signed_block_ptr b;
                 uint64_t pos = get_block_pos(block_num);
                 if (pos != npos) {
@@ -279,6 +863,30 @@ namespace eosio {
             } FC_LOG_AND_RETHROW()
         }
 
+        bool block_log::read_serialized_block_by_num(uint32_t block_num, std::vector<char> &buffer,
+                                                     size_t prefix_size) const {
+            try {
+                if (block_num < my->first_block_num && my->catalog.contains(block_num))
+                    return my->catalog.read_serialized_block_by_num(block_num, buffer, prefix_size);
+
+                uint64_t pos = get_block_pos(block_num);
+                if (pos == npos)
+                    return false;
+
+                // the block ends where the position trailer of the block starts, which is either right before the
+                // next block or at the end of the file for the head block
+                uint64_t end_pos;
+                if (block_num == block_header::num_from_id(my->head_id)) {
+                    my->block_stream.seekg(0, std::ios::end);
+                    end_pos = uint64_t(my->block_stream.tellg()) - sizeof(uint64_t);
+                } else {
+                    end_pos = get_block_pos(block_num + 1) - sizeof(uint64_t);
+                }
+                detail::read_serialized_block(my->block_stream, pos, end_pos, block_num, buffer, prefix_size);
+                return true;
+            } FC_LOG_AND_RETHROW()
+        }
+
         uint64_t block_log::get_block_pos(uint32_t block_num) const {
             my->check_open_files();
             if (!(my->head && block_num <= block_header::num_from_id(my->head_id) && block_num >= my->first_block_num))
@@ -303,6 +911,8 @@ namespace eosio {
             my->block_stream.read((char *) &pos, sizeof(pos));
             if (pos != npos) {
                 return read_block(pos).first;
+            } else if (!my->catalog.empty()) {
+                return my->catalog.read_block_by_num(my->catalog.last_block_num());
             } else {
                 return {};
             }
@@ -313,21 +923,44 @@ namespace eosio {
         }
 
         uint32_t block_log::first_block_num() const {
+            if (!my->catalog.empty())
+                return my->catalog.first_block_num();
             return my->first_block_num;
         }
 
         void block_log::construct_index() {
             ilog("Reconstructing Block Log Index...");
             my->close();
+            construct_index(my->block_file, my->index_file);
+            my->reopen();
+        } // construct_index
 
-            fc::remove_all(my->index_file);
+        void block_log::construct_index(const fc::path &block_file, const fc::path &index_file) {
+            fc::remove_all(index_file);
 
-            my->reopen();
+            // a log just split off from its blocks holds only the header
+            if (detail::log_has_no_blocks(block_file)) {
+                ilog("Block log contains no blocks. No need to construct index.");
+                return;
+            }
+
+            if (detail::construct_index_parallel(block_file, index_file))
+                return;
+
+            wlog("Falling back to a sequential scan to reconstruct the block log index");
+            fc::remove_all(index_file);
+
+            std::fstream block_stream;
+            std::fstream index_stream;
+            block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+            index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+            block_stream.open(block_file.generic_string().c_str(), LOG_READ);
+            index_stream.open(index_file.generic_string().c_str(), LOG_WRITE);
 
             uint64_t end_pos;
 
-            my->block_stream.seekg(-sizeof(uint64_t), std::ios::end);
-            my->block_stream.read((char *) &end_pos, sizeof(end_pos));
+            block_stream.seekg(-sizeof(uint64_t), std::ios::end);
+            block_stream.read((char *) &end_pos, sizeof(end_pos));
 
             if (end_pos == npos) {
                 ilog("Block log contains no blocks. No need to construct index.");
@@ -336,34 +969,36 @@ namespace eosio {
 
             signed_block tmp;
 
-            uint64_t pos = 0;
-            if (my->version == 1) {
-                pos = 4; // Skip version which should have already been checked.
-            } else {
-                pos = 8; // Skip version and first block offset which should have already been checked
-            }
-            my->block_stream.seekg(pos);
-
+            block_stream.seekg(0);
+            uint32_t version = 0;
+            uint32_t first_block_num = 0;
             genesis_state gs;
-            fc::raw::unpack(my->block_stream, gs);
+            detail::read_log_header(block_stream, version, first_block_num, gs);
 
             // skip the totem
-            if (my->version > 1) {
+            if (version > 1) {
                 uint64_t totem;
-                my->block_stream.read((char *) &totem, sizeof(totem));
+                block_stream.read((char *) &totem, sizeof(totem));
             }
 
-            my->index_stream.seekp(0, std::ios::end);
-            while (pos < end_pos) {
-                fc::raw::unpack(my->block_stream, tmp);
-                my->block_stream.read((char *) &pos, sizeof(pos));
+            // index where each block was read from, a damaged position trailer must not end up in the index
+            uint64_t pos = block_stream.tellg();
+            while (pos <= end_pos) {
+                fc::raw::unpack(block_stream, tmp);
+                uint64_t trailer = 0;
+                block_stream.read((char *) &trailer, sizeof(trailer));
+                if (trailer != pos)
+                    wlog("Block ${n} has a position trailer of ${t}, expected ${p}",
+                         ("n", tmp.block_num())("t", trailer)("p", pos));
                 if (tmp.block_num() % 1000 == 0)
                     ilog("Block log index reconstructed for block ${n}", ("n", tmp.block_num()));
-                my->index_stream.write((char *) &pos, sizeof(pos));
+                index_stream.write((char *) &pos, sizeof(pos));
+                pos = block_stream.tellg();
             }
-        } // construct_index
+        }
 
-        fc::path block_log::repair_log(const fc::path &data_dir, uint32_t truncate_at_block) {
+        fc::path block_log::repair_log(const fc::path &data_dir, uint32_t truncate_at_block,
+                                       const fc::path &retained_dir, const fc::path &archive_dir) {
             ilog("Recovering Block Log...");
             EOS_ASSERT(fc::is_directory(data_dir) && fc::is_regular_file(data_dir / "blocks.log"), block_log_not_found,
                        "Block log not found in '${blocks_dir}'", ("blocks_dir", data_dir));
@@ -384,6 +1019,31 @@ namespace eosio {
                        "Cannot move existing blocks directory to already existing directory '${new_blocks_dir}'",
                        ("new_blocks_dir", backup_dir));
 
+            // where a directory is relative to the blocks directory, empty when it is outside of it. Sets in_blocks_dir
+            // when it is the blocks directory itself
+            auto subdir_of_blocks_dir = [&blocks_dir](const fc::path &d, bool &in_blocks_dir) {
+                in_blocks_dir = false;
+                const auto abs = d.is_relative() ? blocks_dir / d : d;
+                if (!fc::is_directory(abs))
+                    return std::string();
+                const auto dir = fc::canonical(abs).generic_string();
+                const auto prefix = blocks_dir.generic_string() + "/";
+                if (dir == blocks_dir.generic_string())
+                    in_blocks_dir = true;
+                else if (dir.compare(0, prefix.size(), prefix) == 0)
+                    return dir.substr(prefix.size());
+                return std::string();
+            };
+            bool segments_in_blocks_dir = retained_dir.empty();
+            std::string retained_subdir;
+            if (!segments_in_blocks_dir)
+                retained_subdir = subdir_of_blocks_dir(retained_dir, segments_in_blocks_dir);
+            // archived segments are not served, but are carried along so they are not left behind in the backup
+            bool archive_is_blocks_dir = false;
+            std::string archive_subdir;
+            if (!archive_dir.empty())
+                archive_subdir = subdir_of_blocks_dir(archive_dir, archive_is_blocks_dir);
+
             fc::rename(blocks_dir, backup_dir);
             ilog("Moved existing blocks directory to backup location: '${new_blocks_dir}'",
                  ("new_blocks_dir", backup_dir));
@@ -391,6 +1051,25 @@ namespace eosio {
             fc::create_directories(blocks_dir);
             auto block_log_path = blocks_dir / "blocks.log";
 
+            // split off segments are immutable once written, move them back instead of recovering them
+            for (const auto &subdir : {retained_subdir, archive_subdir}) {
+                if (subdir.empty() || !fc::is_directory(backup_dir / subdir) || fc::exists(blocks_dir / subdir))
+                    continue;
+                fc::create_directories((blocks_dir / subdir).parent_path());
+                fc::rename(backup_dir / subdir, blocks_dir / subdir);
+            }
+            if (segments_in_blocks_dir || archive_is_blocks_dir) {
+                using boost::filesystem::directory_iterator;
+                for (directory_iterator enditr, itr{backup_dir}; itr != enditr; ++itr) {
+                    const auto name = itr->path().filename().generic_string();
+                    uint32_t first = 0, last = 0;
+                    if (boost::filesystem::is_regular_file(itr->status()) &&
+                        std::sscanf(name.c_str(), "blocks-%u-%u.", &first, &last) == 2) {
+                        fc::rename(backup_dir / name, blocks_dir / name);
+                    }
+                }
+            }
+
             ilog("Reconstructing '${new_block_log}' from backed up block log", ("new_block_log", block_log_path));
 
             std::fstream old_block_stream;
@@ -542,21 +1221,9 @@ namespace eosio {
             block_stream.open((data_dir / "blocks.log").generic_string().c_str(), LOG_READ);
 
             uint32_t version = 0;
-            block_stream.read((char *) &version, sizeof(version));
-            EOS_ASSERT(version > 0, block_log_exception, "Block log was not setup properly.");
-            EOS_ASSERT(version >= min_supported_version && version <= max_supported_version,
-                       block_log_unsupported_version,
-                       "Unsupported version of block log. Block log version is ${version} while code supports version(s) [${min},${max}]",
-                       ("version", version)("min", block_log::min_supported_version)("max",
-                                                                                     block_log::max_supported_version));
-
             uint32_t first_block_num = 1;
-            if (version != 1) {
-                block_stream.read((char *) &first_block_num, sizeof(first_block_num));
-            }
-
             genesis_state gs;
-            fc::raw::unpack(block_stream, gs);
+            detail::read_log_header(block_stream, version, first_block_num, gs);
             return gs;
         }
 
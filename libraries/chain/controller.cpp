@@ -232,12 +232,14 @@ namespace eosio {
             db_read_mode read_mode = db_read_mode::SPECULATIVE;
             bool in_trx_requiring_checks = false; ///< if true, checks that are normally skipped on replay (e.g. auth checks) cannot be skipped
             optional<fc::microseconds> subjective_cpu_leeway;
+            bool track_table_access = false;
             bool trusted_producer_light_validation = false;
             uint32_t snapshot_head_block = 0;
             named_thread_pool thread_pool;
 
             typedef pair<scope_name, action_name> handler_key;
             map<account_name, map<handler_key, apply_handler> > apply_handlers;
+            native_contracts natives;
             unordered_map<builtin_protocol_feature_t, std::function<void(
                     controller_impl &)>, enum_hash<builtin_protocol_feature_t> > protocol_feature_activation_handlers;
 
@@ -247,6 +249,9 @@ namespace eosio {
     *  can query this list when scheduling new transactions into blocks.
     */
             unapplied_transactions_type unapplied_transactions;
+            /// expiration buckets of unapplied_transactions. Transactions can be erased from unapplied_transactions
+            /// directly, so this may hold ids that are gone; it is rebuilt before it holds twice as many as are left
+            std::multimap<fc::time_point_sec, transaction_id_type> unapplied_expirations;
 
             void pop_block() {
                 auto prev = fork_db.get_block(head->header.previous);
@@ -265,7 +270,7 @@ namespace eosio {
                     EOS_ASSERT(head->block, block_validate_exception,
                                "attempting to pop a block that was sparsely loaded from a snapshot");
                     for (const auto &t : head->trxs)
-                        unapplied_transactions[t->signed_id] = t;
+                        add_unapplied_transaction(t);
                 }
 
                 head = prev;
@@ -309,16 +314,18 @@ namespace eosio {
                       reversible_blocks(cfg.blocks_dir / config::reversible_blocks_dir_name,
                                         cfg.read_only ? database::read_only : database::read_write,
                                         cfg.reversible_cache_size, false, cfg.db_map_mode, cfg.db_hugepage_paths),
-                      blog(cfg.blocks_dir),
+                      blog(cfg.blocks_dir, block_log_config{cfg.blocks_log_stride, cfg.max_retained_block_files,
+                                                            cfg.blocks_retained_dir, cfg.blocks_archive_dir}),
                       fork_db(cfg.state_dir),
-                      wasmif(cfg.wasm_runtime, db),
+                      wasmif(cfg.wasm_runtime, db, cfg.wasm_tiered_compilation),
                       resource_limits(db),
                       authorization(s, db),
                       protocol_features(std::move(pfs)),
                       conf(cfg),
                       chain_id(cfg.genesis.compute_chain_id()),
                       read_mode(cfg.read_mode),
-                      thread_pool("chain", cfg.thread_pool_size) {
+                      thread_pool("chain", cfg.thread_pool_size),
+                      natives(cfg.native_contract_execution) {
 
                 fork_db.open([this](block_timestamp_type timestamp,
                                     const flat_set<digest_type> &cur_features,
@@ -331,6 +338,9 @@ namespace eosio {
                 set_activation_handler<builtin_protocol_feature_t::replace_deferred>();
                 set_activation_handler<builtin_protocol_feature_t::get_sender>();
 
+                wasmif.set_thread_pool(thread_pool.get_executor(), cfg.thread_pool_size);
+                wasmif.set_cache_budget(cfg.wasm_cache_size, cfg.wasm_cache_policy);
+
                 self.irreversible_block.connect([this](const block_state_ptr &bsp) {
                     wasmif.current_lib(bsp->block_num);
                 });
@@ -2463,11 +2473,52 @@ namespace eosio {
                     log_irreversible();
             } /// push_block
 
+            void add_unapplied_transaction(const transaction_metadata_ptr &t) {
+                if (unapplied_transactions.empty())
+                    unapplied_expirations.clear();
+                auto r = unapplied_transactions.emplace(t->signed_id, t);
+                if (!r.second) {
+                    // the same transaction, already in its expiration bucket
+                    r.first->second = t;
+                    return;
+                }
+                unapplied_expirations.emplace(t->packed_trx->expiration(), t->signed_id);
+                if (unapplied_expirations.size() > 2 * unapplied_transactions.size())
+                    rebuild_unapplied_expirations();
+            }
+
+            void rebuild_unapplied_expirations() {
+                unapplied_expirations.clear();
+                for (const auto &t : unapplied_transactions)
+                    unapplied_expirations.emplace(t.second->packed_trx->expiration(), t.first);
+            }
+
+            void clear_unapplied_transactions() {
+                unapplied_transactions.clear();
+                unapplied_expirations.clear();
+            }
+
+            size_t drop_expired_unapplied_transactions(const fc::time_point &now) {
+                size_t dropped = 0;
+                auto itr = unapplied_expirations.begin();
+                for (; itr != unapplied_expirations.end() && fc::time_point(itr->first) < now; ++itr) {
+                    auto trx_itr = unapplied_transactions.find(itr->second);
+                    if (trx_itr != unapplied_transactions.end()) {
+                        unapplied_transactions.erase(trx_itr);
+                        ++dropped;
+                    }
+                }
+                unapplied_expirations.erase(unapplied_expirations.begin(), itr);
+                if (unapplied_transactions.empty())
+                    unapplied_expirations.clear();
+                return dropped;
+            }
+
             void abort_block() {
                 if (pending) {
                     if (read_mode == db_read_mode::SPECULATIVE) {
                         for (const auto &t : pending->get_trx_metas())
-                            unapplied_transactions[t->signed_id] = t;
+                            add_unapplied_transaction(t);
                     }
                     pending.reset();
                     protocol_features.popped_blocks_to(head->block_num);
@@ -3219,6 +3270,22 @@ namespace eosio {
             } FC_CAPTURE_AND_RETHROW((block_num))
         }
 
+        bool controller::fetch_serialized_block_by_number(uint32_t block_num, std::vector<char> &buffer,
+                                                          size_t prefix_size) const {
+            try {
+                auto blk_state = fetch_block_state_by_number(block_num);
+                if (blk_state && blk_state->block) {
+                    const auto &b = *blk_state->block;
+                    buffer.resize(prefix_size + fc::raw::pack_size(b));
+                    fc::datastream<char *> ds(buffer.data() + prefix_size, buffer.size() - prefix_size);
+                    fc::raw::pack(ds, b);
+                    return true;
+                }
+
+                return my->blog.read_serialized_block_by_num(block_num, buffer, prefix_size);
+            } FC_CAPTURE_AND_RETHROW((block_num))
+        }
+
         block_state_ptr controller::fetch_block_state_by_id(block_id_type id) const {
             auto state = my->fork_db.get_block(id);
             return state;
@@ -3452,6 +3519,14 @@ namespace eosio {
             return my->wasmif;
         }
 
+        const wasm_interface &controller::get_wasm_interface() const {
+            return my->wasmif;
+        }
+
+        native_contracts &controller::get_native_contracts() {
+            return my->natives;
+        }
+
         const account_object &controller::get_account(account_name name) const {
             try {
                 return my->db.get<account_object, by_name>(name);
@@ -3466,6 +3541,18 @@ namespace eosio {
             return my->unapplied_transactions;
         }
 
+        size_t controller::drop_expired_unapplied_transactions(const fc::time_point &now) {
+            return my->drop_expired_unapplied_transactions(now);
+        }
+
+        void controller::clear_unapplied_transactions() {
+            my->clear_unapplied_transactions();
+        }
+
+        size_t controller::unapplied_expiration_entries() const {
+            return my->unapplied_expirations.size();
+        }
+
         bool controller::sender_avoids_whitelist_blacklist_enforcement(account_name sender) const {
             return my->sender_avoids_whitelist_blacklist_enforcement(sender);
         }
@@ -3581,6 +3668,14 @@ namespace eosio {
             my->subjective_cpu_leeway = leeway;
         }
 
+        void controller::set_track_table_access(bool track) {
+            my->track_table_access = track;
+        }
+
+        bool controller::tracks_table_access() const {
+            return my->track_table_access;
+        }
+
         void controller::set_greylist_limit(uint32_t limit) {
             EOS_ASSERT(0 < limit && limit <= chain::config::maximum_elastic_resource_multiplier,
                        misc_exception,
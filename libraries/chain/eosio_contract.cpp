@@ -386,7 +386,7 @@ namespace eosio {
 
             if (code_size > 0) {
                 code_hash = fc::sha256::hash(act.code.data(), (uint32_t) act.code.size());
-                wasm_interface::validate(context.control, act.code);
+                context.control.get_wasm_interface().validate(context.control, act.code);
             }
 
             const auto &account = db.get<account_metadata_object, by_name>(act.account);
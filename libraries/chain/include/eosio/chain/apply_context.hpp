@@ -7,6 +7,7 @@
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/db_lookup_cache.hpp>
 #include <fc/utility.hpp>
 #include <sstream>
 #include <algorithm>
@@ -26,8 +27,10 @@ namespace eosio {
             class iterator_cache {
             public:
                 iterator_cache() {
+                    _table_cache.reserve(8);
                     _end_iterator_to_table.reserve(8);
                     _iterator_to_object.reserve(32);
+                    _object_to_iterator.reserve(32);
                 }
 
                 /// Returns end iterator of the table.
@@ -97,10 +100,10 @@ namespace eosio {
                 }
 
             private:
-                map<table_id_object::id_type, pair<const table_id_object *, int>> _table_cache;
+                flat_map<table_id_object::id_type, pair<const table_id_object *, int>> _table_cache;
                 vector<const table_id_object *> _end_iterator_to_table;
                 vector<const T *> _iterator_to_object;
-                map<const T *, int> _object_to_iterator;
+                unordered_map<const T *, int> _object_to_iterator;
 
                 /// Precondition: std::numeric_limits<int>::min() < ei < -1
                 /// Iterator of -1 is reserved for invalid iterators (i.e. when the appropriate table has not yet been created).
@@ -203,6 +206,9 @@ namespace eosio {
                     });
 
                     context.update_db_usage(payer, config::billable_size_v<ObjectType>);
+                    context.lookup_cache.invalidate_secondary<ObjectType>(tab.id, obj.secondary_key);
+                    context.record_table_effect(contract_table_write::store, ObjectType::type_id, tab, id, payer,
+                                                obj.secondary_key);
 
                     itr_cache.cache_table(tab);
                     return itr_cache.add(obj);
@@ -214,12 +220,16 @@ namespace eosio {
 
                     const auto &table_obj = itr_cache.get_table(obj.t_id);
                     EOS_ASSERT(table_obj.code == context.receiver, table_access_violation, "db access violation");
+                    context.record_table_write(table_obj.code, table_obj.scope, table_obj.table);
 
 //               context.require_write_lock( table_obj.scope );
 
                     context.db.modify(table_obj, [&](auto &t) {
                         --t.count;
                     });
+                    context.lookup_cache.invalidate_secondary<ObjectType>(obj.t_id, obj.secondary_key);
+                    context.record_table_effect(contract_table_write::remove, ObjectType::type_id, table_obj,
+                                                obj.primary_key, obj.payer, nullptr, 0);
                     context.db.remove(obj);
 
                     if (table_obj.count == 0) {
@@ -234,6 +244,7 @@ namespace eosio {
 
                     const auto &table_obj = itr_cache.get_table(obj.t_id);
                     EOS_ASSERT(table_obj.code == context.receiver, table_access_violation, "db access violation");
+                    context.record_table_write(table_obj.code, table_obj.scope, table_obj.table);
 
 //               context.require_write_lock( table_obj.scope );
 
@@ -246,10 +257,14 @@ namespace eosio {
                         context.update_db_usage(payer, +(billing_size));
                     }
 
+                    context.lookup_cache.invalidate_secondary<ObjectType>(obj.t_id, obj.secondary_key);
                     context.db.modify(obj, [&](auto &o) {
                         secondary_key_helper_t::set(o.secondary_key, secondary);
                         o.payer = payer;
                     });
+                    context.lookup_cache.invalidate_secondary<ObjectType>(obj.t_id, obj.secondary_key);
+                    context.record_table_effect(contract_table_write::update, ObjectType::type_id, table_obj,
+                                                obj.primary_key, payer, obj.secondary_key);
                 }
 
                 int
@@ -260,8 +275,12 @@ namespace eosio {
 
                     auto table_end_itr = itr_cache.cache_table(*tab);
 
-                    const auto *obj = context.db.find<ObjectType, by_secondary>(
-                            secondary_key_helper_t::create_tuple(*tab, secondary));
+                    const auto key = secondary_key_helper_t::create_tuple(*tab, secondary);
+                    const ObjectType *obj = nullptr;
+                    if (!context.lookup_cache.find_secondary(tab->id, key.template get<1>(), obj)) {
+                        obj = context.db.find<ObjectType, by_secondary>(key);
+                        context.lookup_cache.cache_secondary(tab->id, key.template get<1>(), obj);
+                    }
                     if (!obj) return table_end_itr;
 
                     primary = obj->primary_key;
@@ -459,6 +478,11 @@ namespace eosio {
                     secondary_key_helper_t::get(secondary, obj.secondary_key);
                 }
 
+                /// drops every iterator, used after the rows they refer to may have been undone
+                void reset_cache() {
+                    itr_cache = iterator_cache<ObjectType>();
+                }
+
             private:
                 apply_context &context;
                 iterator_cache<ObjectType> itr_cache;
@@ -474,6 +498,16 @@ namespace eosio {
 
             void exec_one();
 
+        private:
+            void apply_contract(const account_metadata_object &receiver_account);
+
+            void shadow_native_contract(const native_contracts::handler &native, const std::function<void()> &run_wasm);
+
+            /// runs the action, filling effects; unless keep is set, its state changes are undone afterwards
+            std::exception_ptr record_effects(action_effects &effects, const std::function<void()> &run, bool keep);
+
+        public:
+
             void exec();
 
             void execute_inline(action &&a);
@@ -574,6 +608,26 @@ namespace eosio {
 
             void remove_table(const table_id_object &tid);
 
+            void record_table_read(name code, name scope, name table);
+
+            void record_table_write(name code, name scope, name table);
+
+            void record_table_effect(contract_table_write::op_type op, uint16_t object_type,
+                                     const table_id_object &tab, uint64_t primary, account_name payer,
+                                     const char *data, size_t size) {
+                if (BOOST_UNLIKELY(_effects != nullptr))
+                    _effects->writes.emplace_back(contract_table_write{op, object_type, tab.code, tab.scope, tab.table,
+                                                                       primary, payer, bytes(data, data + size)});
+            }
+
+            template<typename SecondaryKey>
+            void record_table_effect(contract_table_write::op_type op, uint16_t object_type,
+                                     const table_id_object &tab, uint64_t primary, account_name payer,
+                                     const SecondaryKey &secondary) {
+                record_table_effect(op, object_type, tab, primary, payer,
+                                    reinterpret_cast<const char *>(&secondary), sizeof(secondary));
+            }
+
             int db_store_i64(uint64_t code, uint64_t scope, uint64_t table, const account_name &payer, uint64_t id,
                              const char *buffer, size_t buffer_size);
 
@@ -615,6 +669,7 @@ namespace eosio {
             controller &control;
             chainbase::database &db;  ///< database where state is stored
             transaction_context &trx_context; ///< transaction context in which the action is running
+            db_lookup_cache &lookup_cache; ///< table and secondary key lookups of the transaction
 
         private:
             const action *act = nullptr; ///< action being applied
@@ -642,6 +697,7 @@ namespace eosio {
             std::string _pending_console_output;
             flat_set<account_delta> _account_ram_deltas; ///< flat_set of account_delta so json is an array of objects
             std::string _response;
+            action_effects *_effects = nullptr; ///< set while comparing a native contract implementation with the wasm
             //bytes                               _cached_trx;
         };
 
@@ -36,11 +36,24 @@ namespace eosio {
          *
          * The main file is the only file that needs to persist. The index file can be reconstructed during a
          * linear scan of the main file.
+         *
+         * When a stride is configured, the log is split every `stride` blocks. The current blocks.log and
+         * blocks.index are renamed to blocks-<first>-<last>.log/.index and moved to the retained directory, and
+         * a new blocks.log is started with the next block. Retained segments are complete block logs that are
+         * served read-only. Once there are more than max_retained_files segments, the oldest ones are moved to
+         * the archive directory, or deleted when no archive directory is configured.
          */
 
+        struct block_log_config {
+            uint32_t stride = 0; ///< split the log every stride blocks, 0 for a single ever-growing log
+            uint16_t max_retained_files = std::numeric_limits<uint16_t>::max();
+            fc::path retained_dir; ///< relative to the blocks directory, empty for the blocks directory itself
+            fc::path archive_dir = "archive"; ///< relative to the blocks directory, empty to delete old segments
+        };
+
         class block_log {
         public:
-            block_log(const fc::path &data_dir);
+            block_log(const fc::path &data_dir, const block_log_config &config = block_log_config());
 
             block_log(block_log &&other);
 
@@ -61,7 +74,15 @@ namespace eosio {
             }
 
             /**
-             * Return offset of block in file, or block_log::npos if it does not exist.
+             * Read the serialized bytes of a block exactly as stored in the log, without deserializing it.
+             * The bytes are written to buffer starting at prefix_size so callers can prepend framing
+             * without an additional copy. Returns false if the block is not in the log.
+             */
+            bool read_serialized_block_by_num(uint32_t block_num, std::vector<char> &buffer, size_t prefix_size = 0) const;
+
+            /**
+             * Return offset of block in the current blocks.log, or block_log::npos if it does not exist
+             * there. Blocks in retained segments are only reachable through the read_*_by_num methods.
              */
             uint64_t get_block_pos(uint32_t block_num) const;
 
@@ -76,15 +97,29 @@ namespace eosio {
             static const uint32_t min_supported_version;
             static const uint32_t max_supported_version;
 
-            static fc::path repair_log(const fc::path &data_dir, uint32_t truncate_at_block = 0);
+            /**
+             * Move the blocks directory to a backup and recover blocks.log from it. Retained and archived segments are
+             * moved back unchanged; retained_dir and archive_dir are the block_log_config directories the log was
+             * written with, and segments kept outside of the blocks directory are left where they are.
+             */
+            static fc::path repair_log(const fc::path &data_dir, uint32_t truncate_at_block = 0,
+                                       const fc::path &retained_dir = fc::path(),
+                                       const fc::path &archive_dir = fc::path());
 
             static genesis_state extract_genesis_state(const fc::path &data_dir);
 
+            /**
+             * Rebuild the index of a block log file by scanning the log.
+             */
+            static void construct_index(const fc::path &block_file, const fc::path &index_file);
+
         private:
             void open(const fc::path &data_dir);
 
             void construct_index();
 
+            void split_log();
+
             std::unique_ptr<detail::block_log_impl> my;
         };
 
@@ -17,6 +17,7 @@ namespace eosio {
 
             const static int max_nonce_size = 256;
             const static auto default_blocks_dir_name = "blocks";
+            const static auto default_blocks_archive_dir_name = "archive";
             const static auto reversible_blocks_dir_name = "reversible";
             const static auto default_reversible_cache_size =
                     340 * 1024 * 1024ll;/// 1MB * 340 blocks based on 21 producer BFT delay
@@ -10,6 +10,7 @@
 #include <eosio/chain/account_object.hpp>
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/chain/protocol_feature_manager.hpp>
+#include <eosio/chain/native_contracts.hpp>
 
 namespace chainbase {
     class database;
@@ -78,6 +79,10 @@ namespace eosio {
                 flat_set<pair<account_name, action_name> > action_blacklist;
                 flat_set<public_key_type> key_blacklist;
                 path blocks_dir = chain::config::default_blocks_dir_name;
+                path blocks_retained_dir;
+                path blocks_archive_dir = chain::config::default_blocks_archive_dir_name;
+                uint32_t blocks_log_stride = 0;
+                uint16_t max_retained_block_files = std::numeric_limits<uint16_t>::max();
                 path state_dir = chain::config::default_state_dir_name;
                 path history_dir = chain::config::default_history_dir_name;
                 path history_index_dir = chain::config::default_history_index_dir_name;
@@ -101,6 +106,10 @@ namespace eosio {
 
                 genesis_state genesis;
                 wasm_interface::vm_type wasm_runtime = chain::config::default_wasm_runtime;
+                bool wasm_tiered_compilation = false;
+                uint64_t wasm_cache_size = 0; //< bytes of instantiated modules kept, 0 is unbounded
+                wasm_interface::cache_policy wasm_cache_policy = wasm_interface::cache_policy::lru;
+                native_contract_mode native_contract_execution = native_contract_mode::off;
 
                 db_read_mode read_mode = db_read_mode::SPECULATIVE;
                 validation_mode block_validation_mode = validation_mode::FULL;
@@ -165,6 +174,22 @@ namespace eosio {
              */
             unapplied_transactions_type &get_unapplied_transactions();
 
+            /**
+             *  Removes unapplied transactions that expire before now, by expiration bucket rather than by walking
+             *  all unapplied transactions.
+             *
+             *  @return number of transactions dropped
+             */
+            size_t drop_expired_unapplied_transactions(const fc::time_point &now);
+
+            /**
+             *  Removes all unapplied transactions together with their expiration buckets
+             */
+            void clear_unapplied_transactions();
+
+            /// number of entries in the expiration buckets, which are pruned when unapplied transactions are added
+            size_t unapplied_expiration_entries() const;
+
             /**
              *
              */
@@ -291,6 +316,13 @@ namespace eosio {
 
             signed_block_ptr fetch_block_by_id(block_id_type id) const;
 
+            /**
+             * Write the serialized block to buffer starting at prefix_size. Irreversible blocks are copied from
+             * the block log as stored, without being deserialized. Returns false if the block is unknown.
+             */
+            bool fetch_serialized_block_by_number(uint32_t block_num, std::vector<char> &buffer,
+                                                  size_t prefix_size = 0) const;
+
             block_state_ptr fetch_block_state_by_number(uint32_t block_num) const;
 
             block_state_ptr fetch_block_state_by_id(block_id_type id) const;
@@ -363,6 +395,11 @@ namespace eosio {
 
             void set_subjective_cpu_leeway(fc::microseconds leeway);
 
+            /// record the tables read and written by each transaction in transaction_trace::table_access
+            void set_track_table_access(bool track);
+
+            bool tracks_table_access() const;
+
             void set_greylist_limit(uint32_t limit);
 
             uint32_t get_greylist_limit() const;
@@ -395,6 +432,10 @@ namespace eosio {
 
             wasm_interface &get_wasm_interface();
 
+            const wasm_interface &get_wasm_interface() const;
+
+            native_contracts &get_native_contracts();
+
 
             optional<abi_serializer>
             get_abi_serializer(account_name n, const fc::microseconds &max_serialization_time) const {
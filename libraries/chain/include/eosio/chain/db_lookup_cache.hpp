@@ -0,0 +1,145 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#pragma once
+
+#include <eosio/chain/contract_table_objects.hpp>
+
+#include <boost/functional/hash.hpp>
+
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+
+namespace eosio {
+    namespace chain {
+
+        /**
+         * Results of the table and secondary key lookups made by the db intrinsics of one transaction, so that looking
+         * up the same (code, scope, table) or (table, secondary key) again skips the chainbase indices. Misses are
+         * cached too. apply_context keeps the entries valid: creating or removing a table replaces its entry, and
+         * storing, updating or removing a secondary index row drops the entries of the keys it had and gets.
+         * Undoing the transaction drops everything.
+         *
+         * Only secondary keys compared bitwise are cached; the floating point indices treat distinct encodings
+         * (-0.0 and 0.0) as the same key, which an entry per encoding could not invalidate.
+         */
+        class db_lookup_cache {
+        public:
+            /// entries per map before it is cleared, bounding the memory of a long running transaction
+            static constexpr size_t max_entries = 4096;
+
+            /// false if not cached, otherwise sets tab, to nullptr if the table does not exist
+            bool find_table(name code, name scope, name table, const table_id_object *&tab) const {
+                auto itr = _tables.find(table_key{code.value, scope.value, table.value});
+                if (itr == _tables.end())
+                    return false;
+                tab = itr->second;
+                return true;
+            }
+
+            void cache_table(name code, name scope, name table, const table_id_object *tab) {
+                if (_tables.size() >= max_entries)
+                    _tables.clear();
+                _tables[table_key{code.value, scope.value, table.value}] = tab;
+            }
+
+            /// false if not cached, otherwise sets obj, to nullptr if the table has no row with the key
+            template<typename ObjectType>
+            bool find_secondary(const table_id &t_id, const typename ObjectType::secondary_key_type &secondary,
+                                const ObjectType *&obj) const {
+                if constexpr (is_cached<ObjectType>::value) {
+                    const auto &rows = std::get<secondary_map<ObjectType>>(_secondaries);
+                    auto itr = rows.find(std::make_pair(t_id._id, secondary));
+                    if (itr == rows.end())
+                        return false;
+                    obj = itr->second;
+                    return true;
+                } else {
+                    return false;
+                }
+            }
+
+            template<typename ObjectType>
+            void cache_secondary(const table_id &t_id, const typename ObjectType::secondary_key_type &secondary,
+                                 const ObjectType *obj) {
+                if constexpr (is_cached<ObjectType>::value) {
+                    auto &rows = std::get<secondary_map<ObjectType>>(_secondaries);
+                    if (rows.size() >= max_entries)
+                        rows.clear();
+                    rows[std::make_pair(t_id._id, secondary)] = obj;
+                }
+            }
+
+            template<typename ObjectType>
+            void invalidate_secondary(const table_id &t_id, const typename ObjectType::secondary_key_type &secondary) {
+                if constexpr (is_cached<ObjectType>::value)
+                    std::get<secondary_map<ObjectType>>(_secondaries).erase(std::make_pair(t_id._id, secondary));
+            }
+
+            void clear() {
+                _tables.clear();
+                std::get<secondary_map<index64_object>>(_secondaries).clear();
+                std::get<secondary_map<index128_object>>(_secondaries).clear();
+                std::get<secondary_map<index256_object>>(_secondaries).clear();
+            }
+
+        private:
+            template<typename ObjectType>
+            struct is_cached : std::integral_constant<bool,
+                    std::is_same<ObjectType, index64_object>::value ||
+                    std::is_same<ObjectType, index128_object>::value ||
+                    std::is_same<ObjectType, index256_object>::value> {
+            };
+
+            struct table_key {
+                uint64_t code;
+                uint64_t scope;
+                uint64_t table;
+
+                bool operator==(const table_key &other) const {
+                    return code == other.code && scope == other.scope && table == other.table;
+                }
+            };
+
+            struct key_hash {
+                size_t operator()(const table_key &k) const {
+                    size_t seed = std::hash<uint64_t>()(k.code);
+                    boost::hash_combine(seed, k.scope);
+                    boost::hash_combine(seed, k.table);
+                    return seed;
+                }
+
+                static void combine(size_t &seed, uint64_t v) { boost::hash_combine(seed, v); }
+
+                static void combine(size_t &seed, const uint128_t &v) {
+                    boost::hash_combine(seed, uint64_t(v));
+                    boost::hash_combine(seed, uint64_t(v >> 64));
+                }
+
+                static void combine(size_t &seed, const key256_t &v) {
+                    combine(seed, v[0]);
+                    combine(seed, v[1]);
+                }
+
+                template<typename SecondaryKey>
+                size_t operator()(const std::pair<int64_t, SecondaryKey> &k) const {
+                    size_t seed = std::hash<int64_t>()(k.first);
+                    combine(seed, k.second);
+                    return seed;
+                }
+            };
+
+            template<typename ObjectType>
+            using secondary_map = std::unordered_map<std::pair<int64_t, typename ObjectType::secondary_key_type>,
+                    const ObjectType *, key_hash>;
+
+            std::unordered_map<table_key, const table_id_object *, key_hash> _tables;
+            std::tuple<secondary_map<index64_object>,
+                    secondary_map<index128_object>,
+                    secondary_map<index256_object>> _secondaries;
+        };
+
+    }
+} // namespace eosio::chain
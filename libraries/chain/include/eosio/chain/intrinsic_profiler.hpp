@@ -0,0 +1,129 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <boost/config.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <type_traits>
+
+namespace eosio {
+    namespace chain {
+
+        /**
+         * Process wide counters of intrinsic calls, kept per (receiver, action, intrinsic): number of calls, bytes
+         * passed (the sum of the size_t length arguments) and cumulative time spent in the intrinsic. Counting only
+         * happens while enabled; when disabled each intrinsic call pays a single predicted branch. Building without
+         * EOSIO_INTRINSIC_PROFILER removes the instrumentation entirely.
+         */
+        class intrinsic_profiler {
+        public:
+            struct entry {
+                account_name receiver;
+                action_name action;
+                std::string intrinsic;
+                uint64_t calls = 0;
+                uint64_t bytes = 0;
+                uint64_t time_ns = 0;
+            };
+
+            static bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+            static void set_enabled(bool enabled);
+
+            /// returns the id to record calls of the named intrinsic under
+            static uint32_t register_intrinsic(const char *name);
+
+            static void record(account_name receiver, action_name action, uint32_t intrinsic,
+                               uint64_t bytes, uint64_t time_ns);
+
+            /// entries ordered by descending time, optionally clearing the counters
+            static vector<entry> snapshot(bool reset);
+
+            template<typename... Params>
+            static uint64_t length_args(const Params &... params) {
+                uint64_t bytes = 0;
+                (void) std::initializer_list<int>{(bytes += length_arg(params), 0)...};
+                return bytes;
+            }
+
+            /// times the enclosing intrinsic call when profiling is enabled
+            class scope {
+            public:
+                template<typename Context>
+                scope(const Context &context, uint32_t intrinsic, uint64_t bytes) {
+                    if (BOOST_UNLIKELY(enabled())) {
+                        _receiver = context.get_receiver();
+                        _action = context.get_action().name;
+                        _intrinsic = intrinsic;
+                        _bytes = bytes;
+                        _start = std::chrono::steady_clock::now();
+                        _active = true;
+                    }
+                }
+
+                ~scope() {
+                    if (BOOST_UNLIKELY(_active))
+                        record(_receiver, _action, _intrinsic, _bytes,
+                               std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       std::chrono::steady_clock::now() - _start).count());
+                }
+
+                scope(const scope &) = delete;
+
+                scope &operator=(const scope &) = delete;
+
+            private:
+                bool _active = false;
+                account_name _receiver;
+                action_name _action;
+                uint32_t _intrinsic = 0;
+                uint64_t _bytes = 0;
+                std::chrono::steady_clock::time_point _start;
+            };
+
+        private:
+            template<typename T>
+            static uint64_t length_arg(const T &v) {
+                if constexpr (std::is_same<T, size_t>::value)
+                    return v;
+                else
+                    return 0;
+            }
+
+            static std::atomic<bool> _enabled;
+        };
+
+        /// id of an intrinsic method, assigned when the intrinsic is registered
+        template<typename MethodSig, MethodSig Method>
+        struct intrinsic_profile_id {
+            static uint32_t value;
+        };
+
+        template<typename MethodSig, MethodSig Method>
+        uint32_t intrinsic_profile_id<MethodSig, Method>::value = 0;
+
+    }
+} // namespace eosio::chain
+
+FC_REFLECT(eosio::chain::intrinsic_profiler::entry, (receiver)(action)(intrinsic)(calls)(bytes)(time_ns))
+
+#ifdef EOSIO_INTRINSIC_PROFILER
+#define _REGISTER_INTRINSIC_PROFILE(CLS, METHOD, NAME, SIG)\
+   static const bool _INTRINSIC_NAME(__intrinsic_profile, __COUNTER__) = \
+      (eosio::chain::intrinsic_profile_id<SIG, &CLS::METHOD>::value = \
+         eosio::chain::intrinsic_profiler::register_intrinsic(NAME), true);
+
+#define INTRINSIC_PROFILE_SCOPE(CONTEXT, SIG, METHOD, ...)\
+   eosio::chain::intrinsic_profiler::scope _intrinsic_profile_scope(CONTEXT,\
+      eosio::chain::intrinsic_profile_id<SIG, METHOD>::value,\
+      eosio::chain::intrinsic_profiler::length_args(__VA_ARGS__))
+#else
+#define _REGISTER_INTRINSIC_PROFILE(CLS, METHOD, NAME, SIG)
+#define INTRINSIC_PROFILE_SCOPE(CONTEXT, SIG, METHOD, ...)
+#endif
@@ -0,0 +1,119 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#pragma once
+
+#include <eosio/chain/action.hpp>
+#include <eosio/chain/trace.hpp>
+#include <eosio/chain/types.hpp>
+
+#include <functional>
+#include <iosfwd>
+
+namespace eosio {
+    namespace chain {
+
+        class apply_context;
+
+        /// how the registered native implementations of contract actions are used
+        enum class native_contract_mode {
+            off,    ///< contracts always run as wasm
+            shadow, ///< run the native implementation on a scratch undo session, then the wasm, and compare them
+            native  ///< run the native implementation instead of the wasm
+        };
+
+        std::istream &operator>>(std::istream &in, native_contract_mode &mode);
+
+        std::ostream &operator<<(std::ostream &out, native_contract_mode mode);
+
+        /// a store, update or remove of a contract table row, in the order the action made it
+        struct contract_table_write {
+            enum op_type : uint8_t {
+                store = 0,
+                update = 1,
+                remove = 2
+            };
+
+            uint8_t op = store;
+            uint16_t object_type = 0; ///< chainbase type of the primary row or secondary index entry
+            account_name code;
+            scope_name scope;
+            table_name table;
+            uint64_t primary = 0;
+            account_name payer;
+            bytes value; ///< row data or secondary key, empty for removes
+        };
+
+        /**
+         * The state changes of one execution of a contract action, compared between its native and wasm runs. Only
+         * these are compared: changes made through the privileged intrinsics, such as resource limits, proposed
+         * producers, blockchain parameters, privileges and feature activations, are not, so a native implementation
+         * of an action that makes them is not checked by shadow mode.
+         */
+        struct action_effects {
+            vector<contract_table_write> writes;
+            vector<bytes> deferred; ///< packed scheduled and cancelled deferred transactions
+            vector<account_name> notified;
+            vector<action> inline_actions;
+            vector<action> cfa_inline_actions;
+            vector<account_delta> ram_deltas;
+            string console;
+            string response;
+            optional<string> except;
+
+            /// name of the first field that differs, empty if the effects are the same
+            string difference(const action_effects &other) const;
+        };
+
+        /**
+         * Native implementations of contract actions, keyed by the hash of the contract code they replace and the
+         * action name. A native implementation has to make exactly the state changes of the wasm, through the same
+         * apply_context methods the intrinsics use, so that blocks stay identical; shadow mode checks this on live
+         * traffic before native mode is trusted. Only actions sent to the contract itself run natively, notifications
+         * always run the wasm.
+         */
+        class native_contracts {
+        public:
+            using handler = std::function<void(apply_context &)>;
+
+            struct stats {
+                uint64_t native_runs = 0;
+                uint64_t shadow_runs = 0;
+                uint64_t mismatches = 0;
+            };
+
+            explicit native_contracts(native_contract_mode mode = native_contract_mode::off) : _mode(mode) {}
+
+            native_contract_mode mode() const { return _mode; }
+
+            void set_mode(native_contract_mode mode) { _mode = mode; }
+
+            void add(const digest_type &code_hash, action_name act, handler h);
+
+            /// nullptr when no implementation is registered or the mode is off
+            const handler *find(const digest_type &code_hash, action_name act) const;
+
+            const stats &get_stats() const { return _stats; }
+
+            void record_native_run() { ++_stats.native_runs; }
+
+            void record_shadow_run(bool mismatch) {
+                ++_stats.shadow_runs;
+                if (mismatch)
+                    ++_stats.mismatches;
+            }
+
+        private:
+            native_contract_mode _mode;
+            map<pair<digest_type, action_name>, handler> _handlers;
+            stats _stats;
+        };
+
+    }
+} // namespace eosio::chain
+
+FC_REFLECT(eosio::chain::contract_table_write, (op)(object_type)(code)(scope)(table)(primary)(payer)(value))
+FC_REFLECT(eosio::chain::action_effects,
+           (writes)(deferred)(notified)(inline_actions)(cfa_inline_actions)(ram_deltas)(console)(response)(except))
+FC_REFLECT(eosio::chain::native_contracts::stats, (native_runs)(shadow_runs)(mismatches))
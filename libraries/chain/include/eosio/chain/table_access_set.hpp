@@ -0,0 +1,36 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+namespace eosio {
+    namespace chain {
+
+        /**
+         * Contract tables (code, scope, table) read and written while executing a transaction. Only recorded when
+         * controller::set_track_table_access is enabled. Resource usage billed to an account is recorded as a write
+         * of the pseudo table (eosio, account, resusage) since every transaction billed to the same account updates it.
+         */
+        struct table_access_set {
+            using table_key = std::tuple<name, name, name>;
+
+            flat_set<table_key> reads;
+            flat_set<table_key> writes;
+
+            /// true if either set writes a table the other reads or writes
+            bool conflicts_with(const table_access_set &other) const;
+        };
+
+        /**
+         * Number of rounds needed to execute the transactions, in order, if each round ran concurrently only
+         * transactions that do not conflict with one another. A transaction runs in the round after the latest
+         * earlier transaction it conflicts with, so committing rounds in order keeps the original result.
+         * Equal to trxs.size() when every transaction conflicts with its predecessor.
+         */
+        uint32_t conflict_rounds(const vector<table_access_set> &trxs);
+
+    }
+} // namespace eosio::chain
@@ -8,8 +8,12 @@
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/thread_pool.hpp>
 #include <boost/asio/post.hpp>
+#include <atomic>
+#include <condition_variable>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace eosio {
     namespace chain {
@@ -49,6 +53,45 @@ namespace eosio {
             return task->get_future();
         }
 
+        // calls f(i) for every i in [0, n), on the calling thread and on up to max_tasks tasks posted to thread_pool,
+        // returning once all calls are done. Each posted task first calls init() on its thread. f and init must not
+        // throw. The calling thread takes indices itself and only waits for tasks that have started taking them, so
+        // tasks still queued behind other work of thread_pool never delay it; they find nothing left and return
+        template<typename Init, typename F>
+        void parallel_for(boost::asio::io_context &thread_pool, size_t max_tasks, size_t n, Init &&init, F &&f) {
+            struct shared_state {
+                std::atomic<size_t> next{0};
+                std::mutex mtx;
+                std::condition_variable cv;
+                size_t running = 0; //< posted tasks taking indices
+                bool closed = false; //< set once the caller is done, later tasks must not touch init or f
+            };
+            auto state = std::make_shared<shared_state>();
+            auto run = [&f, n](shared_state &s) {
+                for (size_t i = s.next++; i < n; i = s.next++)
+                    f(i);
+            };
+            for (size_t t = 0; t < max_tasks && t + 1 < n; ++t) {
+                boost::asio::post(thread_pool, [state, &init, &run]() {
+                    {
+                        std::lock_guard<std::mutex> g(state->mtx);
+                        if (state->closed)
+                            return;
+                        ++state->running;
+                    }
+                    init();
+                    run(*state);
+                    std::lock_guard<std::mutex> g(state->mtx);
+                    if (--state->running == 0)
+                        state->cv.notify_all();
+                });
+            }
+            run(*state);
+            std::unique_lock<std::mutex> g(state->mtx);
+            state->closed = true;
+            state->cv.wait(g, [&state]() { return state->running == 0; });
+        }
+
     }
 } // eosio::chain
 
@@ -7,6 +7,7 @@
 #include <eosio/chain/action.hpp>
 #include <eosio/chain/action_receipt.hpp>
 #include <eosio/chain/block.hpp>
+#include <eosio/chain/table_access_set.hpp>
 
 namespace eosio {
     namespace chain {
@@ -72,6 +73,7 @@ namespace eosio {
             fc::optional<fc::exception> except;
             fc::optional<uint64_t> error_code;
             std::exception_ptr except_ptr;
+            std::shared_ptr<table_access_set> table_access; ///< only set when the controller tracks table access
         };
 
     }
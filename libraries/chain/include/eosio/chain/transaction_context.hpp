@@ -1,6 +1,7 @@
 #pragma once
 
 #include <eosio/chain/controller.hpp>
+#include <eosio/chain/db_lookup_cache.hpp>
 #include <eosio/chain/trace.hpp>
 #include <signal.h>
 
@@ -139,6 +140,8 @@ namespace eosio {
             int64_t billed_cpu_time_us = 0;
             bool explicit_billed_cpu_time = false;
 
+            db_lookup_cache lookup_cache;
+
         private:
             bool is_initialized = false;
 
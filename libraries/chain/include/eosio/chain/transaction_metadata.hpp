@@ -7,7 +7,9 @@
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/types.hpp>
 #include <boost/asio/io_context.hpp>
+#include <functional>
 #include <future>
+#include <mutex>
 
 namespace boost {
     namespace asio {
@@ -62,13 +64,31 @@ namespace eosio {
                 signed_id = digest_type::hash(*packed_trx);
             }
 
-            // must be called from main application thread
+            // must be called from main application thread, or from the thread that created mtrx before it is shared
             static signing_keys_future_type
             start_recover_keys(const transaction_metadata_ptr &mtrx, boost::asio::io_context &thread_pool,
                                const chain_id_type &chain_id, fc::microseconds time_limit);
 
             // start_recover_keys must be called first
             recovery_keys_type recover_keys(const chain_id_type &chain_id);
+
+            // start_recover_keys must be called first. callback is called with mtrx on the thread pool once the keys
+            // are recovered, or immediately on the calling thread if they already are. mtrx is kept alive until then
+            // by the pending recovery, so callback should not capture it
+            static void on_keys_recovered(const transaction_metadata_ptr &mtrx,
+                                          std::function<void(const transaction_metadata_ptr &)> callback);
+
+        private:
+            // owned by the posted recovery task, so a transaction waiting on it is released if the task never runs
+            struct recovery_state {
+                std::promise<signing_keys_future_value_type> keys;
+                transaction_metadata_ptr pinned; ///< set while callbacks wait for the recovery
+            };
+
+            std::mutex recovered_mtx;
+            bool keys_recovered = false;
+            std::weak_ptr<recovery_state> pending_recovery;
+            std::vector<std::function<void(const transaction_metadata_ptr &)>> recovered_callbacks;
         };
 
     }
@@ -649,15 +649,16 @@ struct OP final : instr_base<Mutators...> {
 
 /** 
  * Section for cached ops
+ * The ops are per thread, since decoding an op unpacks its immediates into the cached instance
  */
             template<class Op_Types>
             class cached_ops {
 #define GEN_FIELD(r, P, OP) \
-   static std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> BOOST_PP_CAT(P, OP);
+   static thread_local std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> BOOST_PP_CAT(P, OP);
                 BOOST_PP_SEQ_FOR_EACH(GEN_FIELD, cached_, WASM_OP_SEQ)
 #undef GEN_FIELD
 
-                static std::vector<instr *> _cached_ops;
+                static thread_local std::vector<instr *> _cached_ops;
             public:
                 static std::vector<instr *> *get_cached_ops() {
 #define PUSH_BACK_OP(r, T, OP) \
@@ -673,20 +674,20 @@ struct OP final : instr_base<Mutators...> {
             };
 
             template<class Op_Types>
-            std::vector<instr *> cached_ops<Op_Types>::_cached_ops;
+            thread_local std::vector<instr *> cached_ops<Op_Types>::_cached_ops;
 
 #define INIT_FIELD(r, P, OP) \
    template <class Op_Types>   \
-   std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> cached_ops<Op_Types>::BOOST_PP_CAT(P, OP) = std::make_unique<typename Op_Types::BOOST_PP_CAT(OP,_t)>();
+   thread_local std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> cached_ops<Op_Types>::BOOST_PP_CAT(P, OP) = std::make_unique<typename Op_Types::BOOST_PP_CAT(OP,_t)>();
             BOOST_PP_SEQ_FOR_EACH(INIT_FIELD, cached_, WASM_OP_SEQ)
 
             template<class Op_Types>
             std::vector<instr *> *get_cached_ops_vec() {
 #define GEN_FIELD(r, P, OP) \
-   static std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> BOOST_PP_CAT(P, OP) = std::make_unique<typename Op_Types::BOOST_PP_CAT(OP,_t)>();
+   static thread_local std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> BOOST_PP_CAT(P, OP) = std::make_unique<typename Op_Types::BOOST_PP_CAT(OP,_t)>();
                 BOOST_PP_SEQ_FOR_EACH(GEN_FIELD, cached_, WASM_OP_SEQ)
 #undef GEN_FIELD
-                static std::vector<instr *> _cached_ops;
+                static thread_local std::vector<instr *> _cached_ops;
 
 #define PUSH_BACK_OP(r, T, OP) \
       _cached_ops[BOOST_PP_CAT(OP,_code)] = BOOST_PP_CAT(T, OP).get();
@@ -707,10 +708,8 @@ struct OP final : instr_base<Mutators...> {
             template<class Op_Types>
             struct EOSIO_OperatorDecoderStream {
                 EOSIO_OperatorDecoderStream(const std::vector<U8> &codeBytes)
-                        : start(codeBytes.data()), nextByte(codeBytes.data()),
-                          end(codeBytes.data() + codeBytes.size()) {
-                    if (!_cached_ops)
-                        _cached_ops = cached_ops<Op_Types>::get_cached_ops();
+                        : _cached_ops(cached_ops<Op_Types>::get_cached_ops()), start(codeBytes.data()),
+                          nextByte(codeBytes.data()), end(codeBytes.data() + codeBytes.size()) {
                 }
 
                 operator bool() const { return nextByte < end; }
@@ -747,15 +746,23 @@ struct OP final : instr_base<Mutators...> {
                 inline uint32_t index() { return nextByte - start; }
 
             private:
-                // cached ops to take the address of
-                static const std::vector<instr *> *_cached_ops;
+                // cached ops of this thread to take the address of
+                const std::vector<instr *> *_cached_ops;
                 const U8 *start;
                 const U8 *nextByte;
                 const U8 *end;
             };
 
-            template<class Op_Types>
-            const std::vector<instr *> *EOSIO_OperatorDecoderStream<Op_Types>::_cached_ops;
+            // modules with at least this many bytes of function bodies are validated and injected a function at a time
+            // on a thread pool when one is given; for smaller modules the tasks cost more than they save
+            constexpr size_t parallel_code_size = 64 * 1024;
+
+            inline size_t function_code_size(const IR::Module &m) {
+                size_t size = 0;
+                for (const auto &fd : m.functions.defs)
+                    size += fd.code.size();
+                return size;
+            }
 
         }
     }
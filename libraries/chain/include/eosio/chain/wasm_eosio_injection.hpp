@@ -3,8 +3,10 @@
 #include <eosio/chain/wasm_eosio_binary_ops.hpp>
 #include <eosio/chain/wasm_eosio_constraints.hpp>
 #include <eosio/chain/webassembly/common.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/exception/exception.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <exception>
 #include <iostream>
 #include <functional>
 #include <vector>
@@ -23,11 +25,21 @@ namespace eosio {
             using namespace IR;
             // helper functions for injection
 
+            // the injector state is per thread, so that modules can be injected on several threads at once
             struct injector_utils {
-                static std::map<std::vector<uint16_t>, uint32_t> type_slots;
-                static std::map<std::string, uint32_t> registered_injected;
-                static std::map<uint32_t, uint32_t> injected_index_mapping;
-                static uint32_t next_injected_index;
+                using import_adder = void (*)(Module &, const char *, int32_t &);
+
+                // the injected imports a function needs, in the order it first needs them
+                struct recorded_imports {
+                    bool call_depth_global = false;
+                    std::vector<std::pair<const char *, import_adder>> imports;
+                };
+
+                static thread_local std::map<std::vector<uint16_t>, uint32_t> type_slots;
+                static thread_local std::map<std::string, uint32_t> registered_injected;
+                static thread_local std::map<uint32_t, uint32_t> injected_index_mapping;
+                static thread_local uint32_t next_injected_index;
+                static thread_local recorded_imports *recording; ///< when set, imports are recorded instead of added
 
                 static void init(Module &mod) {
                     type_slots.clear();
@@ -35,6 +47,7 @@ namespace eosio {
                     injected_index_mapping.clear();
                     build_type_slots(mod);
                     next_injected_index = 0;
+                    recording = nullptr;
                 }
 
                 static void build_type_slots(Module &mod) {
@@ -67,6 +80,16 @@ namespace eosio {
 
                 template<ResultType Result, ValueType... Params>
                 static void add_import(Module &module, const char *func_name, int32_t &index) {
+                    if (recording) {
+                        auto itr = registered_injected.find(func_name);
+                        if (itr != registered_injected.end()) {
+                            index = itr->second;
+                        } else {
+                            recording->imports.emplace_back(func_name, &add_import<Result, Params...>);
+                            index = 0;
+                        }
+                        return;
+                    }
                     if (module.functions.imports.size() == 0 ||
                         registered_injected.find(func_name) == registered_injected.end()) {
                         add_type_slot<Result, Params...>(module);
@@ -186,10 +209,10 @@ namespace eosio {
                     tcnt++;
                 }
 
-                static uint32_t icnt; /* instructions so far */
-                static uint32_t tcnt; /* total instructions */
-                static uint32_t bcnt; /* total instructions from block types */
-                static std::queue<uint32_t> fcnts;
+                static thread_local uint32_t icnt; /* instructions so far */
+                static thread_local uint32_t tcnt; /* total instructions */
+                static thread_local uint32_t bcnt; /* total instructions from block types */
+                static thread_local std::queue<uint32_t> fcnts;
             };
 
             struct checktime_block_type {
@@ -216,10 +239,10 @@ namespace eosio {
                     type_stack.push(inst->get_code() == wasm_ops::loop_code);
                 }
 
-                static std::stack<size_t> block_stack;
-                static std::stack<size_t> type_stack; /* this might capture more than if a block is a loop in the future */
-                static std::queue<std::vector<size_t>> orderings;  /* record the order in which we found the blocks */
-                static std::queue<std::map<size_t, size_t>> bcnt_tables; /* table for each blocks instruction count */
+                static thread_local std::stack<size_t> block_stack;
+                static thread_local std::stack<size_t> type_stack; /* this might capture more than if a block is a loop in the future */
+                static thread_local std::queue<std::vector<size_t>> orderings;  /* record the order in which we found the blocks */
+                static thread_local std::queue<std::map<size_t, size_t>> bcnt_tables; /* table for each blocks instruction count */
             };
 
             struct checktime_end {
@@ -255,7 +278,7 @@ namespace eosio {
                     fcnt = instruction_counter::tcnt - instruction_counter::bcnt;
                 }
 
-                static size_t fcnt;
+                static thread_local size_t fcnt;
             };
 
             struct checktime_injection {
@@ -275,8 +298,8 @@ namespace eosio {
                     chktm.pack(arg.new_code);
                 }
 
-                static int32_t idx;
-                static int32_t chktm_idx;
+                static thread_local int32_t idx;
+                static thread_local int32_t chktm_idx;
             };
 
             struct fix_call_index {
@@ -301,19 +324,26 @@ namespace eosio {
             struct call_depth_check_and_insert_checktime {
                 static constexpr bool kills = true;
                 static constexpr bool post = false;
-                static int32_t global_idx;
+                static thread_local int32_t global_idx;
 
                 static void init() {
                     global_idx = -1;
                 }
 
-                static void accept(wasm_ops::instr *inst, wasm_ops::visitor_arg &arg) {
+                static void add_global(Module &module) {
                     if (global_idx == -1) {
-                        arg.module->globals.defs.push_back({{ValueType::i32, true},
-                                                            {(I32) eosio::chain::wasm_constraints::maximum_call_depth}});
+                        module.globals.defs.push_back({{ValueType::i32, true},
+                                                       {(I32) eosio::chain::wasm_constraints::maximum_call_depth}});
                     }
 
-                    global_idx = arg.module->globals.size() - 1;
+                    global_idx = module.globals.size() - 1;
+                }
+
+                static void accept(wasm_ops::instr *inst, wasm_ops::visitor_arg &arg) {
+                    if (injector_utils::recording)
+                        injector_utils::recording->call_depth_global = true;
+                    else
+                        add_global(*(arg.module));
 
                     int32_t assert_idx;
                     injector_utils::add_import<ResultType::none>(*(arg.module), "call_depth_assert", assert_idx);
@@ -882,54 +912,150 @@ namespace eosio {
                     call_depth_check_and_insert_checktime::init();
                 }
 
-                void inject() {
+                // with a thread pool, the functions of a large module are rewritten in parallel on up to `threads`
+                // tasks, producing the same module as injecting it serially
+                void inject(boost::asio::io_context *thread_pool = nullptr, size_t threads = 0,
+                            size_t min_parallel_size = wasm_ops::parallel_code_size) {
                     _module_injectors.inject(*_module);
                     // inject checktime first
                     injector_utils::add_import<ResultType::none>(*_module, u8"checktime",
                                                                  checktime_injection::chktm_idx);
 
-                    for (auto &fd : _module->functions.defs) {
-                        wasm_ops::EOSIO_OperatorDecoderStream<pre_op_injectors> pre_decoder(fd.code);
-                        wasm_ops::instruction_stream pre_code(fd.code.size() * 2);
+                    auto &defs = _module->functions.defs;
+                    if (!thread_pool || threads == 0 || wasm_ops::function_code_size(*_module) < min_parallel_size) {
+                        for (auto &fd : defs)
+                            pre_inject(fd);
+                        for (auto &fd : defs)
+                            post_inject(fd);
+                        return;
+                    }
 
-                        while (pre_decoder) {
-                            auto op = pre_decoder.decodeOp();
-                            if (op->is_post()) {
+                    // the indices in the rewritten code depend on the order the injected imports are added in, which
+                    // is the order functions first need them. So the imports each function needs are recorded in
+                    // parallel and added in function order, and only then are the functions rewritten
+                    std::vector<injector_utils::recorded_imports> recorded(defs.size());
+                    std::vector<std::exception_ptr> errors(defs.size());
+                    auto state = injector_state::save();
+                    parallel_for(*thread_pool, threads, defs.size(), [&]() {
+                        state.restore();
+                    }, [&](size_t i) {
+                        injector_utils::recording = &recorded[i];
+                        try {
+                            record_imports(defs[i]);
+                        } catch (...) {
+                            errors[i] = std::current_exception();
+                        }
+                        injector_utils::recording = nullptr;
+                    });
+                    for (size_t i = 0; i < defs.size(); ++i) {
+                        if (errors[i])
+                            std::rethrow_exception(errors[i]);
+                        if (recorded[i].call_depth_global)
+                            call_depth_check_and_insert_checktime::add_global(*_module);
+                        for (const auto &import : recorded[i].imports) {
+                            int32_t index;
+                            import.second(*_module, import.first, index);
+                        }
+                    }
+
+                    // every import is added, so rewriting a function only reads the injector state
+                    state = injector_state::save();
+                    parallel_for(*thread_pool, threads, defs.size(), [&]() {
+                        state.restore();
+                    }, [&](size_t i) {
+                        try {
+                            pre_inject(defs[i]);
+                            post_inject(defs[i]);
+                        } catch (...) {
+                            errors[i] = std::current_exception();
+                        }
+                    });
+                    for (const auto &error : errors) {
+                        if (error)
+                            std::rethrow_exception(error);
+                    }
+                }
+
+            private:
+                // the state rewriting a function reads, copied to the threads of the pool
+                struct injector_state {
+                    std::map<std::vector<uint16_t>, uint32_t> type_slots;
+                    std::map<std::string, uint32_t> registered_injected;
+                    std::map<uint32_t, uint32_t> injected_index_mapping;
+                    uint32_t next_injected_index;
+                    int32_t chktm_idx;
+                    int32_t global_idx;
+
+                    static injector_state save() {
+                        return {injector_utils::type_slots, injector_utils::registered_injected,
+                                injector_utils::injected_index_mapping, injector_utils::next_injected_index,
+                                checktime_injection::chktm_idx, call_depth_check_and_insert_checktime::global_idx};
+                    }
+
+                    void restore() const {
+                        injector_utils::type_slots = type_slots;
+                        injector_utils::registered_injected = registered_injected;
+                        injector_utils::injected_index_mapping = injected_index_mapping;
+                        injector_utils::next_injected_index = next_injected_index;
+                        injector_utils::recording = nullptr;
+                        checktime_injection::chktm_idx = chktm_idx;
+                        call_depth_check_and_insert_checktime::global_idx = global_idx;
+                    }
+                };
+
+                // runs the pre injectors over a function without keeping the rewritten code
+                void record_imports(IR::FunctionDef &fd) {
+                    wasm_ops::EOSIO_OperatorDecoderStream<pre_op_injectors> pre_decoder(fd.code);
+                    wasm_ops::instruction_stream scratch(64);
+
+                    while (pre_decoder) {
+                        auto op = pre_decoder.decodeOp();
+                        scratch.idx = 0;
+                        op->visit({_module, &scratch, &fd, pre_decoder.index()});
+                    }
+                }
+
+                void pre_inject(IR::FunctionDef &fd) {
+                    wasm_ops::EOSIO_OperatorDecoderStream<pre_op_injectors> pre_decoder(fd.code);
+                    wasm_ops::instruction_stream pre_code(fd.code.size() * 2);
+
+                    while (pre_decoder) {
+                        auto op = pre_decoder.decodeOp();
+                        if (op->is_post()) {
+                            op->pack(&pre_code);
+                            op->visit({_module, &pre_code, &fd, pre_decoder.index()});
+                        } else {
+                            op->visit({_module, &pre_code, &fd, pre_decoder.index()});
+                            if (!(op->is_kill()))
                                 op->pack(&pre_code);
-                                op->visit({_module, &pre_code, &fd, pre_decoder.index()});
-                            } else {
-                                op->visit({_module, &pre_code, &fd, pre_decoder.index()});
-                                if (!(op->is_kill()))
-                                    op->pack(&pre_code);
-                            }
                         }
-                        fd.code = pre_code.get();
                     }
-                    for (auto &fd : _module->functions.defs) {
-                        wasm_ops::EOSIO_OperatorDecoderStream<post_op_injectors> post_decoder(fd.code);
-                        wasm_ops::instruction_stream post_code(fd.code.size() * 2);
-
-                        wasm_ops::op_types<>::call_t chktm;
-                        chktm.field = injector_utils::injected_index_mapping.find(
-                                checktime_injection::chktm_idx)->second;
-                        chktm.pack(&post_code);
-
-                        while (post_decoder) {
-                            auto op = post_decoder.decodeOp();
-                            if (op->is_post()) {
+                    fd.code = pre_code.get();
+                }
+
+                void post_inject(IR::FunctionDef &fd) {
+                    wasm_ops::EOSIO_OperatorDecoderStream<post_op_injectors> post_decoder(fd.code);
+                    wasm_ops::instruction_stream post_code(fd.code.size() * 2);
+
+                    wasm_ops::op_types<>::call_t chktm;
+                    chktm.field = injector_utils::injected_index_mapping.find(
+                            checktime_injection::chktm_idx)->second;
+                    chktm.pack(&post_code);
+
+                    while (post_decoder) {
+                        auto op = post_decoder.decodeOp();
+                        if (op->is_post()) {
+                            op->pack(&post_code);
+                            op->visit({_module, &post_code, &fd, post_decoder.index()});
+                        } else {
+                            op->visit({_module, &post_code, &fd, post_decoder.index()});
+                            if (!(op->is_kill()))
                                 op->pack(&post_code);
-                                op->visit({_module, &post_code, &fd, post_decoder.index()});
-                            } else {
-                                op->visit({_module, &post_code, &fd, post_decoder.index()});
-                                if (!(op->is_kill()))
-                                    op->pack(&post_code);
-                            }
                         }
-                        fd.code = post_code.get();
                     }
+                    fd.code = post_code.get();
                 }
 
-            private:
                 IR::Module *_module;
                 static std::string op_string;
                 static standard_module_injectors _module_injectors;
@@ -4,6 +4,8 @@
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/wasm_eosio_binary_ops.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <exception>
 #include <functional>
 #include <vector>
 #include <iostream>
@@ -108,20 +110,31 @@ namespace eosio {
                 }
             };
 
+            // the depth carries over from one function to the next, so when functions are validated in parallel each
+            // records its block and end instructions and they are replayed in function order afterwards
             struct nested_validator {
                 static constexpr bool kills = false;
                 static constexpr bool post = false;
-                static bool disabled;
-                static uint16_t depth;
+                static thread_local bool disabled;
+                static thread_local uint16_t depth;
+                static thread_local std::vector<bool> *recording; ///< true for each end, false for each block
 
                 static void init(bool disable) {
                     disabled = disable;
                     depth = 0;
+                    recording = nullptr;
                 }
 
                 static void accept(wasm_ops::instr *inst, wasm_ops::visitor_arg &arg) {
+                    if (recording)
+                        recording->push_back(inst->get_code() == wasm_ops::end_code);
+                    else
+                        nest(inst->get_code() == wasm_ops::end_code);
+                }
+
+                static void nest(bool is_end) {
                     if (!disabled) {
-                        if (inst->get_code() == wasm_ops::end_code && depth > 0) {
+                        if (is_end && depth > 0) {
                             depth--;
                             return;
                         }
@@ -343,25 +356,65 @@ namespace eosio {
                         maximum_function_stack_visitor,
                         ensure_apply_exported_visitor>;
             public:
-                wasm_binary_validation(const eosio::chain::controller &control, IR::Module &mod) : _module(&mod) {
+                wasm_binary_validation(const eosio::chain::controller &control, IR::Module &mod)
+                        : wasm_binary_validation(mod, control.is_producing_block()) {}
+
+                wasm_binary_validation(IR::Module &mod, bool check_nesting) : _module(&mod), _check_nesting(check_nesting) {
                     // initialize validators here
-                    nested_validator::init(!control.is_producing_block());
+                    nested_validator::init(!check_nesting);
                 }
 
-                void validate() {
+                // with a thread pool, the functions of a large module are validated in parallel on up to `threads`
+                // tasks. Whether it passes, and the error when it does not, are the same as validating it serially
+                void validate(boost::asio::io_context *thread_pool = nullptr, size_t threads = 0,
+                              size_t min_parallel_size = wasm_ops::parallel_code_size) {
                     _module_validators.validate(*_module);
-                    for (auto &fd : _module->functions.defs) {
-                        wasm_ops::EOSIO_OperatorDecoderStream<op_constrainers> decoder(fd.code);
-                        while (decoder) {
-                            wasm_ops::instruction_stream new_code(0);
-                            auto op = decoder.decodeOp();
-                            op->visit({_module, &new_code, &fd, decoder.index()});
+                    auto &defs = _module->functions.defs;
+                    if (!thread_pool || threads == 0 || wasm_ops::function_code_size(*_module) < min_parallel_size) {
+                        for (auto &fd : defs)
+                            validate_function(fd);
+                        return;
+                    }
+
+                    struct function_result {
+                        std::vector<bool> nesting;
+                        std::exception_ptr error;
+                    };
+                    std::vector<function_result> results(defs.size());
+                    parallel_for(*thread_pool, threads, defs.size(), []() {
+                        nested_validator::init(true);
+                    }, [&](size_t i) {
+                        auto &r = results[i];
+                        nested_validator::recording = _check_nesting ? &r.nesting : nullptr;
+                        try {
+                            validate_function(defs[i]);
+                        } catch (...) {
+                            r.error = std::current_exception();
                         }
+                        nested_validator::recording = nullptr;
+                    });
+                    // a function's recording stops at its first error, so replaying it raises whichever error the
+                    // serial validation would have hit first
+                    for (const auto &r : results) {
+                        for (bool is_end : r.nesting)
+                            nested_validator::nest(is_end);
+                        if (r.error)
+                            std::rethrow_exception(r.error);
                     }
                 }
 
             private:
+                void validate_function(IR::FunctionDef &fd) {
+                    wasm_ops::EOSIO_OperatorDecoderStream<op_constrainers> decoder(fd.code);
+                    while (decoder) {
+                        wasm_ops::instruction_stream new_code(0);
+                        auto op = decoder.decodeOp();
+                        op->visit({_module, &new_code, &fd, decoder.index()});
+                    }
+                }
+
                 IR::Module *_module;
+                bool _check_nesting;
                 static standard_module_constraints_validators _module_validators;
             };
 
@@ -7,6 +7,12 @@
 #include "Runtime/Linker.h"
 #include "Runtime/Runtime.h"
 
+namespace boost {
+    namespace asio {
+        class io_context;
+    }
+}
+
 namespace eosio {
     namespace chain {
 
@@ -83,7 +89,26 @@ namespace eosio {
                 wabt
             };
 
-            wasm_interface(vm_type vm, const chainbase::database &db);
+            //which instantiated modules are evicted first once the cache is over its budget
+            enum class cache_policy {
+                lru, //< least recently used
+                lfu  //< fewest executions, then least recently used
+            };
+
+            struct cache_stats {
+                uint32_t entries = 0;
+                uint64_t code_bytes = 0;        //< estimated memory of the instantiated modules
+                uint64_t budget = 0;            //< 0 when unbounded
+                uint64_t hits = 0;              //< applies that found their module instantiated
+                uint64_t misses = 0;
+                uint64_t lib_evictions = 0;     //< entries of replaced code dropped once irreversible
+                uint64_t budget_evictions = 0;
+                uint64_t compiles = 0;          //< modules instantiated, by either tier and by precompile
+                uint64_t compile_time_us = 0;   //< spent injecting and instantiating them, background threads included
+            };
+
+            //with tiered_compilation, code runs on the wabt interpreter until wavm has compiled it in the background
+            wasm_interface(vm_type vm, const chainbase::database &db, bool tiered_compilation = false);
 
             ~wasm_interface();
 
@@ -91,7 +116,18 @@ namespace eosio {
             void indicate_shutting_down();
 
             //validates code -- does a WASM validation pass and checks the wasm against EOSIO specific constraints
-            static void validate(const controller &control, const bytes &code);
+            void validate(const controller &control, const bytes &code) const;
+
+            //validate and inject the functions of large contracts in parallel on up to threads tasks of thread_pool
+            void set_thread_pool(boost::asio::io_context &thread_pool, size_t threads);
+
+            //bound the instantiated modules to about budget bytes, evicting by policy when over it; 0 is unbounded
+            void set_cache_budget(uint64_t budget, cache_policy policy);
+
+            cache_stats get_cache_stats() const;
+
+            //true once code runs on a module of the configured runtime, not on the tiered compilation interpreter
+            bool is_compiled(const digest_type &code_hash, const uint8_t &vm_type, const uint8_t &vm_version) const;
 
             //indicate that a particular code probably won't be used after given block_num
             void
@@ -101,6 +137,9 @@ namespace eosio {
             //indicate the current LIB. evicts old cache entries
             void current_lib(const uint32_t lib);
 
+            //instantiate all deployed contracts now rather than on first use. returns the number instantiated
+            size_t precompile_contracts();
+
             //Calls apply or error on a given code
             void apply(const digest_type &code_hash, const uint8_t &vm_type, const uint8_t &vm_version,
                        apply_context &context);
@@ -120,7 +159,12 @@ namespace eosio {
 namespace eosio {
     namespace chain {
         std::istream &operator>>(std::istream &in, wasm_interface::vm_type &runtime);
+
+        std::istream &operator>>(std::istream &in, wasm_interface::cache_policy &policy);
     }
 }
 
 FC_REFLECT_ENUM(eosio::chain::wasm_interface::vm_type, (wavm)(wabt))
+FC_REFLECT_ENUM(eosio::chain::wasm_interface::cache_policy, (lru)(lfu))
+FC_REFLECT(eosio::chain::wasm_interface::cache_stats,
+           (entries)(code_bytes)(budget)(hits)(misses)(lib_evictions)(budget_evictions)(compiles)(compile_time_us))
@@ -8,8 +8,12 @@
 #include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/code_object.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/intrinsic_profiler.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <mutex>
+
 #include "IR/Module.h"
 #include "Runtime/Intrinsics.h"
 #include "Platform/Platform.h"
@@ -33,27 +37,66 @@ namespace eosio {
                 std::unique_ptr<wasm_instantiated_module_interface> module;
                 uint8_t vm_type = 0;
                 uint8_t vm_version = 0;
+                //tiered compilation: runs the code until the compiled module is installed in module
+                std::unique_ptr<wasm_instantiated_module_interface> interpreted_module;
+                bool compiling = false;
+                //estimated memory of the instantiated code, 0 until instantiated
+                uint64_t code_bytes = 0;
+                //not indexed, so updated in place on every apply rather than through modify
+                mutable uint64_t executions = 0;
+                mutable uint64_t last_used = 0;
             };
             struct by_hash;
             struct by_first_block_num;
             struct by_last_block_num;
 
-            wasm_interface_impl(wasm_interface::vm_type vm, const chainbase::database &d) : db(d) {
+            //parsed, injected and re-serialized code, ready to hand to a runtime
+            struct injected_code {
+                std::vector<U8> bytes;
+                std::vector<uint8_t> initial_memory;
+
+                //what the cache budget charges for a module instantiated from this code
+                uint64_t size() const { return bytes.size() + initial_memory.size(); }
+            };
+
+            //result of a background compilation, installed on the main thread
+            struct compiled_module {
+                digest_type code_hash;
+                uint8_t vm_type = 0;
+                uint8_t vm_version = 0;
+                std::unique_ptr<wasm_instantiated_module_interface> module;
+                fc::microseconds compile_time;
+            };
+
+            wasm_interface_impl(wasm_interface::vm_type vm, const chainbase::database &d, bool tiered_compilation)
+                    : db(d) {
                 if (vm == wasm_interface::vm_type::wavm)
                     runtime_interface = std::make_unique<webassembly::wavm::wavm_runtime>();
                 else if (vm == wasm_interface::vm_type::wabt)
                     runtime_interface = std::make_unique<webassembly::wabt_runtime::wabt_runtime>();
                 else
                     EOS_THROW(wasm_exception, "wasm_interface_impl fall through");
+
+                if (tiered_compilation) {
+                    EOS_ASSERT(vm == wasm_interface::vm_type::wavm, wasm_exception,
+                               "tiered compilation requires the wavm runtime");
+                    interpreter_interface = std::make_unique<webassembly::wabt_runtime::wabt_runtime>();
+                    compile_thread_pool = std::make_unique<named_thread_pool>("wasmc", 1);
+                }
             }
 
             ~wasm_interface_impl() {
-                if (is_shutting_down)
+                if (compile_thread_pool)
+                    compile_thread_pool->stop();
+                if (is_shutting_down) {
                     for (wasm_cache_index::iterator it = wasm_instantiation_cache.begin();
                          it != wasm_instantiation_cache.end(); ++it)
                         wasm_instantiation_cache.modify(it, [](wasm_cache_entry &e) {
                             e.module.release();
                         });
+                    for (auto &c : compiled_modules)
+                        c.module.release();
+                }
             }
 
             std::vector<uint8_t> parse_initial_memory(const Module &module) {
@@ -88,14 +131,48 @@ namespace eosio {
 
             void current_lib(uint32_t lib) {
                 //anything last used before or on the LIB can be evicted
-                wasm_instantiation_cache.get<by_last_block_num>().erase(
-                        wasm_instantiation_cache.get<by_last_block_num>().begin(),
-                        wasm_instantiation_cache.get<by_last_block_num>().upper_bound(lib));
+                auto &idx = wasm_instantiation_cache.get<by_last_block_num>();
+                const auto end = idx.upper_bound(lib);
+                for (auto i = idx.begin(); i != end; ++i) {
+                    cache_code_bytes -= i->code_bytes;
+                    ++stats.lib_evictions;
+                }
+                idx.erase(idx.begin(), end);
+            }
+
+            bool evict_before(const wasm_cache_entry &a, const wasm_cache_entry &b) const {
+                if (cache_policy == wasm_interface::cache_policy::lfu && a.executions != b.executions)
+                    return a.executions < b.executions;
+                return a.last_used < b.last_used;
+            }
+
+            //evicts instantiated modules by the cache policy until they fit in the budget, sparing keep, the module
+            // about to run. Only called between actions on the main thread, so no evicted module is running
+            void enforce_cache_budget(const wasm_cache_entry *keep) {
+                if (!cache_budget)
+                    return;
+                while (cache_code_bytes > cache_budget) {
+                    auto victim = wasm_instantiation_cache.end();
+                    for (auto i = wasm_instantiation_cache.begin(); i != wasm_instantiation_cache.end(); ++i) {
+                        if (&*i == keep || !i->code_bytes)
+                            continue;
+                        if (victim == wasm_instantiation_cache.end() || evict_before(*i, *victim))
+                            victim = i;
+                    }
+                    if (victim == wasm_instantiation_cache.end())
+                        return; //keep alone is over the budget
+                    cache_code_bytes -= victim->code_bytes;
+                    wasm_instantiation_cache.erase(victim);
+                    ++stats.budget_evictions;
+                }
             }
 
             const std::unique_ptr<wasm_instantiated_module_interface> &
             get_instantiated_module(const digest_type &code_hash, const uint8_t &vm_type,
                                     const uint8_t &vm_version, transaction_context &trx_context) {
+                if (interpreter_interface)
+                    install_compiled_modules();
+
                 wasm_cache_index::iterator it = wasm_instantiation_cache.find(
                         boost::make_tuple(code_hash, vm_type, vm_version));
                 const code_object *codeobject = nullptr;
@@ -111,52 +188,214 @@ namespace eosio {
                             .vm_version = vm_version
                     }).first;
                 }
+                it->last_used = ++cache_tick;
+                ++it->executions;
 
-                if (!it->module) {
-                    if (!codeobject)
-                        codeobject = &db.get<code_object, by_code_hash>(
-                                boost::make_tuple(code_hash, vm_type, vm_version));
+                if (it->module) {
+                    ++stats.hits;
+                    running_runtime = runtime_interface.get();
+                    return it->module;
+                }
+                if (interpreter_interface && it->interpreted_module) {
+                    ++stats.hits;
+                    running_runtime = interpreter_interface.get();
+                    return it->interpreted_module;
+                }
+                ++stats.misses;
+
+                if (!codeobject)
+                    codeobject = &db.get<code_object, by_code_hash>(
+                            boost::make_tuple(code_hash, vm_type, vm_version));
 
-                    auto timer_pause = fc::make_scoped_exit([&]() {
-                        trx_context.resume_billing_timer();
+                auto timer_pause = fc::make_scoped_exit([&]() {
+                    trx_context.resume_billing_timer();
+                });
+                trx_context.pause_billing_timer();
+
+                if (!interpreter_interface) {
+                    wasm_instantiation_cache.modify(it, [&](auto &c) {
+                        c.module = instantiate_module(*codeobject, c.code_bytes);
                     });
-                    trx_context.pause_billing_timer();
-                    IR::Module module;
-                    try {
-                        Serialization::MemoryInputStream stream((const U8 *) codeobject->code.data(),
-                                                                codeobject->code.size());
-                        WASM::serialize(stream, module);
-                        module.userSections.clear();
-                    } catch (const Serialization::FatalSerializationException &e) {
-                        EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-                    } catch (const IR::ValidationException &e) {
-                        EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-                    }
+                    cache_code_bytes += it->code_bytes;
+                    enforce_cache_budget(&*it);
+                    running_runtime = runtime_interface.get();
+                    return it->module;
+                }
+
+                //tiered: interpret now, swap in the compiled module once the background compile finishes
+                const auto start = fc::time_point::now();
+                auto code = inject_code(*codeobject);
+                auto interpreted = interpreter_interface->instantiate_module((const char *) code.bytes.data(),
+                                                                             code.bytes.size(), code.initial_memory);
+                record_compile(fc::time_point::now() - start);
+                wasm_instantiation_cache.modify(it, [&](auto &c) {
+                    c.interpreted_module = std::move(interpreted);
+                    c.code_bytes = code.size();
+                });
+                cache_code_bytes += it->code_bytes;
+                enforce_cache_budget(&*it);
+                if (!it->compiling) {
+                    wasm_instantiation_cache.modify(it, [](auto &c) {
+                        c.compiling = true;
+                    });
+                    compile_in_background(code_hash, vm_type, vm_version, std::move(code));
+                }
+                running_runtime = interpreter_interface.get();
+                return it->interpreted_module;
+            }
+
+            injected_code inject_code(const code_object &codeobject) {
+                IR::Module module;
+                try {
+                    Serialization::MemoryInputStream stream((const U8 *) codeobject.code.data(),
+                                                            codeobject.code.size());
+                    WASM::serialize(stream, module);
+                    module.userSections.clear();
+                } catch (const Serialization::FatalSerializationException &e) {
+                    EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+                } catch (const IR::ValidationException &e) {
+                    EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+                }
+
+                wasm_injections::wasm_binary_injection injector(module);
+                injector.inject(thread_pool, thread_pool_threads);
+
+                injected_code code;
+                try {
+                    Serialization::ArrayOutputStream outstream;
+                    WASM::serialize(outstream, module);
+                    code.bytes = outstream.getBytes();
+                } catch (const Serialization::FatalSerializationException &e) {
+                    EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+                } catch (const IR::ValidationException &e) {
+                    EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+                }
+                code.initial_memory = parse_initial_memory(module);
+                return code;
+            }
 
-                    wasm_injections::wasm_binary_injection injector(module);
-                    injector.inject();
+            std::unique_ptr<wasm_instantiated_module_interface>
+            instantiate_module(const code_object &codeobject, uint64_t &code_bytes) {
+                const auto start = fc::time_point::now();
+                auto code = inject_code(codeobject);
+                code_bytes = code.size();
+                auto module = runtime_interface->instantiate_module((const char *) code.bytes.data(),
+                                                                    code.bytes.size(), std::move(code.initial_memory));
+                record_compile(fc::time_point::now() - start);
+                return module;
+            }
+
+            void record_compile(const fc::microseconds &elapsed) {
+                ++stats.compiles;
+                stats.compile_time_us += elapsed.count();
+            }
 
-                    std::vector<U8> bytes;
+            //both tiers are handed the same injected bytes, so they execute the same code
+            void compile_in_background(const digest_type &code_hash, uint8_t vm_type, uint8_t vm_version,
+                                       injected_code code) {
+                boost::asio::post(compile_thread_pool->get_executor(),
+                                  [this, code_hash, vm_type, vm_version, code{std::move(code)}]() mutable {
+                    compiled_module compiled{code_hash, vm_type, vm_version, nullptr};
+                    const auto start = fc::time_point::now();
                     try {
-                        Serialization::ArrayOutputStream outstream;
-                        WASM::serialize(outstream, module);
-                        bytes = outstream.getBytes();
-                    } catch (const Serialization::FatalSerializationException &e) {
-                        EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-                    } catch (const IR::ValidationException &e) {
-                        EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+                        compiled.module = runtime_interface->instantiate_module(
+                                (const char *) code.bytes.data(), code.bytes.size(), std::move(code.initial_memory));
+                    } catch (const fc::exception &e) {
+                        wlog("background compile of ${h} failed, it will stay interpreted: ${e}",
+                             ("h", code_hash)("e", e.to_detail_string()));
+                    } catch (const std::exception &e) {
+                        wlog("background compile of ${h} failed, it will stay interpreted: ${e}",
+                             ("h", code_hash)("e", e.what()));
+                    } catch (...) {
+                        wlog("background compile of ${h} failed, it will stay interpreted", ("h", code_hash));
                     }
+                    compiled.compile_time = fc::time_point::now() - start;
+                    std::lock_guard<std::mutex> g(compiled_modules_mtx);
+                    compiled_modules.emplace_back(std::move(compiled));
+                });
+            }
 
-                    wasm_instantiation_cache.modify(it, [&](auto &c) {
-                        c.module = runtime_interface->instantiate_module((const char *) bytes.data(), bytes.size(),
-                                                                         parse_initial_memory(module));
+            //called between actions on the main thread, so a module is never swapped while it is running
+            void install_compiled_modules() {
+                std::vector<compiled_module> compiled;
+                {
+                    std::lock_guard<std::mutex> g(compiled_modules_mtx);
+                    if (compiled_modules.empty())
+                        return;
+                    compiled.swap(compiled_modules);
+                }
+                for (auto &c : compiled) {
+                    record_compile(c.compile_time);
+                    if (!c.module)
+                        continue;
+                    auto it = wasm_instantiation_cache.find(boost::make_tuple(c.code_hash, c.vm_type, c.vm_version));
+                    if (it == wasm_instantiation_cache.end())
+                        continue; //evicted while compiling
+                    wasm_instantiation_cache.modify(it, [&](auto &e) {
+                        e.module = std::move(c.module);
+                        e.interpreted_module.reset();
                     });
                 }
-                return it->module;
+            }
+
+            /// instantiate every deployed contract not yet instantiated
+            size_t precompile_contracts() {
+                size_t count = 0;
+                const auto &idx = db.get_index<code_index, by_code_hash>();
+                for (const auto &codeobject : idx) {
+                    if (codeobject.code_ref_count == 0) continue;
+                    auto it = wasm_instantiation_cache.find(
+                            boost::make_tuple(codeobject.code_hash, codeobject.vm_type, codeobject.vm_version));
+                    if (it != wasm_instantiation_cache.end() && (it->module || it->compiling)) continue;
+                    if (cache_budget && cache_code_bytes >= cache_budget) {
+                        wlog("wasm cache budget of ${b} bytes reached, the remaining contracts instantiate on first use",
+                             ("b", cache_budget));
+                        break;
+                    }
+                    if (it == wasm_instantiation_cache.end()) {
+                        it = wasm_instantiation_cache.emplace(wasm_interface_impl::wasm_cache_entry{
+                                .code_hash = codeobject.code_hash,
+                                .first_block_num_used = codeobject.first_block_used,
+                                .last_block_num_used = UINT32_MAX,
+                                .module = nullptr,
+                                .vm_type = codeobject.vm_type,
+                                .vm_version = codeobject.vm_version
+                        }).first;
+                    }
+                    try {
+                        uint64_t code_bytes = 0;
+                        auto module = instantiate_module(codeobject, code_bytes);
+                        wasm_instantiation_cache.modify(it, [&](auto &c) {
+                            c.module = std::move(module);
+                            c.code_bytes = code_bytes;
+                        });
+                        cache_code_bytes += code_bytes;
+                        ++count;
+                    } catch (const fc::exception &e) {
+                        // instantiated, and fails, on first use as before
+                        wlog("unable to precompile contract ${h}: ${e}",
+                             ("h", codeobject.code_hash)("e", e.to_detail_string()));
+                    }
+                }
+                return count;
             }
 
             bool is_shutting_down = false;
             std::unique_ptr<wasm_runtime_interface> runtime_interface;
+            std::unique_ptr<wasm_runtime_interface> interpreter_interface; //< set only with tiered compilation
+            wasm_runtime_interface *running_runtime = nullptr; //< runtime of the module last handed out
+
+            std::unique_ptr<named_thread_pool> compile_thread_pool;
+            boost::asio::io_context *thread_pool = nullptr; //< chain thread pool, for parallel validation and injection
+            size_t thread_pool_threads = 0;
+            std::mutex compiled_modules_mtx;
+            std::vector<compiled_module> compiled_modules;
+
+            uint64_t cache_budget = 0; //< bytes, 0 is unbounded
+            wasm_interface::cache_policy cache_policy = wasm_interface::cache_policy::lru;
+            uint64_t cache_code_bytes = 0; //< sum of the code_bytes of the cache entries
+            uint64_t cache_tick = 0; //< counts applies, orders the entries by last use
+            wasm_interface::cache_stats stats; //< counters only, the rest is filled in by get_cache_stats
 
             typedef boost::multi_index_container<
                     wasm_cache_entry,
@@ -178,6 +417,7 @@ namespace eosio {
         };
 
 #define _REGISTER_INTRINSIC_EXPLICIT(CLS, MOD, METHOD, WASM_SIG, NAME, SIG)\
+   _REGISTER_INTRINSIC_PROFILE(CLS, METHOD, NAME, SIG)\
    _REGISTER_WAVM_INTRINSIC(CLS, MOD, METHOD, WASM_SIG, NAME, SIG)\
    _REGISTER_WABT_INTRINSIC(CLS, MOD, METHOD, WASM_SIG, NAME, SIG)
 
@@ -4,6 +4,7 @@
 #include <eosio/chain/webassembly/runtime_interface.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/apply_context.hpp>
+#include <eosio/chain/intrinsic_profiler.hpp>
 #include <softfloat_types.h>
 
 //wabt includes
@@ -689,6 +690,7 @@ namespace eosio {
                     template<MethodSig Method>
                     static Ret wrapper(wabt_apply_instance_vars &vars, Params... params, const TypedValues &, int) {
                         class_from_wasm<Cls>::value(vars.ctx).checktime();
+                        INTRINSIC_PROFILE_SCOPE(vars.ctx, MethodSig, Method, params...);
                         return (class_from_wasm<Cls>::value(vars.ctx).*Method)(params...);
                     }
 
@@ -706,6 +708,7 @@ namespace eosio {
                     static void_type
                     wrapper(wabt_apply_instance_vars &vars, Params... params, const TypedValues &args, int offset) {
                         class_from_wasm<Cls>::value(vars.ctx).checktime();
+                        INTRINSIC_PROFILE_SCOPE(vars.ctx, MethodSig, Method, params...);
                         (class_from_wasm<Cls>::value(vars.ctx).*Method)(params...);
                         return void_type();
                     }
@@ -4,6 +4,7 @@
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/webassembly/runtime_interface.hpp>
 #include <eosio/chain/apply_context.hpp>
+#include <eosio/chain/intrinsic_profiler.hpp>
 #include <softfloat.hpp>
 #include "Runtime/Runtime.h"
 #include "IR/Types.h"
@@ -667,6 +668,7 @@ namespace eosio {
                     template<MethodSig Method>
                     static Ret wrapper(running_instance_context &ctx, Params... params) {
                         class_from_wasm<Cls>::value(*ctx.apply_ctx).checktime();
+                        INTRINSIC_PROFILE_SCOPE(*ctx.apply_ctx, MethodSig, Method, params...);
                         return (class_from_wasm<Cls>::value(*ctx.apply_ctx).*Method)(params...);
                     }
 
@@ -686,6 +688,7 @@ namespace eosio {
                     template<MethodSig Method>
                     static void_type wrapper(running_instance_context &ctx, Params... params) {
                         class_from_wasm<Cls>::value(*ctx.apply_ctx).checktime();
+                        INTRINSIC_PROFILE_SCOPE(*ctx.apply_ctx, MethodSig, Method, params...);
                         (class_from_wasm<Cls>::value(*ctx.apply_ctx).*Method)(params...);
                         return void_type();
                     }
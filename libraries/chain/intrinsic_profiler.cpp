@@ -0,0 +1,99 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#include <eosio/chain/intrinsic_profiler.hpp>
+
+#include <boost/functional/hash.hpp>
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace eosio {
+    namespace chain {
+
+        std::atomic<bool> intrinsic_profiler::_enabled{false};
+
+        namespace {
+            struct profile_key {
+                uint64_t receiver;
+                uint64_t action;
+                uint32_t intrinsic;
+
+                bool operator==(const profile_key &other) const {
+                    return receiver == other.receiver && action == other.action && intrinsic == other.intrinsic;
+                }
+            };
+
+            struct profile_key_hash {
+                size_t operator()(const profile_key &k) const {
+                    size_t seed = std::hash<uint64_t>()(k.receiver);
+                    boost::hash_combine(seed, k.action);
+                    boost::hash_combine(seed, k.intrinsic);
+                    return seed;
+                }
+            };
+
+            struct profile_counters {
+                uint64_t calls = 0;
+                uint64_t bytes = 0;
+                uint64_t time_ns = 0;
+            };
+
+            struct profile_state {
+                std::mutex mtx;
+                vector<std::string> names{"<unregistered>"};
+                std::unordered_map<profile_key, profile_counters, profile_key_hash> counters;
+
+                static profile_state &get() {
+                    static profile_state state;
+                    return state;
+                }
+            };
+        }
+
+        void intrinsic_profiler::set_enabled(bool enabled) {
+            _enabled = enabled;
+        }
+
+        uint32_t intrinsic_profiler::register_intrinsic(const char *name) {
+            auto &state = profile_state::get();
+            std::lock_guard<std::mutex> g(state.mtx);
+            state.names.emplace_back(name);
+            return state.names.size() - 1;
+        }
+
+        void intrinsic_profiler::record(account_name receiver, action_name action, uint32_t intrinsic,
+                                        uint64_t bytes, uint64_t time_ns) {
+            auto &state = profile_state::get();
+            std::lock_guard<std::mutex> g(state.mtx);
+            auto &c = state.counters[profile_key{receiver.value, action.value, intrinsic}];
+            ++c.calls;
+            c.bytes += bytes;
+            c.time_ns += time_ns;
+        }
+
+        vector<intrinsic_profiler::entry> intrinsic_profiler::snapshot(bool reset) {
+            auto &state = profile_state::get();
+            vector<entry> entries;
+            {
+                std::lock_guard<std::mutex> g(state.mtx);
+                entries.reserve(state.counters.size());
+                for (const auto &c : state.counters) {
+                    const auto &name = c.first.intrinsic < state.names.size() ? state.names[c.first.intrinsic]
+                                                                               : state.names.front();
+                    entries.emplace_back(entry{account_name(c.first.receiver), action_name(c.first.action), name,
+                                               c.second.calls, c.second.bytes, c.second.time_ns});
+                }
+                if (reset)
+                    state.counters.clear();
+            }
+            std::sort(entries.begin(), entries.end(), [](const entry &lhs, const entry &rhs) {
+                return lhs.time_ns > rhs.time_ns;
+            });
+            return entries;
+        }
+
+    }
+} // namespace eosio::chain
@@ -0,0 +1,70 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#include <eosio/chain/native_contracts.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <iostream>
+
+namespace eosio {
+    namespace chain {
+
+        std::istream &operator>>(std::istream &in, native_contract_mode &mode) {
+            std::string s;
+            in >> s;
+            if (s == "off")
+                mode = native_contract_mode::off;
+            else if (s == "shadow")
+                mode = native_contract_mode::shadow;
+            else if (s == "native")
+                mode = native_contract_mode::native;
+            else
+                in.setstate(std::ios_base::failbit);
+            return in;
+        }
+
+        std::ostream &operator<<(std::ostream &out, native_contract_mode mode) {
+            switch (mode) {
+                case native_contract_mode::off:
+                    return out << "off";
+                case native_contract_mode::shadow:
+                    return out << "shadow";
+                case native_contract_mode::native:
+                    return out << "native";
+            }
+            return out;
+        }
+
+        string action_effects::difference(const action_effects &other) const {
+            auto differs = [](const auto &lhs, const auto &rhs) {
+                return fc::raw::pack(lhs) != fc::raw::pack(rhs);
+            };
+            // the messages of a native and a wasm failure are not expected to match, only that both failed
+            if (bool(except) != bool(other.except)) return "except";
+            if (differs(writes, other.writes)) return "writes";
+            if (differs(deferred, other.deferred)) return "deferred";
+            if (differs(notified, other.notified)) return "notified";
+            if (differs(inline_actions, other.inline_actions)) return "inline_actions";
+            if (differs(cfa_inline_actions, other.cfa_inline_actions)) return "cfa_inline_actions";
+            if (differs(ram_deltas, other.ram_deltas)) return "ram_deltas";
+            if (console != other.console) return "console";
+            if (response != other.response) return "response";
+            return string();
+        }
+
+        void native_contracts::add(const digest_type &code_hash, action_name act, handler h) {
+            _handlers[std::make_pair(code_hash, act)] = std::move(h);
+        }
+
+        const native_contracts::handler *
+        native_contracts::find(const digest_type &code_hash, action_name act) const {
+            if (_mode == native_contract_mode::off || _handlers.empty())
+                return nullptr;
+            auto itr = _handlers.find(std::make_pair(code_hash, act));
+            return itr != _handlers.end() ? &itr->second : nullptr;
+        }
+
+    }
+} // namespace eosio::chain
@@ -0,0 +1,60 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#include <eosio/chain/table_access_set.hpp>
+
+namespace eosio {
+    namespace chain {
+
+        namespace {
+            bool intersects(const flat_set<table_access_set::table_key> &lhs,
+                            const flat_set<table_access_set::table_key> &rhs) {
+                auto l = lhs.begin();
+                auto r = rhs.begin();
+                while (l != lhs.end() && r != rhs.end()) {
+                    if (*l < *r) ++l;
+                    else if (*r < *l) ++r;
+                    else return true;
+                }
+                return false;
+            }
+        }
+
+        bool table_access_set::conflicts_with(const table_access_set &other) const {
+            return intersects(writes, other.writes) || intersects(writes, other.reads) ||
+                   intersects(reads, other.writes);
+        }
+
+        uint32_t conflict_rounds(const vector<table_access_set> &trxs) {
+            // latest round that read or wrote each table
+            std::map<table_access_set::table_key, uint32_t> last_read;
+            std::map<table_access_set::table_key, uint32_t> last_write;
+            uint32_t rounds = 0;
+            for (const auto &trx : trxs) {
+                uint32_t round = 0;
+                for (const auto &k : trx.reads) {
+                    auto itr = last_write.find(k);
+                    if (itr != last_write.end()) round = std::max(round, itr->second);
+                }
+                for (const auto &k : trx.writes) {
+                    auto itr = last_write.find(k);
+                    if (itr != last_write.end()) round = std::max(round, itr->second);
+                    itr = last_read.find(k);
+                    if (itr != last_read.end()) round = std::max(round, itr->second);
+                }
+                ++round;
+                for (const auto &k : trx.reads) {
+                    auto &r = last_read[k];
+                    r = std::max(r, round);
+                }
+                for (const auto &k : trx.writes) {
+                    last_write[k] = round;
+                }
+                rounds = std::max(rounds, round);
+            }
+            return rounds;
+        }
+
+    }
+} // namespace eosio::chain
@@ -174,6 +174,8 @@ namespace eosio {
             trace->block_num = c.head_block_num() + 1;
             trace->block_time = c.pending_block_time();
             trace->producer_block_id = c.pending_producer_block_id();
+            if (c.tracks_table_access())
+                trace->table_access = std::make_shared<table_access_set>();
             executed.reserve(trx.total_actions());
         }
 
@@ -445,6 +447,12 @@ namespace eosio {
 
             rl.add_transaction_usage(bill_to_accounts, static_cast<uint64_t>(billed_cpu_time_us), net_usage,
                                      block_timestamp_type(control.pending_block_time()).slot); // Should never fail
+
+            if (trace->table_access) {
+                for (const auto &a : bill_to_accounts) {
+                    trace->table_access->writes.emplace(config::system_account_name, a, N(resusage));
+                }
+            }
         }
 
         void transaction_context::squash() {
@@ -457,6 +465,7 @@ namespace eosio {
             if (undo_session) undo_session->undo();
             if (hundo_session) hundo_session->undo();
             if (hiundo_session) hiundo_session->undo();
+            lookup_cache.clear();
         }
 
         void transaction_context::check_net_usage() const {
@@ -36,22 +36,60 @@ namespace eosio {
                 return mtrx->signing_keys_future;
 
             std::weak_ptr<transaction_metadata> mtrx_wp = mtrx;
-            mtrx->signing_keys_future = async_thread_pool(thread_pool, [time_limit, chain_id, mtrx_wp]() {
-                fc::time_point deadline = time_limit == fc::microseconds::maximum() ?
-                                          fc::time_point::maximum() : fc::time_point::now() + time_limit;
+            auto state = std::make_shared<recovery_state>();
+            mtrx->signing_keys_future = state->keys.get_future().share();
+            {
+                std::lock_guard<std::mutex> g(mtrx->recovered_mtx);
+                mtrx->pending_recovery = state;
+            }
+            boost::asio::post(thread_pool, [state, time_limit, chain_id, mtrx_wp]() {
                 auto mtrx = mtrx_wp.lock();
-                fc::microseconds cpu_usage;
-                flat_set<public_key_type> recovered_pub_keys;
-                if (mtrx) {
-                    const signed_transaction &trn = mtrx->packed_trx->get_signed_transaction();
-                    cpu_usage = trn.get_signature_keys(chain_id, deadline, recovered_pub_keys);
+                try {
+                    fc::time_point deadline = time_limit == fc::microseconds::maximum() ?
+                                              fc::time_point::maximum() : fc::time_point::now() + time_limit;
+                    fc::microseconds cpu_usage;
+                    flat_set<public_key_type> recovered_pub_keys;
+                    if (mtrx) {
+                        const signed_transaction &trn = mtrx->packed_trx->get_signed_transaction();
+                        cpu_usage = trn.get_signature_keys(chain_id, deadline, recovered_pub_keys);
+                    }
+                    state->keys.set_value(std::make_tuple(chain_id, cpu_usage, std::move(recovered_pub_keys)));
+                } catch (...) {
+                    state->keys.set_exception(std::current_exception());
+                }
+                if (!mtrx) return;
+
+                // the future is ready before any callback runs
+                std::vector<std::function<void(const transaction_metadata_ptr &)>> callbacks;
+                {
+                    std::lock_guard<std::mutex> g(mtrx->recovered_mtx);
+                    mtrx->keys_recovered = true;
+                    callbacks.swap(mtrx->recovered_callbacks);
+                    state->pinned.reset();
+                }
+                for (auto &cb : callbacks) {
+                    cb(mtrx);
                 }
-                return std::make_tuple(chain_id, cpu_usage, std::move(recovered_pub_keys));
             });
 
             return mtrx->signing_keys_future;
         }
 
+        void transaction_metadata::on_keys_recovered(const transaction_metadata_ptr &mtrx,
+                                                     std::function<void(const transaction_metadata_ptr &)> callback) {
+            {
+                std::lock_guard<std::mutex> g(mtrx->recovered_mtx);
+                if (!mtrx->keys_recovered) {
+                    if (auto state = mtrx->pending_recovery.lock()) {
+                        state->pinned = mtrx;
+                        mtrx->recovered_callbacks.emplace_back(std::move(callback));
+                    }
+                    return;
+                }
+            }
+            callback(mtrx);
+        }
+
 
     }
 } // eosio::chain
@@ -13,10 +13,11 @@ namespace eosio {
             using namespace IR;
             using namespace eosio::chain::wasm_constraints;
 
-            std::map<std::vector<uint16_t>, uint32_t> injector_utils::type_slots;
-            std::map<std::string, uint32_t>           injector_utils::registered_injected;
-            std::map<uint32_t, uint32_t>              injector_utils::injected_index_mapping;
-            uint32_t                                  injector_utils::next_injected_index;
+            thread_local std::map<std::vector<uint16_t>, uint32_t> injector_utils::type_slots;
+            thread_local std::map<std::string, uint32_t>           injector_utils::registered_injected;
+            thread_local std::map<uint32_t, uint32_t>              injector_utils::injected_index_mapping;
+            thread_local uint32_t                                  injector_utils::next_injected_index;
+            thread_local injector_utils::recorded_imports         *injector_utils::recording = nullptr;
 
 
             void noop_injection_visitor::inject(Module &m) { /* just pass */ }
@@ -42,19 +43,19 @@ namespace eosio {
 
             void max_memory_injection_visitor::initializer() {}
 
-            int32_t  call_depth_check_and_insert_checktime::global_idx = -1;
-            uint32_t instruction_counter::icnt = 0;
-            uint32_t instruction_counter::tcnt = 0;
-            uint32_t instruction_counter::bcnt = 0;
-            std::queue<uint32_t> instruction_counter::fcnts;
-
-            int32_t  checktime_injection::idx = 0;
-            int32_t  checktime_injection::chktm_idx = 0;
-            std::stack<size_t>                   checktime_block_type::block_stack;
-            std::stack<size_t>                   checktime_block_type::type_stack;
-            std::queue<std::vector<size_t>>      checktime_block_type::orderings;
-            std::queue<std::map<size_t, size_t>> checktime_block_type::bcnt_tables;
-            size_t  checktime_function_end::fcnt = 0;
+            thread_local int32_t  call_depth_check_and_insert_checktime::global_idx = -1;
+            thread_local uint32_t instruction_counter::icnt = 0;
+            thread_local uint32_t instruction_counter::tcnt = 0;
+            thread_local uint32_t instruction_counter::bcnt = 0;
+            thread_local std::queue<uint32_t> instruction_counter::fcnts;
+
+            thread_local int32_t  checktime_injection::idx = 0;
+            thread_local int32_t  checktime_injection::chktm_idx = 0;
+            thread_local std::stack<size_t>                   checktime_block_type::block_stack;
+            thread_local std::stack<size_t>                   checktime_block_type::type_stack;
+            thread_local std::queue<std::vector<size_t>>      checktime_block_type::orderings;
+            thread_local std::queue<std::map<size_t, size_t>> checktime_block_type::bcnt_tables;
+            thread_local size_t  checktime_function_end::fcnt = 0;
 
         }
     }
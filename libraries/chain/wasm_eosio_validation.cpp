@@ -103,8 +103,9 @@ namespace eosio {
                                        "Smart contract's apply function not exported; non-existent; or wrong type");
             }
 
-            uint16_t nested_validator::depth = 0;
-            bool     nested_validator::disabled = false;
+            thread_local uint16_t           nested_validator::depth = 0;
+            thread_local bool               nested_validator::disabled = false;
+            thread_local std::vector<bool> *nested_validator::recording = nullptr;
         }
     }
 } // namespace eosio chain validation
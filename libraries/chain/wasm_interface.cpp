@@ -30,11 +30,12 @@ namespace eosio {
         using namespace webassembly;
         using namespace webassembly::common;
 
-        wasm_interface::wasm_interface(vm_type vm, const chainbase::database &d) : my(new wasm_interface_impl(vm, d)) {}
+        wasm_interface::wasm_interface(vm_type vm, const chainbase::database &d, bool tiered_compilation)
+                : my(new wasm_interface_impl(vm, d, tiered_compilation)) {}
 
         wasm_interface::~wasm_interface() {}
 
-        void wasm_interface::validate(const controller &control, const bytes &code) {
+        void wasm_interface::validate(const controller &control, const bytes &code) const {
             Module module;
             try {
                 Serialization::MemoryInputStream stream((U8 *) code.data(), code.size());
@@ -46,7 +47,7 @@ namespace eosio {
             }
 
             wasm_validations::wasm_binary_validation validator(control, module);
-            validator.validate();
+            validator.validate(my->thread_pool, my->thread_pool_threads);
 
             const auto &pso = control.db().get<protocol_state_object>();
 
@@ -58,6 +59,31 @@ namespace eosio {
             //Hard: Kick off instantiation in a separate thread at this location
         }
 
+        void wasm_interface::set_thread_pool(boost::asio::io_context &thread_pool, size_t threads) {
+            my->thread_pool = &thread_pool;
+            my->thread_pool_threads = threads;
+        }
+
+        void wasm_interface::set_cache_budget(uint64_t budget, cache_policy policy) {
+            my->cache_budget = budget;
+            my->cache_policy = policy;
+            my->enforce_cache_budget(nullptr);
+        }
+
+        wasm_interface::cache_stats wasm_interface::get_cache_stats() const {
+            auto stats = my->stats;
+            stats.entries = my->wasm_instantiation_cache.size();
+            stats.code_bytes = my->cache_code_bytes;
+            stats.budget = my->cache_budget;
+            return stats;
+        }
+
+        bool wasm_interface::is_compiled(const digest_type &code_hash, const uint8_t &vm_type,
+                                         const uint8_t &vm_version) const {
+            auto it = my->wasm_instantiation_cache.find(boost::make_tuple(code_hash, vm_type, vm_version));
+            return it != my->wasm_instantiation_cache.end() && it->module;
+        }
+
         void wasm_interface::indicate_shutting_down() {
             my->is_shutting_down = true;
         }
@@ -71,13 +97,21 @@ namespace eosio {
             my->current_lib(lib);
         }
 
+        size_t wasm_interface::precompile_contracts() {
+            return my->precompile_contracts();
+        }
+
         void wasm_interface::apply(const digest_type &code_hash, const uint8_t &vm_type, const uint8_t &vm_version,
                                    apply_context &context) {
             my->get_instantiated_module(code_hash, vm_type, vm_version, context.trx_context)->apply(context);
         }
 
         void wasm_interface::exit() {
-            my->runtime_interface->immediately_exit_currently_running_module();
+            //with tiered compilation the running module may belong to either runtime
+            if (my->running_runtime)
+                my->running_runtime->immediately_exit_currently_running_module();
+            else
+                my->runtime_interface->immediately_exit_currently_running_module();
         }
 
         wasm_instantiated_module_interface::~wasm_instantiated_module_interface() {}
@@ -2125,5 +2159,17 @@ namespace eosio {
             return in;
         }
 
+        std::istream &operator>>(std::istream &in, wasm_interface::cache_policy &policy) {
+            std::string s;
+            in >> s;
+            if (s == "lru")
+                policy = eosio::chain::wasm_interface::cache_policy::lru;
+            else if (s == "lfu")
+                policy = eosio::chain::wasm_interface::cache_policy::lfu;
+            else
+                in.setstate(std::ios_base::failbit);
+            return in;
+        }
+
     }
 } /// eosio::chain
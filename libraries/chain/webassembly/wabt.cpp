@@ -49,8 +49,10 @@ namespace eosio {
                             Memory *memory = this_run_vars.memory = _env->GetMemory(0);
                             memory->page_limits = _initial_memory_configuration;
                             memory->data.resize(_initial_memory_configuration.initial * WABT_PAGE_SIZE);
-                            memset(memory->data.data(), 0, memory->data.size());
-                            memcpy(memory->data.data(), _initial_memory.data(), _initial_memory.size());
+                            //the image is copied over its own range, so only the rest needs zeroing
+                            const size_t image_size = std::min(_initial_memory.size(), memory->data.size());
+                            memcpy(memory->data.data(), _initial_memory.data(), image_size);
+                            memset(memory->data.data() + image_size, 0, memory->data.size() - image_size);
                         }
 
                         _params[0].set_i64(uint64_t(context.get_receiver()));
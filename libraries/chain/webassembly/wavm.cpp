@@ -14,6 +14,8 @@
 
 #include <vector>
 #include <iterator>
+#include <atomic>
+#include <mutex>
 
 using namespace IR;
 using namespace Runtime;
@@ -34,28 +36,80 @@ namespace eosio {
 
                     using live_module_ref = std::list<ObjectInstance *>::iterator;
 
+                    //modules may be instantiated on a background thread while others are destroyed on the main
+                    // thread. The garbage collector must never run while an instantiation is in progress, since the
+                    // half built instance is not yet a root; a collection that cannot get the lock is left to the
+                    // instantiating thread instead of blocking the caller.
                     struct wavm_live_modules {
                         live_module_ref add_live_module(ModuleInstance *module_instance) {
+                            std::lock_guard<std::mutex> g(live_modules_mtx);
                             return live_modules.insert(live_modules.begin(), asObject(module_instance));
                         }
 
                         void remove_live_module(live_module_ref it) {
-                            live_modules.erase(it);
-                            run_wavm_garbage_collection();
+                            {
+                                std::lock_guard<std::mutex> g(live_modules_mtx);
+                                live_modules.erase(it);
+                            }
+                            //flag before trying the lock: a holder that makes us back off checks the flag only
+                            // after it has unlocked, so it either sees the flag or we get the lock
+                            gc_pending = true;
+                            collect_pending_garbage();
+                        }
+
+                        //call without instantiation_mtx held
+                        void collect_pending_garbage() {
+                            while (gc_pending) {
+                                std::unique_lock<std::mutex> g(instantiation_mtx, std::try_to_lock);
+                                if (!g.owns_lock())
+                                    return;
+                                run_wavm_garbage_collection();
+                            }
                         }
 
+                        //call with instantiation_mtx held
                         void run_wavm_garbage_collection() {
+                            gc_pending = false;
                             //need to pass in a mutable list of root objects we want the garbage collector to retain
                             std::vector<ObjectInstance *> root;
-                            std::copy(live_modules.begin(), live_modules.end(), std::back_inserter(root));
+                            {
+                                std::lock_guard<std::mutex> g(live_modules_mtx);
+                                std::copy(live_modules.begin(), live_modules.end(), std::back_inserter(root));
+                            }
                             Runtime::freeUnreferencedObjects(std::move(root));
                         }
 
+                        std::mutex instantiation_mtx;
+                        std::atomic<bool> gc_pending{false};
+                        std::mutex live_modules_mtx;
                         std::list<ObjectInstance *> live_modules;
                     };
 
                     static wavm_live_modules the_wavm_live_modules;
 
+                    //a memory image holds a file descriptor open for as long as its module stays cached, so images
+                    // are only made where mapping beats copying the initial data, and capped so that the cache
+                    // cannot starve the p2p and http sockets of descriptors. Modules past the cap reset by copying
+                    constexpr size_t min_memory_image_bytes = 64 * 1024;
+                    constexpr uint32_t max_memory_images = 128;
+
+                    struct wavm_memory_images {
+                        bool reserve() {
+                            if (++live_images <= max_memory_images)
+                                return true;
+                            --live_images;
+                            return false;
+                        }
+
+                        void release() {
+                            --live_images;
+                        }
+
+                        std::atomic<uint32_t> live_images{0};
+                    };
+
+                    static wavm_memory_images the_wavm_memory_images;
+
                 }
 
                 class wavm_instantiated_module : public wasm_instantiated_module_interface {
@@ -68,11 +122,25 @@ namespace eosio {
                         //The memory instance is reused across all wavm_instantiated_modules, but for wasm instances
                         // that didn't declare "memory", getDefaultMemory() won't see it. It would also be possible
                         // to say something like if(module->memories.size()) here I believe
-                        if (getDefaultMemory(_instance))
+                        if (getDefaultMemory(_instance)) {
                             _initial_memory_config = module->memories.defs.at(0).type;
+                            //map the initial memory copy-on-write on each call instead of zeroing and copying it
+                            const Uptr image_size = Uptr(_initial_memory_config.size.min) << IR::numBytesPerPageLog2;
+                            if (image_size && _initial_memory.size() >= detail::min_memory_image_bytes &&
+                                _initial_memory.size() <= image_size && detail::the_wavm_memory_images.reserve()) {
+                                _memory_image = Platform::createMemoryImage(_initial_memory.data(),
+                                                                            _initial_memory.size(), image_size);
+                                if (!_memory_image)
+                                    detail::the_wavm_memory_images.release();
+                            }
+                        }
                     }
 
                     ~wavm_instantiated_module() {
+                        if (_memory_image) {
+                            Platform::destroyMemoryImage(_memory_image);
+                            detail::the_wavm_memory_images.release();
+                        }
                         detail::the_wavm_live_modules.remove_live_module(_module_ref);
                     }
 
@@ -96,7 +164,8 @@ namespace eosio {
                             //The memory instance is reused across all wavm_instantiated_modules, but for wasm instances
                             // that didn't declare "memory", getDefaultMemory() won't see it
                             MemoryInstance *default_mem = getDefaultMemory(_instance);
-                            if (default_mem) {
+                            if (default_mem &&
+                                !resetMemoryFromImage(default_mem, _initial_memory_config, _memory_image)) {
                                 //reset memory resizes the sandbox'ed memory to the module's init memory size and then
                                 // (effectively) memzeros it all
                                 resetMemory(default_mem, _initial_memory_config);
@@ -127,6 +196,7 @@ namespace eosio {
                     ModuleInstance *_instance;
                     detail::live_module_ref _module_ref;
                     MemoryType _initial_memory_config;
+                    Platform::MemoryImage *_memory_image = nullptr;
                 };
 
                 wavm_runtime::wavm_runtime() {
@@ -149,12 +219,20 @@ namespace eosio {
                         EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
                     }
 
-                    eosio::chain::webassembly::common::root_resolver resolver;
-                    LinkResult link_result = linkModule(*module, resolver);
-                    ModuleInstance *instance = instantiateModule(*module, std::move(link_result.resolvedImports));
-                    EOS_ASSERT(instance != nullptr, wasm_exception, "Fail to Instantiate WAVM Module");
+                    std::unique_ptr<wavm_instantiated_module> instantiated;
+                    {
+                        std::lock_guard<std::mutex> g(detail::the_wavm_live_modules.instantiation_mtx);
+                        eosio::chain::webassembly::common::root_resolver resolver;
+                        LinkResult link_result = linkModule(*module, resolver);
+                        ModuleInstance *instance = instantiateModule(*module, std::move(link_result.resolvedImports));
+                        EOS_ASSERT(instance != nullptr, wasm_exception, "Fail to Instantiate WAVM Module");
 
-                    return std::make_unique<wavm_instantiated_module>(instance, std::move(module), initial_memory);
+                        instantiated = std::make_unique<wavm_instantiated_module>(instance, std::move(module),
+                                                                                  initial_memory);
+                    }
+                    //collections deferred while we held the lock, including any flagged since the instance was built
+                    detail::the_wavm_live_modules.collect_pending_garbage();
+                    return instantiated;
                 }
 
                 void wavm_runtime::immediately_exit_currently_running_module() {
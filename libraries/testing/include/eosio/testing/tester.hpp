@@ -454,6 +454,10 @@ namespace eosio {
                         vcfg.wasm_runtime = chain::wasm_interface::vm_type::wavm;
                     else if (boost::unit_test::framework::master_test_suite().argv[i] == std::string("--wabt"))
                         vcfg.wasm_runtime = chain::wasm_interface::vm_type::wabt;
+                    else if (boost::unit_test::framework::master_test_suite().argv[i] == std::string("--wavm-tiered")) {
+                        vcfg.wasm_runtime = chain::wasm_interface::vm_type::wavm;
+                        vcfg.wasm_tiered_compilation = true;
+                    }
                 }
                 return vcfg;
             }
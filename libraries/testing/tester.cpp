@@ -144,6 +144,10 @@ namespace eosio {
                     cfg.wasm_runtime = chain::wasm_interface::vm_type::wavm;
                 else if (boost::unit_test::framework::master_test_suite().argv[i] == std::string("--wabt"))
                     cfg.wasm_runtime = chain::wasm_interface::vm_type::wabt;
+                else if (boost::unit_test::framework::master_test_suite().argv[i] == std::string("--wavm-tiered")) {
+                    cfg.wasm_runtime = chain::wasm_interface::vm_type::wavm;
+                    cfg.wasm_tiered_compilation = true;
+                }
             }
 
             open(nullptr);
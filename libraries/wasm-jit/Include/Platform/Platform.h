@@ -102,6 +102,20 @@ namespace Platform {
     // baseVirtualAddress must be a multiple of the preferred page size.
     PLATFORM_API void freeVirtualPages(U8 *baseVirtualAddress, Uptr numPages);
 
+    // An immutable page image that can be mapped copy-on-write, so that only the pages written to are copied.
+    struct MemoryImage;
+
+    // Creates an image of numBytes bytes (a multiple of the page size) that starts with the numDataBytes of data and
+    // is zero after. Returns nullptr if the platform doesn't support images.
+    // On Linux every image keeps a file descriptor open until it is destroyed.
+    PLATFORM_API MemoryImage *createMemoryImage(const U8 *data, Uptr numDataBytes, Uptr numBytes);
+
+    PLATFORM_API void destroyMemoryImage(MemoryImage *image);
+
+    // Replaces the pages at baseVirtualAddress with a private copy-on-write mapping of the image.
+    // baseVirtualAddress must be a multiple of the preferred page size. Returns false if the mapping failed.
+    PLATFORM_API bool mapMemoryImage(MemoryImage *image, U8 *baseVirtualAddress);
+
     //
     // Call stack and exceptions
     //
@@ -4,6 +4,10 @@
 #include "TaggedValue.h"
 #include "IR/Types.h"
 
+namespace Platform {
+    struct MemoryImage;
+}
+
 #ifndef RUNTIME_API
 #define RUNTIME_API DLL_IMPORT
 #endif
@@ -282,6 +286,12 @@ namespace Runtime {
 
     RUNTIME_API void resetMemory(MemoryInstance *memory, IR::MemoryType &newMemoryType);
 
+    // Like resetMemory, but maps the initial contents from an image of newMemoryType.size.min pages instead of
+    // zeroing and copying them, so only pages written by the next call are ever copied. Returns false if the image
+    // couldn't be mapped, in which case resetMemory must be used.
+    RUNTIME_API bool resetMemoryFromImage(MemoryInstance *memory, IR::MemoryType &newMemoryType,
+                                          Platform::MemoryImage *image);
+
     // Gets an object exported by a ModuleInstance by name.
     RUNTIME_API ObjectInstance *getInstanceExport(ModuleInstance *moduleInstance, const std::string &name);
 }
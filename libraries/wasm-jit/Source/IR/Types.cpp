@@ -1,6 +1,7 @@
 #include "Types.h"
 
 #include <map>
+#include <mutex>
 
 namespace IR {
     struct FunctionTypeMap {
@@ -25,10 +26,17 @@ namespace IR {
             static std::map<Key, FunctionType *> map;
             return map;
         }
+
+        // Modules may be decoded on more than one thread at a time.
+        static std::mutex &mutex() {
+            static std::mutex m;
+            return m;
+        }
     };
 
     template<typename Key, typename Value, typename CreateValueThunk>
     Value findExistingOrCreateNew(std::map<Key, Value> &map, Key &&key, CreateValueThunk createValueThunk) {
+        std::lock_guard<std::mutex> lock(FunctionTypeMap::mutex());
         auto mapIt = map.find(key);
         if (mapIt != map.end()) { return mapIt->second; }
         else {
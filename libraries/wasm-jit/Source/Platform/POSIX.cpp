@@ -102,6 +102,45 @@ namespace Platform {
         if (munmap(baseVirtualAddress, numPages << getPageSizeLog2())) { Errors::fatal("munmap failed"); }
     }
 
+    struct MemoryImage {
+        int fd;
+        Uptr numBytes;
+    };
+
+    MemoryImage *createMemoryImage(const U8 *data, Uptr numDataBytes, Uptr numBytes) {
+        errorUnless(numDataBytes <= numBytes);
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+        int fd = memfd_create("wasm-memory-image", MFD_CLOEXEC);
+        if (fd < 0) { return nullptr; }
+        bool ok = ftruncate(fd, numBytes) == 0;
+        for (Uptr written = 0; ok && written < numDataBytes;) {
+            ssize_t result = pwrite(fd, data + written, numDataBytes - written, written);
+            if (result < 0 && errno == EINTR) { continue; }
+            ok = result > 0;
+            if (ok) { written += result; }
+        }
+        if (!ok) {
+            close(fd);
+            return nullptr;
+        }
+        return new MemoryImage{fd, numBytes};
+#else
+        return nullptr;
+#endif
+    }
+
+    void destroyMemoryImage(MemoryImage *image) {
+        if (!image) { return; }
+        close(image->fd);
+        delete image;
+    }
+
+    bool mapMemoryImage(MemoryImage *image, U8 *baseVirtualAddress) {
+        errorUnless(isPageAligned(baseVirtualAddress));
+        return mmap(baseVirtualAddress, image->numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                    image->fd, 0) != MAP_FAILED;
+    }
+
     bool describeInstructionPointer(Uptr ip, std::string &outDescription) {
 #if defined __linux__ || defined __FreeBSD__
         // Look up static symbol information for the address.
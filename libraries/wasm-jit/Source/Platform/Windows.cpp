@@ -85,6 +85,20 @@ namespace Platform
         if(baseVirtualAddress && !result) { Errors::fatal("VirtualFree(MEM_RELEASE) failed"); }
     }
 
+    MemoryImage* createMemoryImage(const U8* data,Uptr numDataBytes,Uptr numBytes)
+    {
+        return nullptr;
+    }
+
+    void destroyMemoryImage(MemoryImage* image)
+    {
+    }
+
+    bool mapMemoryImage(MemoryImage* image,U8* baseVirtualAddress)
+    {
+        return false;
+    }
+
     // The interface to the DbgHelp DLL
     struct DbgHelp
     {
@@ -27,6 +27,8 @@
 
 namespace LLVMJIT {
     llvm::LLVMContext context;
+    // Guards context, which is shared by every module compiled in the process.
+    Platform::Mutex *contextMutex = Platform::createMutex();
     llvm::TargetMachine *targetMachine = nullptr;
     llvm::Type *llvmResultTypes[(Uptr) ResultType::num];
 
@@ -56,6 +58,7 @@ namespace LLVMJIT {
     std::map<Uptr, struct JITSymbol *> addressToSymbolMap;
 
     // A map from function types to function indices in the invoke thunk unit.
+    Platform::Mutex *invokeThunkMutex = Platform::createMutex();
     std::map<const FunctionType *, struct JITSymbol *> invokeThunkTypeToSymbolMap;
 
     // Information about a JIT symbol, used to map instruction pointers to descriptive names.
@@ -584,6 +587,8 @@ namespace LLVMJIT {
     }
 
     void instantiateModule(const IR::Module &module, ModuleInstance *moduleInstance) {
+        Platform::Lock contextLock(contextMutex);
+
         // Emit LLVM IR for the module.
         auto llvmModule = emitModule(module, moduleInstance);
 
@@ -652,10 +657,14 @@ namespace LLVMJIT {
 
     InvokeFunctionPointer getInvokeThunk(const FunctionType *functionType) {
         // Reuse cached invoke thunks for the same function type.
-        auto mapIt = invokeThunkTypeToSymbolMap.find(functionType);
-        if (mapIt !=
-            invokeThunkTypeToSymbolMap.end()) { return reinterpret_cast<InvokeFunctionPointer>(mapIt->second->baseAddress); }
+        {
+            Platform::Lock invokeThunkLock(invokeThunkMutex);
+            auto mapIt = invokeThunkTypeToSymbolMap.find(functionType);
+            if (mapIt !=
+                invokeThunkTypeToSymbolMap.end()) { return reinterpret_cast<InvokeFunctionPointer>(mapIt->second->baseAddress); }
+        }
 
+        Platform::Lock contextLock(contextMutex);
         auto llvmModule = new llvm::Module("", context);
         auto llvmFunctionType = llvm::FunctionType::get(
                 llvmVoidType,
@@ -703,7 +712,10 @@ namespace LLVMJIT {
         jitUnit->compile(llvmModule);
 
         WAVM_ASSERT_THROW(jitUnit->symbol);
-        invokeThunkTypeToSymbolMap[functionType] = jitUnit->symbol;
+        {
+            Platform::Lock invokeThunkLock(invokeThunkMutex);
+            invokeThunkTypeToSymbolMap[functionType] = jitUnit->symbol;
+        }
 
         {
             Platform::Lock addressToSymbolMapLock(addressToSymbolMapMutex);
@@ -5,8 +5,14 @@
 
 namespace Runtime {
     // Global lists of memories; used to query whether an address is reserved by one of them.
+    // Memories may be created and freed on a background compile thread while a trap is handled on the main thread.
     std::vector<MemoryInstance *> memories;
 
+    static Platform::Mutex *getMemoriesMutex() {
+        static Platform::Mutex *mutex = Platform::createMutex();
+        return mutex;
+    }
+
     static Uptr getPlatformPagesPerWebAssemblyPageLog2() {
         errorUnless(Platform::getPageSizeLog2() <= IR::numBytesPerPageLog2);
         return IR::numBytesPerPageLog2 - Platform::getPageSizeLog2();
@@ -54,6 +60,7 @@ namespace Runtime {
         }
 
         // Add the memory to the global array.
+        Platform::Lock lock(getMemoriesMutex());
         memories.push_back(memory);
         return memory;
     }
@@ -70,6 +77,7 @@ namespace Runtime {
         reservedNumPlatformPages = 0;
 
         // Remove the memory from the global array.
+        Platform::Lock lock(getMemoriesMutex());
         for (Uptr memoryIndex = 0; memoryIndex < memories.size(); ++memoryIndex) {
             if (memories[memoryIndex] == this) {
                 memories.erase(memories.begin() + memoryIndex);
@@ -82,6 +90,7 @@ namespace Runtime {
 
     bool isAddressOwnedByMemory(U8 *address) {
         // Iterate over all memories and check if the address is within the reserved address space for each.
+        Platform::Lock lock(getMemoriesMutex());
         for (auto memory : memories) {
             U8 *startAddress = memory->reservedBaseAddress;
             U8 *endAddress =
@@ -108,6 +117,23 @@ namespace Runtime {
             causeException(Exception::Cause::outOfMemory);
     }
 
+    bool resetMemoryFromImage(MemoryInstance *memory, MemoryType &newMemoryType, Platform::MemoryImage *image) {
+        const Uptr imagePages = Uptr(newMemoryType.size.min);
+        if (!image || imagePages == 0) { return false; }
+
+        // Pages grown past the image are decommitted; growMemory zeroes them if they are committed again.
+        if (memory->numPages > imagePages) {
+            Platform::decommitVirtualPages(memory->baseAddress + (imagePages << IR::numBytesPerPageLog2),
+                                           (memory->numPages - imagePages)
+                                                   << getPlatformPagesPerWebAssemblyPageLog2());
+            memory->numPages = imagePages;
+        }
+        if (!Platform::mapMemoryImage(image, memory->baseAddress)) { return false; }
+        memory->type = newMemoryType;
+        memory->numPages = imagePages;
+        return true;
+    }
+
     Iptr growMemory(MemoryInstance *memory, Uptr numNewPages) {
         const Uptr previousNumPages = memory->numPages;
         if (numNewPages > 0) {
@@ -1,4 +1,5 @@
 #include "Inline/BasicTypes.h"
+#include "Platform/Platform.h"
 #include "Runtime.h"
 #include "RuntimePrivate.h"
 #include "Intrinsics.h"
@@ -7,9 +8,10 @@
 #include <vector>
 
 namespace Runtime {
-    // Keep a global list of all objects.
+    // Keep a global list of all objects. Objects may be created and freed on a background compile thread.
     struct GCGlobals {
         std::set<GCObject *> allObjects;
+        Platform::Mutex *mutex;
 
         static GCGlobals &get() {
             static GCGlobals globals;
@@ -17,16 +19,18 @@ namespace Runtime {
         }
 
     private:
-        GCGlobals() {}
+        GCGlobals() : mutex(Platform::createMutex()) {}
     };
 
     GCObject::GCObject(ObjectKind inKind) : ObjectInstance(inKind) {
         // Add the object to the global array.
+        Platform::Lock lock(GCGlobals::get().mutex);
         GCGlobals::get().allObjects.insert(this);
     }
 
     GCObject::~GCObject() {
         // Remove the object from the global array.
+        Platform::Lock lock(GCGlobals::get().mutex);
         GCGlobals::get().allObjects.erase(this);
     }
 
@@ -104,15 +108,20 @@ namespace Runtime {
         };
 
         // Iterate over all objects, and delete objects that weren't referenced directly or indirectly by the root set.
+        // The objects are deleted after the lock is released, since their destructors take it too.
         GCGlobals &gcGlobals = GCGlobals::get();
-        auto objectIt = gcGlobals.allObjects.begin();
-        while (objectIt != gcGlobals.allObjects.end()) {
-            if (referencedObjects.count(*objectIt)) { ++objectIt; }
-            else {
-                ObjectInstance *object = *objectIt;
-                objectIt = gcGlobals.allObjects.erase(objectIt);
-                delete object;
+        std::vector<ObjectInstance *> unreferencedObjects;
+        {
+            Platform::Lock lock(gcGlobals.mutex);
+            auto objectIt = gcGlobals.allObjects.begin();
+            while (objectIt != gcGlobals.allObjects.end()) {
+                if (referencedObjects.count(*objectIt)) { ++objectIt; }
+                else {
+                    unreferencedObjects.push_back(*objectIt);
+                    objectIt = gcGlobals.allObjects.erase(objectIt);
+                }
             }
         }
+        for (auto object : unreferencedObjects) { delete object; }
     }
 }
\ No newline at end of file
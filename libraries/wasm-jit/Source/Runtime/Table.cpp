@@ -6,8 +6,14 @@
 
 namespace Runtime {
     // Global lists of tables; used to query whether an address is reserved by one of them.
+    // Tables may be created and freed on a background compile thread while a trap is handled on the main thread.
     std::vector<TableInstance *> tables;
 
+    static Platform::Mutex *getTablesMutex() {
+        static Platform::Mutex *mutex = Platform::createMutex();
+        return mutex;
+    }
+
     static Uptr getNumPlatformPages(Uptr numBytes) {
         return (numBytes + (Uptr(1) << Platform::getPageSizeLog2()) - 1) >> Platform::getPageSizeLog2();
     }
@@ -37,6 +43,7 @@ namespace Runtime {
         }
 
         // Add the table to the global array.
+        Platform::Lock lock(getTablesMutex());
         tables.push_back(table);
         return table;
     }
@@ -57,6 +64,7 @@ namespace Runtime {
         baseAddress = nullptr;
 
         // Remove the table from the global array.
+        Platform::Lock lock(getTablesMutex());
         for (Uptr tableIndex = 0; tableIndex < tables.size(); ++tableIndex) {
             if (tables[tableIndex] == this) {
                 tables.erase(tables.begin() + tableIndex);
@@ -67,6 +75,7 @@ namespace Runtime {
 
     bool isAddressOwnedByTable(U8 *address) {
         // Iterate over all tables and check if the address is within the reserved address space for each.
+        Platform::Lock lock(getTablesMutex());
         for (auto table : tables) {
             U8 *startAddress = (U8 *) table->reservedBaseAddress;
             U8 *endAddress = ((U8 *) table->reservedBaseAddress) +
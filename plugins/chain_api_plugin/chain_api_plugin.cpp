@@ -140,6 +140,8 @@ namespace eosio {
                                      CHAIN_RO_CALL(get_nfts_hash, 200),
                                      CHAIN_RO_CALL(get_nfts_contract, 200),
                                      CHAIN_RO_CALL(get_escrow_listings, 200),
+                                     CHAIN_RO_CALL(get_intrinsic_profile, 200),
+                                     CHAIN_RO_CALL(get_wasm_cache_stats, 200),
                                      CHAIN_RW_CALL_ASYNC(add_fio_permission,
                                                          chain_apis::read_write::add_fio_permission_results, 202),
                                      CHAIN_RW_CALL_ASYNC(remove_fio_permission,
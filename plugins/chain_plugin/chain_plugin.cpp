@@ -168,6 +168,7 @@ namespace eosio {
         fc::optional<chain_id_type> chain_id;
         //txn_msg_rate_limits              rate_limits;
         fc::optional<vm_type> wasm_runtime;
+        bool wasm_precompile_contracts = false;
         fc::microseconds abi_serializer_max_time_ms;
         fc::optional<bfs::path> snapshot_path;
 
@@ -214,12 +215,41 @@ namespace eosio {
         cfg.add_options()
                 ("blocks-dir", bpo::value<bfs::path>()->default_value("blocks"),
                  "the location of the blocks directory (absolute path or relative to application data dir)")
+                ("blocks-log-stride", bpo::value<uint32_t>()->default_value(0),
+                 "split the block log file when the head block number is a multiple of the stride\n"
+                 "When the stride is reached, the current blocks.log and blocks.index are renamed to blocks-<first>-<last>.log/index "
+                 "and moved to the retained directory, and a new blocks.log is started. 0 keeps a single block log file")
+                ("max-retained-block-files", bpo::value<uint16_t>()->default_value(std::numeric_limits<uint16_t>::max()),
+                 "the maximum number of split block log files to retain and serve to peers and API requests\n"
+                 "Older files are moved to the archive directory, or deleted if the archive directory is empty")
+                ("blocks-retained-dir", bpo::value<bfs::path>()->default_value(""),
+                 "the location of the split block log files (absolute path or relative to blocks dir). "
+                 "If empty, the files are kept in the blocks dir")
+                ("blocks-archive-dir", bpo::value<bfs::path>()->default_value(config::default_blocks_archive_dir_name),
+                 "the location of the archived block log files (absolute path or relative to blocks dir). "
+                 "If empty, block log files beyond max-retained-block-files are deleted")
                 ("protocol-features-dir", bpo::value<bfs::path>()->default_value("protocol_features"),
                  "the location of the protocol_features directory (absolute path or relative to application config dir)")
                 ("checkpoint", bpo::value<vector<string>>()->composing(),
                  "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
                 ("wasm-runtime", bpo::value<eosio::chain::wasm_interface::vm_type>()->value_name("wavm/wabt"),
                  "Override default WASM runtime")
+                ("wasm-tiered-compilation", bpo::bool_switch()->default_value(false),
+                 "With the wavm runtime, run newly deployed or uncached contracts on the wabt interpreter while wavm compiles them on a background thread")
+                ("wasm-precompile-contracts", bpo::bool_switch()->default_value(false),
+                 "Compile every deployed contract at startup, before blocks are accepted, instead of on first use")
+                ("wasm-cache-size-mb", bpo::value<uint64_t>()->default_value(0),
+                 "Maximum estimated memory (in MiB) of the instantiated contracts kept in the wasm cache, 0 for no limit")
+                ("wasm-cache-policy", bpo::value<eosio::chain::wasm_interface::cache_policy>()->default_value(
+                        eosio::chain::wasm_interface::cache_policy::lru, "lru")->value_name("lru/lfu"),
+                 "Which instantiated contracts are evicted first once the wasm cache is over wasm-cache-size-mb: "
+                 "lru the least recently used, lfu those executed the fewest times")
+                ("native-contract-execution", bpo::value<native_contract_mode>()->default_value(native_contract_mode::off, "off"),
+                 "How registered native implementations of contract actions are used (off/shadow/native). "
+                 "shadow runs them alongside the wasm and logs any difference in the state changes; "
+                 "native runs them in place of the wasm and must only be used once shadow reports no differences")
+                ("wasm-intrinsic-profiling", bpo::bool_switch()->default_value(false),
+                 "Count the calls, bytes and time of every intrinsic per contract action, reported by /v1/chain/get_intrinsic_profile")
                 ("abi-serializer-max-time-ms",
                  bpo::value<uint32_t>()->default_value(config::default_abi_serializer_max_time_ms),
                  "Override default maximum ABI serialization time allowed in ms")
@@ -695,11 +725,17 @@ if( options.count(name) ) { \
             if (options.count("wasm-runtime"))
                 my->wasm_runtime = options.at("wasm-runtime").as<vm_type>();
 
+            my->wasm_precompile_contracts = options.at("wasm-precompile-contracts").as<bool>();
+
             if (options.count("abi-serializer-max-time-ms"))
                 my->abi_serializer_max_time_ms = fc::microseconds(
                         options.at("abi-serializer-max-time-ms").as<uint32_t>() * 1000);
 
             my->chain_config->blocks_dir = my->blocks_dir;
+            my->chain_config->blocks_log_stride = options.at("blocks-log-stride").as<uint32_t>();
+            my->chain_config->max_retained_block_files = options.at("max-retained-block-files").as<uint16_t>();
+            my->chain_config->blocks_retained_dir = options.at("blocks-retained-dir").as<bfs::path>();
+            my->chain_config->blocks_archive_dir = options.at("blocks-archive-dir").as<bfs::path>();
             my->chain_config->state_dir = app().data_dir() / config::default_state_dir_name;
             my->chain_config->read_only = my->readonly;
 
@@ -765,6 +801,21 @@ if( options.count(name) ) { \
 
             if (my->wasm_runtime)
                 my->chain_config->wasm_runtime = *my->wasm_runtime;
+            my->chain_config->wasm_tiered_compilation = options.at("wasm-tiered-compilation").as<bool>();
+            EOS_ASSERT(!my->chain_config->wasm_tiered_compilation ||
+                       my->chain_config->wasm_runtime == vm_type::wavm, plugin_config_exception,
+                       "wasm-tiered-compilation requires wasm-runtime = wavm");
+            my->chain_config->wasm_cache_size = options.at("wasm-cache-size-mb").as<uint64_t>() * 1024 * 1024;
+            my->chain_config->wasm_cache_policy =
+                    options.at("wasm-cache-policy").as<eosio::chain::wasm_interface::cache_policy>();
+            my->chain_config->native_contract_execution = options.at("native-contract-execution").as<native_contract_mode>();
+            if (options.at("wasm-intrinsic-profiling").as<bool>()) {
+#ifdef EOSIO_INTRINSIC_PROFILER
+                intrinsic_profiler::set_enabled(true);
+#else
+                wlog("wasm-intrinsic-profiling ignored, built without EOSIO_INTRINSIC_PROFILER");
+#endif
+            }
 
             my->chain_config->force_all_checks = options.at("force-all-checks").as<bool>();
             my->chain_config->disable_replay_opts = options.at("disable-replay-opts").as<bool>();
@@ -830,7 +881,9 @@ if( options.count(name) ) { \
             } else if (options.at("hard-replay-blockchain").as<bool>()) {
                 ilog("Hard replay requested: deleting state database");
                 clear_directory_contents(my->chain_config->state_dir);
-                auto backup_dir = block_log::repair_log(my->blocks_dir, options.at("truncate-at-block").as<uint32_t>());
+                auto backup_dir = block_log::repair_log(my->blocks_dir, options.at("truncate-at-block").as<uint32_t>(),
+                                                        my->chain_config->blocks_retained_dir,
+                                                        my->chain_config->blocks_archive_dir);
                 if (fc::exists(backup_dir / config::reversible_blocks_dir_name) ||
                     options.at("fix-reversible-blocks").as<bool>()) {
                     // Do not try to recover reversible blocks if the directory does not exist, unless the option was explicitly provided.
@@ -1090,6 +1143,13 @@ if( options.count(name) ) { \
             ilog("Blockchain started; head block is #${num}, genesis timestamp is ${ts}",
                  ("num", my->chain->head_block_num())("ts", (std::string) my->chain_config->genesis.initial_timestamp));
 
+            if (my->wasm_precompile_contracts) {
+                const auto start = fc::time_point::now();
+                const auto count = my->chain->get_wasm_interface().precompile_contracts();
+                ilog("Precompiled ${n} contracts in ${t} ms",
+                     ("n", count)("t", (fc::time_point::now() - start).count() / 1000));
+            }
+
             my->chain_config.reset();
         } FC_CAPTURE_AND_RETHROW()
     }
@@ -1904,6 +1964,26 @@ if( options.count(name) ) { \
             return result;
         } // get_escrow_listings
 
+        read_only::get_intrinsic_profile_results
+        read_only::get_intrinsic_profile(const read_only::get_intrinsic_profile_params &p) const {
+            get_intrinsic_profile_results result;
+            result.enabled = intrinsic_profiler::enabled();
+            result.entries = intrinsic_profiler::snapshot(p.reset);
+            if (p.limit && result.entries.size() > *p.limit)
+                result.entries.resize(*p.limit);
+            return result;
+        }
+
+        read_only::get_wasm_cache_stats_results
+        read_only::get_wasm_cache_stats(const read_only::get_wasm_cache_stats_params &) const {
+            get_wasm_cache_stats_results result;
+            result.stats = db.get_wasm_interface().get_cache_stats();
+            const auto lookups = result.stats.hits + result.stats.misses;
+            if (lookups)
+                result.hit_rate = double(result.stats.hits) / lookups;
+            return result;
+        }
+
         /***
         * get pending fio requests.
         * @param p Input is FIO name(.fio_name) and chain name(.chain). .chain is allowed to be null/empty, in which case this will bea domain only lookup.
@@ -11,6 +11,7 @@
 #include <eosio/chain/fioaction_object.hpp>
 #include <eosio/chain/block.hpp>
 #include <eosio/chain/controller.hpp>
+#include <eosio/chain/intrinsic_profiler.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/transaction.hpp>
@@ -44,6 +45,8 @@ namespace eosio {
     using chain::action_name;
     using chain::abi_def;
     using chain::abi_serializer;
+    using chain::intrinsic_profiler;
+    using chain::wasm_interface;
 
     namespace chain_apis {
         struct empty {
@@ -503,6 +506,28 @@ namespace eosio {
             get_scheduled_transactions_result
             get_scheduled_transactions(const get_scheduled_transactions_params &params) const;
 
+            struct get_intrinsic_profile_params {
+                bool reset = false;         ///< clear the counters after reading them
+                optional<uint32_t> limit;   ///< only return the entries with the most time
+            };
+
+            struct get_intrinsic_profile_results {
+                bool enabled = false;
+                vector<intrinsic_profiler::entry> entries;
+            };
+
+            get_intrinsic_profile_results get_intrinsic_profile(const get_intrinsic_profile_params &params) const;
+
+            struct get_wasm_cache_stats_params {
+            };
+
+            struct get_wasm_cache_stats_results {
+                wasm_interface::cache_stats stats;
+                double hit_rate = 0;    ///< hits over hits and misses since startup
+            };
+
+            get_wasm_cache_stats_results get_wasm_cache_stats(const get_wasm_cache_stats_params &params) const;
+
             ////////////////
             // FIO ESCROW //
             //begin get fio escrow listings by status
@@ -1831,6 +1856,10 @@ FC_REFLECT(eosio::chain_apis::read_only::get_nfts_contract_result, (nfts)(more)(
 FC_REFLECT(eosio::chain_apis::nft_info, (fio_address)(chain_code)(contract_address)(token_id)(url)(hash)(metadata))
 FC_REFLECT(eosio::chain_apis::read_only::get_whitelist_params, (fio_public_key))
 FC_REFLECT(eosio::chain_apis::read_only::get_whitelist_result, (whitelisted_parties))
+FC_REFLECT(eosio::chain_apis::read_only::get_intrinsic_profile_params, (reset)(limit))
+FC_REFLECT(eosio::chain_apis::read_only::get_intrinsic_profile_results, (enabled)(entries))
+FC_REFLECT_EMPTY(eosio::chain_apis::read_only::get_wasm_cache_stats_params)
+FC_REFLECT(eosio::chain_apis::read_only::get_wasm_cache_stats_results, (stats)(hit_rate))
 FC_REFLECT(eosio::chain_apis::read_only::get_escrow_listings_params, (status)(offset)(limit)(actor))
 FC_REFLECT(eosio::chain_apis::read_only::get_escrow_listings_result, (listings)(more)(time_limit_exceeded_error))
 FC_REFLECT(eosio::chain_apis::whitelist_info, (fio_public_key_hash)(content))
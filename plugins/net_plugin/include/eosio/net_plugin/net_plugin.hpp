@@ -10,11 +10,25 @@
 namespace eosio {
    using namespace appbase;
 
+   /**
+    *  Measurements of a peer kept for the current session, used to prefer the better peers
+    *  as sync sources and for fetching blocks and transactions.
+    */
+   struct connection_stats {
+      int64_t           rtt_us = -1;              ///< smoothed round trip time of time_message exchanges, -1 until measured
+      double            sync_blocks_per_sec = 0;  ///< smoothed delivery rate of completed sync chunks, 0 until measured
+      uint32_t          blocks_received = 0;      ///< blocks accepted from this peer
+      uint32_t          blocks_rejected = 0;      ///< blocks from this peer that failed to apply
+      uint32_t          fetch_timeouts = 0;       ///< block or transaction requests that timed out
+      double            score = 0;                ///< higher is better
+   };
+
    struct connection_status {
       string            peer;
       bool              connecting = false;
       bool              syncing    = false;
       handshake_message last_handshake;
+      connection_stats  stats;
    };
 
    class net_plugin : public appbase::plugin<net_plugin>
@@ -45,4 +59,5 @@ namespace eosio {
 
 }
 
-FC_REFLECT( eosio::connection_status, (peer)(connecting)(syncing)(last_handshake) )
+FC_REFLECT( eosio::connection_stats, (rtt_us)(sync_blocks_per_sec)(blocks_received)(blocks_rejected)(fetch_timeouts)(score) )
+FC_REFLECT( eosio::connection_status, (peer)(connecting)(syncing)(last_handshake)(stats) )
@@ -132,6 +132,29 @@ namespace eosio {
       uint32_t end_block{0};
    };
 
+   enum class message_compression : uint8_t {
+      none = 0,
+      zlib = 1
+   };
+
+   /**
+    *  One or more net_messages compressed together, each framed as [uint32_t size][net_message]
+    *  exactly as on the wire. Only sent to peers whose handshake network_version supports it.
+    */
+   struct compressed_message {
+      fc::enum_type<uint8_t,message_compression> compression = message_compression::zlib;
+      uint32_t                                   uncompressed_size = 0;
+      bytes                                      data;
+   };
+
+   /**
+    *  Transactions relayed together in one message. Only sent to peers whose handshake
+    *  network_version supports it.
+    */
+   struct packed_transaction_batch {
+      vector<packed_transaction> transactions;
+   };
+
    using net_message = static_variant<handshake_message,
                                       chain_size_message,
                                       go_away_message,
@@ -140,7 +163,9 @@ namespace eosio {
                                       request_message,
                                       sync_request_message,
                                       signed_block,         // which = 7
-                                      packed_transaction>;  // which = 8
+                                      packed_transaction,   // which = 8
+                                      compressed_message,   // which = 9
+                                      packed_transaction_batch>;  // which = 10
 
 } // namespace eosio
 
@@ -159,6 +184,9 @@ FC_REFLECT( eosio::time_message, (org)(rec)(xmt)(dst) )
 FC_REFLECT( eosio::notice_message, (known_trx)(known_blocks) )
 FC_REFLECT( eosio::request_message, (req_trx)(req_blocks) )
 FC_REFLECT( eosio::sync_request_message, (start_block)(end_block) )
+FC_REFLECT_ENUM( eosio::message_compression, (none)(zlib) )
+FC_REFLECT( eosio::compressed_message, (compression)(uncompressed_size)(data) )
+FC_REFLECT( eosio::packed_transaction_batch, (transactions) )
 
 /**
  *
@@ -0,0 +1,61 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <utility>
+
+namespace eosio {
+
+   /// an inclusive range of block numbers requested from one peer during sync
+   using sync_range = std::pair<uint32_t, uint32_t>;
+
+   /**
+    * Next new range to request after last_requested: span blocks starting no earlier than next_expected,
+    * shorter only when it reaches known_lib. first > second when there is nothing left to request.
+    */
+   inline sync_range next_sync_range( uint32_t last_requested, uint32_t next_expected, uint32_t known_lib, uint32_t span ) {
+      const uint32_t start = std::max( last_requested + 1, next_expected );
+      if( start > known_lib ) return { start, start - 1 };
+      return { start, start + std::min( span, known_lib - start + 1 ) - 1 };
+   }
+
+   /**
+    * Range to request again for the chunk [start_block, end_block] when the blocks from first_missing on were not
+    * received. It is widened back into the chunk so it is never shorter than span, unless the chunk itself was the
+    * shorter final tail. first > second when nothing is missing.
+    */
+   inline sync_range retake_sync_range( uint32_t start_block, uint32_t end_block, uint32_t first_missing, uint32_t span ) {
+      if( first_missing > end_block ) return { first_missing, end_block };
+      const uint32_t widened = end_block - start_block + 1 > span ? end_block - span + 1 : start_block;
+      return { std::max( start_block, std::min( first_missing, widened ) ), end_block };
+   }
+
+   /**
+    * Split r into the part to request now and the rest. A range of fewer than twice span blocks is requested whole,
+    * so that neither part is ever shorter than span. rest.first > rest.second when nothing is left.
+    */
+   inline std::pair<sync_range, sync_range> split_sync_range( const sync_range& r, uint32_t span ) {
+      if( r.second - r.first + 1 < 2 * span ) return { r, { r.second + 1, r.second } };
+      return { { r.first, r.first + span - 1 }, { r.first + span, r.second } };
+   }
+
+   /// add r to ranges, merging it with the ranges it overlaps or adjoins
+   inline void add_sync_range( std::set<sync_range>& ranges, sync_range r ) {
+      if( r.first > r.second ) return;
+      auto itr = ranges.lower_bound( { r.first, 0 } );
+      if( itr != ranges.begin() && std::prev( itr )->second + 1 >= r.first ) {
+         --itr;
+      }
+      while( itr != ranges.end() && itr->first <= r.second + 1 ) {
+         r.first = std::min( r.first, itr->first );
+         r.second = std::max( r.second, itr->second );
+         itr = ranges.erase( itr );
+      }
+      ranges.insert( r );
+   }
+
+} // namespace eosio
@@ -6,6 +6,7 @@
 
 #include <eosio/net_plugin/net_plugin.hpp>
 #include <eosio/net_plugin/protocol.hpp>
+#include <eosio/net_plugin/sync_ranges.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/block.hpp>
@@ -27,6 +28,12 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
+#include <array>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace eosio::chain::plugin_interface::compat;
 
@@ -49,6 +56,7 @@ namespace eosio {
 
    class sync_manager;
    class dispatch_manager;
+   class send_buffer_pool;
 
    using connection_ptr = std::shared_ptr<connection>;
    using connection_wptr = std::weak_ptr<connection>;
@@ -63,32 +71,123 @@ namespace eosio {
       std::shared_ptr<vector<char>>   serialized_txn; /// the received raw bundle
    };
 
-   struct by_expiry;
    struct by_block_num;
 
-   typedef multi_index_container<
-      node_transaction_state,
-      indexed_by<
-         ordered_unique<
-            tag< by_id >,
-            member < node_transaction_state,
-                     transaction_id_type,
-                     &node_transaction_state::id >,
-            sha256_less >,
-         ordered_non_unique<
-            tag< by_expiry >,
-            member< node_transaction_state,
-                    fc::time_point_sec,
-                    &node_transaction_state::expires >
-            >,
-         ordered_non_unique<
-            tag<by_block_num>,
-            member< node_transaction_state,
-                    uint32_t,
-                    &node_transaction_state::block_num > >
-         >
-      >
-   node_transaction_index;
+   /// the ids are sha256 digests, any 64 bits of them are uniformly distributed
+   struct transaction_id_hash {
+      size_t operator()( const transaction_id_type& id ) const { return id._hash[0]; }
+   };
+
+   /**
+    *  Transactions known to this node. Lookups are hashed by id, expiration and removal of
+    *  transactions included in irreversible blocks only visit the buckets that are due.
+    */
+   class node_transaction_cache {
+   public:
+      bool contains( const transaction_id_type& id ) const { return txns.find( id ) != txns.end(); }
+
+      const node_transaction_state* find( const transaction_id_type& id ) const {
+         auto itr = txns.find( id );
+         return itr != txns.end() ? &itr->second : nullptr;
+      }
+
+      /// @return false if id is already known
+      bool insert( node_transaction_state&& nts ) {
+         const auto expires = nts.expires.sec_since_epoch();
+         auto id = nts.id;
+         if( !txns.emplace( id, std::move( nts ) ).second )
+            return false;
+         expiry_buckets[expires].emplace_back( std::move( id ) );
+         return true;
+      }
+
+      void set_block_num( const transaction_id_type& id, uint32_t block_num ) {
+         auto itr = txns.find( id );
+         if( itr == txns.end() || itr->second.block_num == block_num )
+            return;
+         itr->second.block_num = block_num;
+         block_buckets[block_num].emplace_back( id );
+      }
+
+      /// remove transactions expired at now and transactions included in blocks up to lib
+      void expire( time_point_sec now, uint32_t lib ) {
+         auto end = expiry_buckets.upper_bound( now.sec_since_epoch() );
+         for( auto itr = expiry_buckets.begin(); itr != end; ++itr ) {
+            for( const auto& id : itr->second ) {
+               txns.erase( id );
+            }
+         }
+         expiry_buckets.erase( expiry_buckets.begin(), end );
+
+         auto bend = block_buckets.upper_bound( lib );
+         for( auto itr = block_buckets.begin(); itr != bend; ++itr ) {
+            for( const auto& id : itr->second ) {
+               auto t = txns.find( id );
+               // entry may have been moved to a later block by a fork switch
+               if( t != txns.end() && t->second.block_num == itr->first ) {
+                  txns.erase( t );
+               }
+            }
+         }
+         block_buckets.erase( block_buckets.begin(), bend );
+      }
+
+      size_t size() const { return txns.size(); }
+
+      template<typename F>
+      void for_each( F&& f ) const {
+         for( const auto& t : txns ) {
+            f( t.second );
+         }
+      }
+
+   private:
+      std::unordered_map<transaction_id_type, node_transaction_state, transaction_id_hash> txns;
+      std::map<uint32_t, std::vector<transaction_id_type>> expiry_buckets; ///< keyed by expiration second
+      std::map<uint32_t, std::vector<transaction_id_type>> block_buckets;  ///< keyed by including block number
+   };
+
+   /**
+    *  Compact record of the transactions a peer is known to have, either because it sent them
+    *  or because they were sent to it. Only a 64 bit fingerprint of each id is kept; a false
+    *  match merely skips sending a transaction the peer will get from another node.
+    */
+   class peer_transaction_filter {
+   public:
+      bool contains( const transaction_id_type& id ) const { return ids.find( fingerprint( id ) ) != ids.end(); }
+
+      /// @return false if id was already known to the peer
+      bool insert( const transaction_id_type& id, time_point_sec expires ) {
+         const auto fp = fingerprint( id );
+         if( !ids.insert( fp ).second )
+            return false;
+         expiry_buckets[expires.sec_since_epoch()].push_back( fp );
+         return true;
+      }
+
+      void expire( time_point_sec now ) {
+         auto end = expiry_buckets.upper_bound( now.sec_since_epoch() );
+         for( auto itr = expiry_buckets.begin(); itr != end; ++itr ) {
+            for( auto fp : itr->second ) {
+               ids.erase( fp );
+            }
+         }
+         expiry_buckets.erase( expiry_buckets.begin(), end );
+      }
+
+      void clear() {
+         ids.clear();
+         expiry_buckets.clear();
+      }
+
+      size_t size() const { return ids.size(); }
+
+   private:
+      static uint64_t fingerprint( const transaction_id_type& id ) { return id._hash[0]; }
+
+      std::unordered_set<uint64_t>                 ids;
+      std::map<uint32_t, std::vector<uint64_t>>    expiry_buckets; ///< keyed by expiration second
+   };
 
    class net_plugin_impl {
    public:
@@ -123,6 +222,11 @@ namespace eosio {
       unique_ptr<boost::asio::steady_timer> connector_check;
       unique_ptr<boost::asio::steady_timer> transaction_check;
       unique_ptr<boost::asio::steady_timer> keepalive_timer;
+      unique_ptr<boost::asio::steady_timer> trx_batch_timer;
+      bool                                  trx_batch_timer_active = false;
+      fc::microseconds                      trx_batch_window;
+      uint32_t                              trx_batch_max_count = 0;
+      uint32_t                              trx_batch_max_bytes = 0;
       boost::asio::steady_timer::duration   connector_period{0};
       boost::asio::steady_timer::duration   txn_exp_period{0};
       boost::asio::steady_timer::duration   resp_expected_period{0};
@@ -140,7 +244,11 @@ namespace eosio {
       producer_plugin*              producer_plug = nullptr;
       int                           started_sessions = 0;
 
-      node_transaction_index        local_txns;
+      node_transaction_cache        local_txns;
+      /// local_txns is only modified on the main thread, modifications and lookups from the net threads take this lock
+      mutable std::mutex            local_txns_mtx;
+      /// cached from the global properties on the main thread, used when starting key recovery on the net threads
+      std::atomic<uint32_t>         max_trx_cpu_usage{0};
 
       bool                          use_socket_read_watermark = false;
 
@@ -148,6 +256,16 @@ namespace eosio {
 
       uint16_t                                  thread_pool_size = 1;
       optional<eosio::chain::named_thread_pool> thread_pool;
+      /// signature recovery of received transactions, kept off the net threads and the chain thread pool
+      uint16_t                                  key_recovery_pool_size = config::default_controller_thread_pool_size;
+      optional<eosio::chain::named_thread_pool> key_recovery_pool;
+
+      message_compression                       compression = message_compression::zlib;
+      uint32_t                                  compression_min_size = 0;
+      /// serializes compression of broadcast blocks so they reach the main thread in order
+      optional<boost::asio::io_context::strand> compress_strand;
+
+      std::shared_ptr<send_buffer_pool>         buffer_pool;
 
       void connect( const connection_ptr& c );
       void connect( const connection_ptr& c, const std::shared_ptr<tcp::resolver>& resolver, tcp::resolver::results_type endpoints );
@@ -155,15 +273,44 @@ namespace eosio {
       void start_listen_loop();
       void start_read_message(const connection_ptr& c);
 
+      /** \brief A message unpacked on a net thread, waiting to be handled on the main thread
+       */
+      struct received_message {
+         optional<net_message>    msg;      ///< any message other than a block or a transaction
+         signed_block_ptr         block;
+         block_id_type            block_id;
+         transaction_metadata_ptr trx;
+         /// a transaction dropped on the net thread as already known, the sender is still recorded as having it
+         optional<std::pair<transaction_id_type, time_point_sec>> known_trx;
+      };
+
       /** \brief Process the next message from the pending message buffer
        *
-       * Process the next message from the pending_message_buffer.
-       * message_length is the already determined length of the data
-       * part of the message that will handle the message.
+       * Unpack the next message from the pending_message_buffer on the
+       * connection strand of the net thread pool. message_length is the
+       * already determined length of the data part of the message.
+       * Blocks have their id computed, transactions are filtered against
+       * local_txns and have key recovery started before the message is
+       * added to msgs for handling on the main thread.
        * Returns true is successful. Returns false if an error was
-       * encountered unpacking or processing the message.
+       * encountered unpacking the message.
        */
-      bool process_next_message(const connection_ptr& conn, uint32_t message_length);
+      bool process_next_message(const connection_ptr& conn, uint32_t message_length, vector<received_message>& msgs);
+
+      /** \brief Unpack the message in ds, which starts with the variant index which.
+       *
+       * A compressed_message is decompressed and each message it contains is unpacked in turn,
+       * compressed messages can not be nested.
+       */
+      template<typename Stream>
+      void unpack_message(const connection_ptr& conn, uint32_t which, Stream& ds, vector<received_message>& msgs, bool nested);
+      void unpacked_transaction(packed_transaction_ptr trx, vector<received_message>& msgs);
+
+      /** \brief Handle messages unpacked by process_next_message on the main thread
+       */
+      void handle_received_messages(const connection_ptr& conn, vector<received_message>& msgs);
+      bool is_known_block(const connection_ptr& conn, const block_id_type& blk_id);
+      bool have_txn(const transaction_id_type& id) const;
 
       void close(const connection_ptr& c);
       size_t count_open_sockets() const;
@@ -199,11 +346,19 @@ namespace eosio {
       void handle_message(const connection_ptr& c, const sync_request_message& msg);
       void handle_message(const connection_ptr& c, const signed_block& msg) = delete; // signed_block_ptr overload used instead
       void handle_message(const connection_ptr& c, const signed_block_ptr& msg);
+      void handle_message(const connection_ptr& c, const signed_block_ptr& msg, const block_id_type& blk_id);
+      void accept_block(const connection_ptr& c, const signed_block_ptr& msg, const block_id_type& blk_id);
+      void apply_deferred_blocks();
       void handle_message(const connection_ptr& c, const packed_transaction& msg) = delete; // packed_transaction_ptr overload used instead
       void handle_message(const connection_ptr& c, const packed_transaction_ptr& msg);
+      void handle_message(const connection_ptr& c, const transaction_metadata_ptr& ptrx);
+      void handle_message(const connection_ptr& c, const compressed_message& msg);
+      void handle_message(const connection_ptr& c, const packed_transaction_batch& msg);
 
       void start_conn_timer(boost::asio::steady_timer::duration du, std::weak_ptr<connection> from_connection);
       void start_txn_timer();
+      void start_trx_batch_timer();
+      void flush_trx_batches();
       void start_monitors();
 
       void expire_txns();
@@ -296,10 +451,19 @@ namespace eosio {
    constexpr auto     def_txn_expire_wait = std::chrono::seconds(3);
    constexpr auto     def_resp_expected_wait = std::chrono::seconds(5);
    constexpr auto     def_sync_fetch_span = 100;
+   constexpr auto     def_sync_fetch_peers = 4;
+   constexpr auto     def_compression_min_size = 1024;
+   constexpr auto     def_max_compressed_sync_blocks = 32; // blocks combined into one compressed sync message
+   constexpr auto     def_max_uncompressed_size = def_send_buffer_size*2;
+   constexpr auto     def_trx_batch_window_us = 2000;
+   constexpr auto     def_trx_batch_max_count = 100;
+   constexpr auto     def_trx_batch_max_bytes = 512*1024;
 
    constexpr auto     message_header_size = 4;
    constexpr uint32_t signed_block_which = 7;        // see protocol net_message
    constexpr uint32_t packed_transaction_which = 8;  // see protocol net_message
+   constexpr uint32_t compressed_message_which = 9;  // see protocol net_message
+   constexpr uint32_t packed_transaction_batch_which = 10; // see protocol net_message
 
    /**
     *  For a while, network version was a 16 bit value equal to the second set of 16 bits
@@ -321,28 +485,10 @@ namespace eosio {
     */
    constexpr uint16_t proto_base = 0;
    constexpr uint16_t proto_explicit_sync = 1;
+   constexpr uint16_t proto_compression = 2;         // peer accepts compressed_message
+   constexpr uint16_t proto_trx_batch = 3;           // peer accepts packed_transaction_batch
 
-   constexpr uint16_t net_version = proto_explicit_sync;
-
-   struct transaction_state {
-      transaction_id_type id;
-      uint32_t            block_num = 0; ///< the block number the transaction was included in
-      time_point_sec      expires;
-   };
-
-   typedef multi_index_container<
-      transaction_state,
-      indexed_by<
-         ordered_unique< tag<by_id>, member<transaction_state, transaction_id_type, &transaction_state::id >, sha256_less >,
-         ordered_non_unique< tag< by_expiry >, member< transaction_state,fc::time_point_sec,&transaction_state::expires >>,
-         ordered_non_unique<
-            tag<by_block_num>,
-            member< transaction_state,
-                    uint32_t,
-                    &transaction_state::block_num > >
-         >
-
-      > transaction_state_index;
+   constexpr uint16_t net_version = proto_trx_batch;
 
    /**
     *
@@ -361,17 +507,6 @@ namespace eosio {
       > peer_block_state_index;
 
 
-   struct update_block_num {
-      uint32_t new_bnum{0};
-      update_block_num(uint32_t bnum) : new_bnum(bnum) {}
-      void operator() (node_transaction_state& nts) {
-         nts.block_num = new_bnum;
-      }
-      void operator() (transaction_state& ts) {
-         ts.block_num = new_bnum;
-      }
-   };
-
    /**
     * Index by start_block_num
     */
@@ -390,6 +525,79 @@ namespace eosio {
       static void populate(handshake_message &hello);
    };
 
+   /**
+    *  Recycles the vectors backing outgoing messages. Buffers are handed out as shared_ptr whose
+    *  deleter returns the vector to the pool, so a buffer shared by many connections is reused
+    *  once the last write referencing it completes. Buffers are kept in power of two size classes,
+    *  so a small message never holds on to a large buffer, and at most max_pooled_bytes are kept.
+    *  Used from the main and net threads.
+    */
+   class send_buffer_pool : public std::enable_shared_from_this<send_buffer_pool> {
+   public:
+      std::shared_ptr<std::vector<char>> get( size_t size ) {
+         std::unique_ptr<std::vector<char>> v;
+         const size_t cls = class_for_size( size );
+         if( cls < num_classes ) {
+            std::lock_guard<std::mutex> g( mtx );
+            // most recently released first, its memory is the most likely to be cached
+            auto& free_list = free_lists[cls];
+            if( !free_list.empty() ) {
+               v = std::move( free_list.back() );
+               free_list.pop_back();
+               pooled_bytes -= v->capacity();
+            }
+         }
+         if( !v ) {
+            v.reset( new std::vector<char>() );
+            if( cls < num_classes )
+               v->reserve( min_class_size << cls );
+         }
+         v->resize( size );
+         std::weak_ptr<send_buffer_pool> weak_pool = shared_from_this();
+         return std::shared_ptr<std::vector<char>>( v.release(), [weak_pool]( std::vector<char>* b ) {
+            std::unique_ptr<std::vector<char>> buf( b );
+            if( auto pool = weak_pool.lock() ) {
+               pool->release( std::move( buf ) );
+            }
+         } );
+      }
+
+   private:
+      /// smallest class whose buffers hold size bytes, num_classes if none does
+      static size_t class_for_size( size_t size ) {
+         size_t cls = 0;
+         while( cls < num_classes && (min_class_size << cls) < size )
+            ++cls;
+         return cls;
+      }
+
+      void release( std::unique_ptr<std::vector<char>> b ) {
+         const size_t capacity = b->capacity();
+         if( capacity < min_class_size || capacity > (min_class_size << (num_classes - 1)) )
+            return;
+         // the largest class the buffer can serve
+         size_t cls = num_classes - 1;
+         while( (min_class_size << cls) > capacity )
+            --cls;
+         std::lock_guard<std::mutex> g( mtx );
+         auto& free_list = free_lists[cls];
+         if( free_list.size() < max_pooled_per_class && pooled_bytes + capacity <= max_pooled_bytes ) {
+            pooled_bytes += capacity;
+            free_list.emplace_back( std::move( b ) );
+         }
+      }
+
+      static constexpr size_t min_class_size = 256;
+      static constexpr size_t num_classes = 15; ///< 256 bytes to def_send_buffer_size
+      static_assert( (min_class_size << (num_classes - 1)) == def_send_buffer_size, "largest class is the send buffer size" );
+      static constexpr size_t max_pooled_per_class = 64;
+      static constexpr size_t max_pooled_bytes = 16 * 1024 * 1024;
+
+      std::mutex                                                            mtx;
+      std::array<std::vector<std::unique_ptr<std::vector<char>>>, num_classes> free_lists;
+      size_t                                                                pooled_bytes = 0;
+   };
+
    class queued_buffer : boost::noncopyable {
    public:
       void clear_write_queue() {
@@ -447,6 +655,8 @@ namespace eosio {
       struct queued_write;
       void fill_out_buffer( std::vector<boost::asio::const_buffer>& bufs,
                             deque<queued_write>& w_queue ) {
+         // everything queued goes out in one gathered async_write
+         bufs.reserve( bufs.size() + w_queue.size() );
          while ( w_queue.size() > 0 ) {
             auto& m = w_queue.front();
             bufs.push_back( boost::asio::buffer( *m.buff ));
@@ -479,12 +689,13 @@ namespace eosio {
       void initialize();
 
       peer_block_state_index  blk_state;
-      transaction_state_index trx_state;
+      peer_transaction_filter trx_filter;
       optional<peer_sync_state>    peer_requested;  // this peer is requesting info from us
       boost::asio::io_context&                  server_ioc;
       boost::asio::io_context::strand           strand;
       socket_ptr                                socket;
 
+      // only touched on the strand, where the reads are started and their data unpacked
       fc::message_buffer<1024*1024>    pending_message_buffer;
       fc::optional<std::size_t>        outstanding_read_bytes;
 
@@ -499,8 +710,14 @@ namespace eosio {
       bool                    connecting = false;
       bool                    syncing = false;
       uint16_t                protocol_version  = 0;
+      bool                    sync_compress_in_progress = false;
+      connection_stats        stats;
       uint16_t                consecutive_rejected_blocks = 0;
       string                  peer_addr;
+      // copies of the handshake p2p_address and the socket endpoint for peer_name(), which the strand calls too
+      std::mutex              name_mtx;
+      string                  handshake_p2p_address;
+      string                  remote_endpoint;
       unique_ptr<boost::asio::steady_timer> response_expected;
       go_away_reason         no_retry = no_reason;
       block_id_type          fork_head;
@@ -513,9 +730,39 @@ namespace eosio {
          stat.connecting = connecting;
          stat.syncing = syncing;
          stat.last_handshake = last_handshake_recv;
+         stat.stats = stats;
+         stat.stats.score = peer_score();
          return stat;
       }
 
+      /** \brief Relative quality of this peer as a source of blocks and transactions
+       *
+       * Sync throughput divided by a latency penalty of one per 100ms of round trip time and by
+       * one plus the number of rejected blocks and fetch timeouts. Unmeasured values count as
+       * 1 block/sec and 100ms.
+       */
+      double peer_score() const {
+         const double throughput = stats.sync_blocks_per_sec > 0 ? stats.sync_blocks_per_sec : 1;
+         const double rtt_ms = stats.rtt_us >= 0 ? stats.rtt_us / 1000.0 : 100;
+         return throughput / (1 + rtt_ms / 100) / (1 + stats.blocks_rejected + stats.fetch_timeouts);
+      }
+
+      /** \name Transaction batching
+       *  Transactions waiting to be relayed to this peer in one packed_transaction_batch,
+       *  kept as the concatenation of their packed_transaction encodings.
+       *  @{
+       */
+      std::vector<char>       trx_batch;
+      uint32_t                trx_batch_count = 0;
+
+      bool batch_transactions() const {
+         return protocol_version >= proto_trx_batch && my_impl->trx_batch_max_count > 1;
+      }
+      /// queue the packed_transaction frame trx_buffer, sends the batch once a limit is reached
+      void enqueue_batched_transaction( const std::shared_ptr<std::vector<char>>& trx_buffer );
+      void flush_trx_batch();
+      /** @} */
+
       /** \name Peer Timestamps
        *  Time message handling
        *  @{
@@ -579,6 +826,10 @@ namespace eosio {
       void flush_queues();
       void enqueue_sync_block();
       void request_sync_blocks(uint32_t start, uint32_t end);
+      /// true if blocks sent to this peer should be wrapped in a compressed_message
+      bool compress_blocks() const {
+         return protocol_version >= proto_compression && my_impl->compression != message_compression::none;
+      }
 
       void cancel_wait();
       void sync_wait();
@@ -661,19 +912,46 @@ namespace eosio {
          in_sync
       };
 
+      /// a range of blocks requested from one peer
+      struct sync_chunk {
+         uint32_t       start_block{0};
+         uint32_t       end_block{0};
+         uint32_t       last_received{0};
+         connection_ptr source;
+         time_point     requested;
+      };
+
+      /// a block received ahead of sync_next_expected_num, held until the blocks before it are applied
+      struct deferred_block {
+         signed_block_ptr block;
+         block_id_type    id;
+         connection_ptr   source;
+      };
+
       uint32_t       sync_known_lib_num{0};
       uint32_t       sync_last_requested_num{0};
       uint32_t       sync_next_expected_num{0};
       uint32_t       sync_req_span{0};
-      connection_ptr source;
+      uint32_t       sync_max_chunks{1};
       stages         state{in_sync};
 
+      std::map<uint32_t, sync_chunk>     chunks;           ///< outstanding chunks keyed by end_block
+      std::set<sync_range>               unassigned;       ///< ranges taken back from slow or closed peers, merged
+      std::map<uint32_t, deferred_block> deferred_blocks;  ///< reorder buffer keyed by block number
+
       chain_plugin* chain_plug = nullptr;
 
       constexpr static auto stage_str(stages s);
 
+      connection_ptr select_sync_peer(uint32_t end_block, const connection_ptr& preferred) const;
+      bool request_chunk(const connection_ptr& c, uint32_t start, uint32_t end);
+      std::map<uint32_t, sync_chunk>::iterator take_back_chunk(std::map<uint32_t, sync_chunk>::iterator itr, uint32_t first_missing);
+      void take_back_chunks(const connection_ptr& c);
+      void check_slow_chunks();
+      void reset_chunks();
+
    public:
-      explicit sync_manager(uint32_t span);
+      sync_manager(uint32_t span, uint32_t max_chunks);
       void set_state(stages s);
       bool sync_required();
       void send_handshakes();
@@ -686,6 +964,9 @@ namespace eosio {
       bool verify_catchup(const connection_ptr& c, uint32_t num, const block_id_type& id);
       void rejected_block(const connection_ptr& c, uint32_t blk_num);
       void recv_block(const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num);
+      void chunk_progress(const connection_ptr& c, uint32_t blk_num);
+      bool defer_block(const connection_ptr& c, const signed_block_ptr& blk, const block_id_type& blk_id, uint32_t blk_num);
+      optional<deferred_block> pop_ready_block();
       void recv_handshake(const connection_ptr& c, const handshake_message& msg);
       void recv_notice(const connection_ptr& c, const notice_message& msg);
    };
@@ -700,6 +981,12 @@ namespace eosio {
       void bcast_block(const block_state_ptr& bs);
       void rejected_block(const block_id_type& id);
 
+      /// encoded signed_block shared by every connection it is sent to
+      std::shared_ptr<std::vector<char>> block_send_buffer(const signed_block_ptr& sb, const block_id_type& id);
+      std::deque<std::pair<block_id_type, std::shared_ptr<std::vector<char>>>> encoded_blocks; ///< most recent last
+      /// blocks posted to compress_strand whose sends have not yet reached the main thread
+      uint32_t compressions_in_flight = 0;
+
       void recv_block(const connection_ptr& conn, const block_id_type& msg, uint32_t bnum);
       void expire_blocks( uint32_t bnum );
       void recv_transaction(const connection_ptr& conn, const transaction_id_type& id);
@@ -712,10 +999,10 @@ namespace eosio {
 
    connection::connection( string endpoint )
       : blk_state(),
-        trx_state(),
+        trx_filter(),
         peer_requested(),
         server_ioc( my_impl->thread_pool->get_executor() ),
-        strand( app().get_io_service() ),
+        strand( my_impl->thread_pool->get_executor() ),
         socket( std::make_shared<tcp::socket>( my_impl->thread_pool->get_executor() ) ),
         node_id(),
         last_handshake_recv(),
@@ -737,10 +1024,10 @@ namespace eosio {
 
    connection::connection( socket_ptr s )
       : blk_state(),
-        trx_state(),
+        trx_filter(),
         peer_requested(),
         server_ioc( my_impl->thread_pool->get_executor() ),
-        strand( app().get_io_service() ),
+        strand( my_impl->thread_pool->get_executor() ),
         socket( s ),
         node_id(),
         last_handshake_recv(),
@@ -779,7 +1066,7 @@ namespace eosio {
    void connection::reset() {
       peer_requested.reset();
       blk_state.clear();
-      trx_state.clear();
+      trx_filter.clear();
    }
 
    void connection::flush_queues() {
@@ -799,6 +1086,9 @@ namespace eosio {
       connecting = false;
       syncing = false;
       consecutive_rejected_blocks = 0;
+      stats = connection_stats();
+      trx_batch.clear();
+      trx_batch_count = 0;
       if( last_req ) {
          my_impl->dispatcher->retry_fetch(shared_from_this());
       }
@@ -809,6 +1099,11 @@ namespace eosio {
       last_handshake_sent = handshake_message();
       my_impl->sync_master->reset_lib_num(shared_from_this());
       fc_ilog(logger, "closing ${a}, ${p}", ("a",peer_addr)("p",peer_name()));
+      {
+         std::lock_guard<std::mutex> g( name_mtx );
+         handshake_p2p_address.clear();
+         remote_endpoint.clear();
+      }
       fc_dlog(logger, "canceling wait on ${p}", ("p",peer_name()));
       cancel_wait();
    }
@@ -816,18 +1111,18 @@ namespace eosio {
    void connection::txn_send_pending(const vector<transaction_id_type>& ids) {
       const std::set<transaction_id_type, sha256_less> known_ids(ids.cbegin(), ids.cend());
       my_impl->expire_local_txns();
-      for(auto tx = my_impl->local_txns.begin(); tx != my_impl->local_txns.end(); ++tx ){
-         const bool found = known_ids.find( tx->id ) != known_ids.cend();
+      my_impl->local_txns.for_each( [&]( const node_transaction_state& tx ) {
+         const bool found = known_ids.find( tx.id ) != known_ids.cend();
          if( !found ) {
-           queue_write( tx->serialized_txn, true, []( boost::system::error_code ec, std::size_t ) {} );
+           queue_write( tx.serialized_txn, true, []( boost::system::error_code ec, std::size_t ) {} );
          }
-      }
+      } );
    }
 
    void connection::txn_send(const vector<transaction_id_type>& ids) {
       for(const auto& t : ids) {
-         auto tx = my_impl->local_txns.get<by_id>().find(t);
-         if( tx != my_impl->local_txns.end() ) {
+         auto tx = my_impl->local_txns.find(t);
+         if( tx ) {
            queue_write( tx->serialized_txn, true, []( boost::system::error_code ec, std::size_t ) {} );
          }
       }
@@ -1027,28 +1322,68 @@ namespace eosio {
       }
    }
 
+   static std::shared_ptr<std::vector<char>> create_send_buffer_for_block_num( const controller& cc, uint32_t block_num );
+
+   static std::shared_ptr<std::vector<char>> create_compressed_send_buffer( const std::vector<char>& frames );
+
    void connection::enqueue_sync_block() {
          connection_wptr c(shared_from_this());
          app().post( priority::low, [c]() {
             auto conn = c.lock();
             if(!conn) return;
-            if( !conn->peer_requested )
+            if( !conn->peer_requested || conn->sync_compress_in_progress )
                return;
-            uint32_t num = ++conn->peer_requested->last;
-            if( num == conn->peer_requested->end_block ) {
-               conn->peer_requested.reset();
-               fc_ilog( logger, "completing enqueue_sync_block ${num} to ${p}", ("num", num)( "p", conn->peer_name() ) );
-         }
-         try {
-                 controller& cc = my_impl->chain_plug->chain();
-                 signed_block_ptr sb = cc.fetch_block_by_number( num );
-                 if( sb ) {
-                    conn->enqueue_block( sb, true, true );
-                 }
-              } catch( ... ) {
-                 fc_wlog( logger, "write loop exception" );
-              }
-           } );
+            try {
+               controller& cc = my_impl->chain_plug->chain();
+               if( !conn->compress_blocks() ) {
+                  uint32_t num = ++conn->peer_requested->last;
+                  if( num == conn->peer_requested->end_block ) {
+                     conn->peer_requested.reset();
+                     fc_ilog( logger, "completing enqueue_sync_block ${num} to ${p}", ("num", num)( "p", conn->peer_name() ) );
+                  }
+                  auto send_buffer = create_send_buffer_for_block_num( cc, num );
+                  if( send_buffer ) {
+                     conn->enqueue_buffer( send_buffer, true, no_reason, true );
+                  }
+                  return;
+               }
+
+               // combine the framed blocks, compression happens on the net thread pool
+               auto frames = my_impl->buffer_pool->get( 0 );
+               for( uint32_t n = 0; n < def_max_compressed_sync_blocks && conn->peer_requested; ++n ) {
+                  uint32_t num = ++conn->peer_requested->last;
+                  if( num == conn->peer_requested->end_block ) {
+                     conn->peer_requested.reset();
+                     fc_ilog( logger, "completing enqueue_sync_block ${num} to ${p}", ("num", num)( "p", conn->peer_name() ) );
+                  }
+                  auto send_buffer = create_send_buffer_for_block_num( cc, num );
+                  if( !send_buffer ) break;
+                  frames->insert( frames->end(), send_buffer->begin(), send_buffer->end() );
+                  if( frames->size() >= def_send_buffer_size ) break;
+               }
+               if( frames->empty() ) return;
+
+               conn->sync_compress_in_progress = true;
+               boost::asio::post( my_impl->thread_pool->get_executor(), [c, frames]() {
+                  std::shared_ptr<std::vector<char>> send_buffer;
+                  try {
+                     send_buffer = create_compressed_send_buffer( *frames );
+                  } catch( ... ) {
+                     fc_wlog( logger, "unable to compress sync blocks" );
+                  }
+                  app().post( priority::low, [c, send_buffer]() {
+                     auto conn = c.lock();
+                     if( !conn ) return;
+                     conn->sync_compress_in_progress = false;
+                     if( send_buffer && conn->socket->is_open() ) {
+                        conn->enqueue_buffer( send_buffer, true, no_reason, true );
+                     }
+                  } );
+               } );
+            } catch( ... ) {
+               fc_wlog( logger, "write loop exception" );
+            }
+         } );
    }
 
    void connection::enqueue( const net_message& m, bool trigger_send ) {
@@ -1064,7 +1399,7 @@ namespace eosio {
       static_assert( header_size == message_header_size, "invalid message_header_size" );
       const size_t buffer_size = header_size + payload_size;
 
-      auto send_buffer = std::make_shared<vector<char>>(buffer_size);
+      auto send_buffer = my_impl->buffer_pool->get( buffer_size );
       fc::datastream<char*> ds( send_buffer->data(), buffer_size);
       ds.write( header, header_size );
       fc::raw::pack( ds, m );
@@ -1083,7 +1418,7 @@ namespace eosio {
       static_assert( header_size == message_header_size, "invalid message_header_size" );
       const size_t buffer_size = header_size + payload_size;
 
-      auto send_buffer = std::make_shared<vector<char>>( buffer_size );
+      auto send_buffer = my_impl->buffer_pool->get( buffer_size );
       fc::datastream<char*> ds( send_buffer->data(), buffer_size );
       ds.write( header, header_size );
       fc::raw::pack( ds, unsigned_int( which ) );
@@ -1104,8 +1439,79 @@ namespace eosio {
       return create_send_buffer( packed_transaction_which, trx );
    }
 
+   static std::shared_ptr<std::vector<char>> create_send_buffer_for_block_num( const controller& cc, uint32_t block_num ) {
+      // frame the block bytes as provided by the block log instead of unpacking and re-packing the signed_block
+      // matches which of net_message for signed_block
+      const uint32_t which_size = fc::raw::pack_size( unsigned_int( signed_block_which ) );
+      constexpr size_t header_size = message_header_size;
+      const size_t prefix_size = header_size + which_size;
+
+      auto send_buffer = my_impl->buffer_pool->get( 0 );
+      if( !cc.fetch_serialized_block_by_number( block_num, *send_buffer, prefix_size ) ) {
+         return std::shared_ptr<std::vector<char>>();
+      }
+
+      const uint32_t payload_size = send_buffer->size() - header_size;
+      fc::datastream<char*> ds( send_buffer->data(), prefix_size );
+      ds.write( reinterpret_cast<const char*>(&payload_size), header_size ); // avoid variable size encoding of uint32_t
+      fc::raw::pack( ds, unsigned_int( signed_block_which ) );
+
+      return send_buffer;
+   }
+
+   /// frames is one or more complete [uint32_t size][net_message] frames
+   static std::shared_ptr<std::vector<char>> create_compressed_send_buffer( const std::vector<char>& frames ) {
+      namespace bio = boost::iostreams;
+      compressed_message cm;
+      cm.compression = message_compression::zlib;
+      cm.uncompressed_size = frames.size();
+      cm.data.reserve( frames.size() / 2 );
+      {
+         bio::filtering_ostream comp;
+         comp.push( bio::zlib_compressor( bio::zlib::best_speed ) );
+         comp.push( bio::back_inserter( cm.data ) );
+         bio::write( comp, frames.data(), frames.size() );
+         bio::close( comp );
+      }
+      return create_send_buffer( compressed_message_which, cm );
+   }
+
+   void connection::enqueue_batched_transaction( const std::shared_ptr<std::vector<char>>& trx_buffer ) {
+      // strip the frame header and packed_transaction which, the batch frames its own
+      const size_t prefix_size = message_header_size + fc::raw::pack_size( unsigned_int( packed_transaction_which ) );
+      trx_batch.insert( trx_batch.end(), trx_buffer->begin() + prefix_size, trx_buffer->end() );
+      ++trx_batch_count;
+      if( trx_batch_count >= my_impl->trx_batch_max_count || trx_batch.size() >= my_impl->trx_batch_max_bytes ) {
+         flush_trx_batch();
+      } else {
+         my_impl->start_trx_batch_timer();
+      }
+   }
+
+   void connection::flush_trx_batch() {
+      if( trx_batch_count == 0 )
+         return;
+      // matches net_message pack of packed_transaction_batch
+      const uint32_t which_size = fc::raw::pack_size( unsigned_int( packed_transaction_batch_which ) );
+      const uint32_t count_size = fc::raw::pack_size( unsigned_int( trx_batch_count ) );
+      const uint32_t payload_size = which_size + count_size + trx_batch.size();
+      const size_t buffer_size = message_header_size + payload_size;
+
+      auto send_buffer = my_impl->buffer_pool->get( buffer_size );
+      fc::datastream<char*> ds( send_buffer->data(), buffer_size );
+      ds.write( reinterpret_cast<const char*>(&payload_size), message_header_size ); // avoid variable size encoding of uint32_t
+      fc::raw::pack( ds, unsigned_int( packed_transaction_batch_which ) );
+      fc::raw::pack( ds, unsigned_int( trx_batch_count ) );
+      ds.write( trx_batch.data(), trx_batch.size() );
+
+      fc_dlog( logger, "sending batch of ${n} trxs to ${p}", ("n", trx_batch_count)("p", peer_name()) );
+      trx_batch.clear();
+      trx_batch_count = 0;
+      enqueue_buffer( send_buffer, true, no_reason );
+   }
+
    void connection::enqueue_block( const signed_block_ptr& sb, bool trigger_send, bool to_sync_queue) {
-      enqueue_buffer( create_send_buffer( sb ), trigger_send, no_reason, to_sync_queue);
+      enqueue_buffer( my_impl->dispatcher->block_send_buffer( sb, sb->id() ), trigger_send, no_reason, to_sync_queue);
    }
 
    void connection::enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer,
@@ -1179,24 +1585,22 @@ namespace eosio {
    }
 
    const string connection::peer_name() {
-      if( !last_handshake_recv.p2p_address.empty() ) {
-         return last_handshake_recv.p2p_address;
+      std::lock_guard<std::mutex> g( name_mtx );
+      if( !handshake_p2p_address.empty() ) {
+         return handshake_p2p_address;
       }
       if( !peer_addr.empty() ) {
          return peer_addr;
       }
-      if( socket != nullptr ) {
-         boost::system::error_code ec;
-         auto rep = socket->remote_endpoint(ec);
-         if( !ec ) {
-            return rep.address().to_string() + ':' + std::to_string( rep.port() );
-         }
+      if( !remote_endpoint.empty() ) {
+         return remote_endpoint;
       }
       return "connecting client";
    }
 
    void connection::fetch_timeout( boost::system::error_code ec ) {
       if( !ec ) {
+         ++stats.fetch_timeouts;
          my_impl->dispatcher->retry_fetch(shared_from_this());
       }
       else if( ec == boost::asio::error::operation_aborted ) {
@@ -1231,12 +1635,12 @@ namespace eosio {
 
    //-----------------------------------------------------------
 
-    sync_manager::sync_manager( uint32_t req_span )
+    sync_manager::sync_manager( uint32_t req_span, uint32_t max_chunks )
       :sync_known_lib_num( 0 )
       ,sync_last_requested_num( 0 )
       ,sync_next_expected_num( 1 )
       ,sync_req_span( req_span )
-      ,source()
+      ,sync_max_chunks( max_chunks )
       ,state(in_sync)
    {
       chain_plug = app().find_plugin<chain_plugin>();
@@ -1257,9 +1661,21 @@ namespace eosio {
          return;
       }
       fc_dlog(logger, "old state ${os} becoming ${ns}",("os",stage_str(state))("ns",stage_str(newstate)));
+      if (state == lib_catchup) {
+         reset_chunks();
+      }
       state = newstate;
    }
 
+   void sync_manager::reset_chunks() {
+      for( auto& ch : chunks ) {
+         ch.second.source->cancel_wait();
+      }
+      chunks.clear();
+      unassigned.clear();
+      deferred_blocks.clear();
+   }
+
    bool sync_manager::is_active(const connection_ptr& c) {
       if (state == head_catchup && c) {
          bool fhset = c->fork_head != block_id_type();
@@ -1271,16 +1687,16 @@ namespace eosio {
    }
 
    void sync_manager::reset_lib_num(const connection_ptr& c) {
-      if(state == in_sync) {
-         source.reset();
-      }
       if( c->current() ) {
          if( c->last_handshake_recv.last_irreversible_block_num > sync_known_lib_num) {
             sync_known_lib_num =c->last_handshake_recv.last_irreversible_block_num;
          }
-      } else if( c == source ) {
-         sync_last_requested_num = 0;
-         request_next_chunk();
+      } else if( state == lib_catchup ) {
+         auto cnt = chunks.size();
+         take_back_chunks( c );
+         if( cnt != chunks.size() ) {
+            request_next_chunk();
+         }
       }
    }
 
@@ -1292,94 +1708,134 @@ namespace eosio {
               chain_plug->chain().fork_db_pending_head_block_num() < sync_last_requested_num );
    }
 
-   void sync_manager::request_next_chunk( const connection_ptr& conn ) {
-      uint32_t head_block = chain_plug->chain().fork_db_pending_head_block_num();
+   connection_ptr sync_manager::select_sync_peer( uint32_t end_block, const connection_ptr& preferred ) const {
+      auto usable = [&]( const connection_ptr& c ) {
+         if( !c->current() || c->last_handshake_recv.last_irreversible_block_num < end_block )
+            return false;
+         for( const auto& ch : chunks ) {
+            if( ch.second.source == c ) return false;
+         }
+         return true;
+      };
+      if( preferred && usable( preferred ) ) {
+         return preferred;
+      }
+      // best scoring measured peer, peers not yet measured are tried before any measured one
+      connection_ptr best;
+      for( const auto& c : my_impl->connections ) {
+         if( !usable( c ) ) continue;
+         if( !best ) {
+            best = c;
+         } else if( best->stats.sync_blocks_per_sec != 0 &&
+                    (c->stats.sync_blocks_per_sec == 0 || c->peer_score() > best->peer_score()) ) {
+            best = c;
+         }
+      }
+      return best;
+   }
 
-      if (head_block < sync_last_requested_num && source && source->current()) {
-         fc_ilog(logger, "ignoring request, head is ${h} last req = ${r} source is ${p}",
-                  ("h",head_block)("r",sync_last_requested_num)("p",source->peer_name()));
-         return;
+   bool sync_manager::request_chunk( const connection_ptr& c, uint32_t start, uint32_t end ) {
+      fc_ilog(logger, "requesting range ${s} to ${e}, from ${n}, ${c} chunks outstanding",
+              ("n",c->peer_name())("s",start)("e",end)("c",chunks.size()));
+      sync_chunk ch;
+      ch.start_block = start;
+      ch.end_block = end;
+      ch.last_received = start - 1;
+      ch.source = c;
+      ch.requested = time_point::now();
+      chunks[end] = std::move( ch );
+      c->request_sync_blocks( start, end );
+      return true;
+   }
+
+   std::map<uint32_t, sync_manager::sync_chunk>::iterator
+   sync_manager::take_back_chunk( std::map<uint32_t, sync_chunk>::iterator itr, uint32_t first_missing ) {
+      // a few blocks left at the end of a chunk are requested together with the blocks before them, rather than
+      // as a request much shorter than the span; blocks already received are ignored when they arrive again
+      const auto& ch = itr->second;
+      add_sync_range( unassigned, retake_sync_range( ch.start_block, ch.end_block, first_missing, sync_req_span ) );
+      return chunks.erase( itr );
+   }
+
+   void sync_manager::take_back_chunks( const connection_ptr& c ) {
+      for( auto itr = chunks.begin(); itr != chunks.end(); ) {
+         if( itr->second.source == c ) {
+            itr = take_back_chunk( itr, std::max( itr->second.last_received + 1, sync_next_expected_num ) );
+         } else {
+            ++itr;
+         }
       }
+   }
 
+   void sync_manager::request_next_chunk( const connection_ptr& conn ) {
       /* ----------
-       * next chunk provider selection criteria
-       * a provider is supplied and able to be used, use it.
-       * otherwise select the next available from the list, round-robin style.
+       * keep up to sync_max_chunks ranges outstanding, each with a different peer.
+       * ranges taken back from slow or closed peers are requested first. New ranges are only
+       * requested while they fit in the reorder window starting at sync_next_expected_num so
+       * the deferred blocks held for a slow peer stay bounded.
        */
-
-      if (conn && conn->current() ) {
-         source = conn;
-      }
-      else {
-         if( my_impl->connections.size() == 0 ) {
-            source.reset();
-         } else if( my_impl->connections.size() == 1 ) {
-            if (!source) {
-               source = *my_impl->connections.begin();
-            }
+      const uint32_t window = sync_req_span * sync_max_chunks * 2;
+      while( chunks.size() < sync_max_chunks ) {
+         uint32_t start = 0, end = 0;
+         bool reassigned = !unassigned.empty();
+         if( reassigned ) {
+            std::tie( start, end ) = split_sync_range( *unassigned.begin(), sync_req_span ).first;
          } else {
-            // init to a linear array search
-            auto cptr = my_impl->connections.begin();
-            auto cend = my_impl->connections.end();
-            // do we remember the previous source?
-            if( source ) {
-               //try to find it in the list
-               cptr = my_impl->connections.find( source );
-               cend = cptr;
-               if( cptr == my_impl->connections.end() ) {
-                  //not there - must have been closed! cend is now connections.end, so just flatten the ring.
-                  source.reset();
-                  cptr = my_impl->connections.begin();
-               } else {
-                  //was found - advance the start to the next. cend is the old source.
-                  if( ++cptr == my_impl->connections.end() && cend != my_impl->connections.end() ) {
-                     cptr = my_impl->connections.begin();
-                  }
-               }
-            }
+            if( sync_last_requested_num >= sync_known_lib_num ) break;
+            std::tie( start, end ) = next_sync_range( sync_last_requested_num, sync_next_expected_num,
+                                                      sync_known_lib_num, sync_req_span );
+            if( end < start || end - sync_next_expected_num >= window ) break;
+         }
 
-            //scan the list of peers looking for another able to provide sync blocks.
-            if( cptr != my_impl->connections.end() ) {
-               auto cstart_it = cptr;
-               do {
-                  //select the first one which is current and break out.
-                  if( (*cptr)->current() ) {
-                     source = *cptr;
-                     break;
-                  }
-                  if( ++cptr == my_impl->connections.end() )
-                     cptr = my_impl->connections.begin();
-               } while( cptr != cstart_it );
-            }
-            // no need to check the result, either source advanced or the whole list was checked and the old source is reused.
+         connection_ptr source = select_sync_peer( end, conn );
+         if( !source ) break;
+
+         if( reassigned ) {
+            const sync_range rest = split_sync_range( *unassigned.begin(), sync_req_span ).second;
+            unassigned.erase( unassigned.begin() );
+            add_sync_range( unassigned, rest );
+         } else {
+            sync_last_requested_num = end;
          }
+         request_chunk( source, start, end );
       }
 
       // verify there is an available source
-      if (!source || !source->current() ) {
-         fc_elog( logger, "Unable to continue syncing at this time");
-         sync_known_lib_num = chain_plug->chain().last_irreversible_block_num();
-         sync_last_requested_num = 0;
-         set_state(in_sync); // probably not, but we can't do anything else
-         return;
+      if( chunks.empty() ) {
+         if( sync_last_requested_num < sync_known_lib_num || !unassigned.empty() ) {
+            fc_elog( logger, "Unable to continue syncing at this time");
+            sync_known_lib_num = chain_plug->chain().last_irreversible_block_num();
+            sync_last_requested_num = 0;
+            set_state(in_sync); // probably not, but we can't do anything else
+         }
+         if( conn && conn->current() ) {
+            conn->send_handshake();
+         }
       }
+   }
 
-      bool request_sent = false;
-      if( sync_last_requested_num != sync_known_lib_num ) {
-         uint32_t start = sync_next_expected_num;
-         uint32_t end = start + sync_req_span - 1;
-         if( end > sync_known_lib_num )
-            end = sync_known_lib_num;
-         if( end > 0 && end >= start ) {
-            fc_ilog(logger, "requesting range ${s} to ${e}, from ${n}",
-                    ("n",source->peer_name())("s",start)("e",end));
-            request_sent = true;
-            source->request_sync_blocks(start, end);
-            sync_last_requested_num = end;
+   void sync_manager::check_slow_chunks() {
+      double best = 0;
+      for( const auto& c : my_impl->connections ) {
+         if( c->current() ) best = std::max( best, c->stats.sync_blocks_per_sec );
+      }
+      if( best == 0 ) return;
+
+      // a chunk progressing at a quarter of the best known rate is handed to an idle peer
+      const auto now = time_point::now();
+      std::vector<connection_ptr> slow;
+      for( const auto& ch : chunks ) {
+         const auto elapsed = now - ch.second.requested;
+         if( elapsed < fc::seconds( 2 ) ) continue;
+         const double received = ch.second.last_received + 1 - ch.second.start_block;
+         const double rate = received * 1000000 / elapsed.count();
+         if( rate * 4 < best && select_sync_peer( ch.second.end_block, connection_ptr() ) ) {
+            slow.emplace_back( ch.second.source );
          }
       }
-      if( !request_sent ) {
-         source->send_handshake();
+      for( const auto& c : slow ) {
+         fc_ilog( logger, "sync peer ${p} is slow, reassigning its range", ("p", c->peer_name()) );
+         reassign_fetch( c, benign_other );
       }
    }
 
@@ -1420,9 +1876,10 @@ namespace eosio {
       fc_ilog(logger, "reassign_fetch, our last req is ${cc}, next expected is ${ne} peer ${p}",
               ( "cc",sync_last_requested_num)("ne",sync_next_expected_num)("p",c->peer_name()));
 
-      if (c == source) {
+      auto cnt = chunks.size();
+      take_back_chunks( c );
+      if( cnt != chunks.size() ) {
          c->cancel_sync(reason);
-         sync_last_requested_num = 0;
          request_next_chunk();
       }
    }
@@ -1593,7 +2050,7 @@ namespace eosio {
       if ( ++c->consecutive_rejected_blocks > def_max_consecutive_rejected_blocks ) {
          fc_wlog( logger, "block ${bn} not accepted from ${p}, closing connection", ("bn",blk_num)("p",c->peer_name()) );
          sync_last_requested_num = 0;
-         source.reset();
+         reset_chunks();
          my_impl->close(c);
          set_state(in_sync);
          send_handshakes();
@@ -1614,7 +2071,6 @@ namespace eosio {
       if (state == head_catchup) {
          fc_dlog(logger, "sync_manager in head_catchup state");
          set_state(in_sync);
-         source.reset();
 
          block_id_type null_id;
          for (const auto& cp : my_impl->connections) {
@@ -1640,18 +2096,103 @@ namespace eosio {
             set_state(in_sync);
             send_handshakes();
          }
-         else if (blk_num == sync_last_requested_num) {
+         else {
+            // applying a block may have opened the reorder window
             request_next_chunk();
          }
-         else {
-            fc_dlog(logger,"calling sync_wait on connection ${p}",("p",c->peer_name()));
-            c->sync_wait();
+      }
+   }
+
+   void sync_manager::chunk_progress(const connection_ptr& c, uint32_t blk_num) {
+      if (state != lib_catchup) {
+         return;
+      }
+      auto itr = chunks.lower_bound( blk_num );
+      if( itr == chunks.end() || itr->second.start_block > blk_num || itr->second.source != c ) {
+         return;
+      }
+      auto& ch = itr->second;
+      if( blk_num > ch.last_received ) {
+         ch.last_received = blk_num;
+      }
+      if( blk_num != ch.end_block ) {
+         fc_dlog(logger,"calling sync_wait on connection ${p}",("p",c->peer_name()));
+         c->sync_wait();
+         return;
+      }
+
+      const auto elapsed = std::max<int64_t>( (time_point::now() - ch.requested).count(), 1 );
+      const double rate = double( ch.end_block + 1 - ch.start_block ) * 1000000 / elapsed;
+      auto& bps = c->stats.sync_blocks_per_sec;
+      bps = bps == 0 ? rate : bps * 0.7 + rate * 0.3;
+      fc_dlog( logger, "sync chunk ${s} to ${e} from ${p} complete, ${r} blocks/sec",
+               ("s", ch.start_block)("e", ch.end_block)("p", c->peer_name())("r", uint64_t(bps)) );
+      c->cancel_wait();
+      chunks.erase( itr );
+
+      check_slow_chunks();
+      request_next_chunk();
+   }
+
+   bool sync_manager::defer_block(const connection_ptr& c, const signed_block_ptr& blk, const block_id_type& blk_id, uint32_t blk_num) {
+      if (state != lib_catchup || blk_num <= sync_next_expected_num) {
+         return false;
+      }
+      if( blk_num > sync_last_requested_num ) {
+         // not in any requested range, such as a new block broadcast during sync. Holding it could fill the buffer
+         // and crowd out requested blocks, and it is requested in order later
+         fc_dlog( logger, "ignoring unrequested block ${n} from ${p} during sync", ("n", blk_num)("p", c->peer_name()) );
+         return true;
+      }
+      // requested ranges stay within the window request_next_chunk keeps, so this only guards against a stall:
+      // chunk progress has already moved past the block, so it is requested again together with the rest of its
+      // chunk, or with the blocks before it when the chunk completed with it
+      if( deferred_blocks.size() >= sync_req_span * sync_max_chunks * 2 ) {
+         fc_wlog( logger, "sync reorder buffer full, requesting block ${n} from ${p} again", ("n", blk_num)("p", c->peer_name()) );
+         auto itr = chunks.lower_bound( blk_num );
+         if( itr != chunks.end() && itr->second.start_block <= blk_num ) {
+            if( itr->second.source != c ) return true; // requested from another peer, which still sends it
+            take_back_chunk( itr, blk_num );
+         } else {
+            uint32_t start = std::max( blk_num >= sync_req_span ? blk_num - sync_req_span + 1 : 1, sync_next_expected_num );
+            if( itr != chunks.begin() ) start = std::max( start, std::prev( itr )->first + 1 );
+            add_sync_range( unassigned, { start, blk_num } );
          }
+         request_next_chunk();
+         return true;
       }
+      deferred_blocks.emplace( blk_num, deferred_block{blk, blk_id, c} );
+      return true;
+   }
+
+   optional<sync_manager::deferred_block> sync_manager::pop_ready_block() {
+      while( !deferred_blocks.empty() && deferred_blocks.begin()->first < sync_next_expected_num ) {
+         deferred_blocks.erase( deferred_blocks.begin() );
+      }
+      if( state != lib_catchup || deferred_blocks.empty() || deferred_blocks.begin()->first != sync_next_expected_num ) {
+         return optional<deferred_block>();
+      }
+      optional<deferred_block> ready( std::move( deferred_blocks.begin()->second ) );
+      deferred_blocks.erase( deferred_blocks.begin() );
+      return ready;
    }
 
    //------------------------------------------------------------------------
 
+   std::shared_ptr<std::vector<char>> dispatch_manager::block_send_buffer(const signed_block_ptr& sb, const block_id_type& id) {
+      constexpr size_t max_encoded_blocks = 8;
+      for( auto itr = encoded_blocks.rbegin(); itr != encoded_blocks.rend(); ++itr ) {
+         if( itr->first == id )
+            return itr->second;
+      }
+      auto send_buffer = create_send_buffer( sb );
+      encoded_blocks.emplace_back( id, send_buffer );
+      if( encoded_blocks.size() > max_encoded_blocks ) {
+         encoded_blocks.pop_front();
+      }
+      return send_buffer;
+   }
+
    void dispatch_manager::bcast_block(const block_state_ptr& bs) {
       std::set<connection_ptr> skips;
       auto range = received_blocks.equal_range(bs->id);
@@ -1664,6 +2205,7 @@ namespace eosio {
       peer_block_state pbstate{bs->id, bnum};
 
       std::shared_ptr<std::vector<char>> send_buffer;
+      std::vector<connection_wptr> compress_conns;
       for( auto& cp : my_impl->connections ) {
          if( skips.find( cp ) != skips.end() || !cp->current() ) {
             continue;
@@ -1675,13 +2217,43 @@ namespace eosio {
                continue;
             }
             if( !send_buffer ) {
-               send_buffer = create_send_buffer( bs->block );
+               send_buffer = block_send_buffer( bs->block, bs->id );
+            }
+            // a block too small to compress only takes the strand while a larger one is still being compressed,
+            // so it cannot overtake it
+            if( cp->compress_blocks() &&
+                (send_buffer->size() >= my_impl->compression_min_size || compressions_in_flight > 0) ) {
+               compress_conns.emplace_back( cp );
+               continue;
             }
             fc_dlog(logger, "bcast block ${b} to ${p}", ("b", bnum)("p", cp->peer_name()));
             cp->enqueue_buffer( send_buffer, true, no_reason );
          }
       }
 
+      if( !compress_conns.empty() ) {
+         // compress once for all peers on the net thread pool, the strand keeps blocks in order
+         ++compressions_in_flight;
+         my_impl->compress_strand->post( [send_buffer, bnum, compress_conns{std::move(compress_conns)}]() mutable {
+            std::shared_ptr<std::vector<char>> compressed = send_buffer;
+            if( send_buffer->size() >= my_impl->compression_min_size ) {
+               try {
+                  compressed = create_compressed_send_buffer( *send_buffer );
+               } catch( ... ) {
+                  fc_wlog( logger, "unable to compress block ${b}, sending uncompressed", ("b", bnum) );
+               }
+            }
+            app().post( priority::high, [compressed, bnum, compress_conns{std::move(compress_conns)}]() {
+               --my_impl->dispatcher->compressions_in_flight;
+               for( const auto& wc : compress_conns ) {
+                  auto cp = wc.lock();
+                  if( !cp || !cp->socket->is_open() ) continue;
+                  fc_dlog(logger, "bcast compressed block ${b} to ${p}", ("b", bnum)("p", cp->peer_name()));
+                  cp->enqueue_buffer( compressed, true, no_reason );
+               }
+            } );
+         } );
+      }
    }
 
    void dispatch_manager::recv_block(const connection_ptr& c, const block_id_type& id, uint32_t bnum) {
@@ -1727,7 +2299,7 @@ namespace eosio {
       }
       received_transactions.erase(range.first, range.second);
 
-      if( my_impl->local_txns.get<by_id>().find( id ) != my_impl->local_txns.end() ) { //found
+      if( my_impl->local_txns.contains( id ) ) { //found
          fc_dlog(logger, "found trxid in local_trxs" );
          return;
       }
@@ -1738,16 +2310,17 @@ namespace eosio {
       auto buff = create_send_buffer( trx );
 
       node_transaction_state nts = {id, trx_expiration, 0, buff};
-      my_impl->local_txns.insert(std::move(nts));
+      {
+         std::lock_guard<std::mutex> g( my_impl->local_txns_mtx );
+         my_impl->local_txns.insert(std::move(nts));
+      }
 
       my_impl->send_transaction_to_all( buff, [&id, &skips, trx_expiration](const connection_ptr& c) -> bool {
          if( skips.find(c) != skips.end() || c->syncing ) {
             return false;
           }
-          const auto& bs = c->trx_state.find(id);
-          bool unknown = bs == c->trx_state.end();
+          bool unknown = c->trx_filter.insert( id, trx_expiration );
           if( unknown ) {
-             c->trx_state.insert(transaction_state({id,0,trx_expiration}));
              fc_dlog(logger, "sending trx to ${n}", ("n",c->peer_name() ) );
           }
           return unknown;
@@ -1819,9 +2392,18 @@ namespace eosio {
       }
       fc_dlog( logger, "send req = ${sr}", ("sr",send_req));
       if( send_req) {
-         c->enqueue(req);
-         c->fetch_wait();
-         c->last_req = std::move(req);
+         // ask the best scoring idle peer known to have the block, the notifying peer otherwise
+         connection_ptr target = c;
+         const block_id_type& blkid = req.req_blocks.ids.back();
+         for( const auto& conn : my_impl->connections ) {
+            if( conn == c || conn->last_req || !conn->current() || !conn->peer_has_block( blkid ) )
+               continue;
+            if( conn->peer_score() > target->peer_score() )
+               target = conn;
+         }
+         target->enqueue(req);
+         target->fetch_wait();
+         target->last_req = std::move(req);
       }
    }
 
@@ -1845,25 +2427,28 @@ namespace eosio {
                   ("b",modes_str(c->last_req->req_blocks.mode))("t",modes_str(c->last_req->req_trx.mode)));
          return;
       }
+      connection_ptr best;
       for (auto& conn : my_impl->connections) {
          if (conn == c || conn->last_req) {
             continue;
          }
          bool sendit = false;
          if (is_txn) {
-            auto trx = conn->trx_state.get<by_id>().find(tid);
-            sendit = trx != conn->trx_state.end();
+            sendit = conn->trx_filter.contains(tid);
          }
          else {
             sendit = conn->peer_has_block(bid);
          }
-         if (sendit) {
-            conn->enqueue(*c->last_req);
-            conn->fetch_wait();
-            conn->last_req = c->last_req;
-            return;
+         if (sendit && (!best || conn->peer_score() > best->peer_score())) {
+            best = conn;
          }
       }
+      if (best) {
+         best->enqueue(*c->last_req);
+         best->fetch_wait();
+         best->last_req = c->last_req;
+         return;
+      }
 
       // at this point no other peer has it, re-request or do nothing?
       if( c->connected() ) {
@@ -1926,7 +2511,11 @@ namespace eosio {
          return;
       }
       c->connecting = true;
-      c->pending_message_buffer.reset();
+      // posted before the read started once connected, so it cannot race a read of the previous socket
+      c->strand.post( [c]() {
+         c->pending_message_buffer.reset();
+         c->outstanding_read_bytes.reset();
+      } );
       c->buffer_queue.clear_out_queue();
       connection_wptr weak_conn = c;
       boost::asio::async_connect( *c->socket, endpoints,
@@ -1959,6 +2548,11 @@ namespace eosio {
          return false;
       }
       else {
+         auto rep = con->socket->remote_endpoint( ec );
+         if( !ec ) {
+            std::lock_guard<std::mutex> g( con->name_mtx );
+            con->remote_endpoint = rep.address().to_string() + ':' + std::to_string( rep.port() );
+         }
          start_read_message( con );
          ++started_sessions;
          return true;
@@ -2043,29 +2637,6 @@ namespace eosio {
          if(!conn->socket) {
             return;
          }
-         connection_wptr weak_conn = conn;
-
-         std::size_t minimum_read = conn->outstanding_read_bytes ? *conn->outstanding_read_bytes : message_header_size;
-
-         if (use_socket_read_watermark) {
-            const size_t max_socket_read_watermark = 4096;
-            std::size_t socket_read_watermark = std::min<std::size_t>(minimum_read, max_socket_read_watermark);
-            boost::asio::socket_base::receive_low_watermark read_watermark_opt(socket_read_watermark);
-            boost::system::error_code ec;
-            conn->socket->set_option( read_watermark_opt, ec );
-            if( ec ) {
-               fc_elog( logger, "unable to set read watermark ${peer}: ${e1}", ("peer", conn->peer_name())( "e1", ec.message() ) );
-            }
-         }
-
-         auto completion_handler = [minimum_read](boost::system::error_code ec, std::size_t bytes_transferred) -> std::size_t {
-            if (ec || bytes_transferred >= minimum_read ) {
-               return 0;
-            } else {
-               return minimum_read - bytes_transferred;
-            }
-         };
-
          if( conn->buffer_queue.write_queue_size() > def_max_write_queue_size ) {
             fc_elog( logger, "write queue full ${s} bytes, giving up on connection, closing connection to: ${p}",
                      ("s", conn->buffer_queue.write_queue_size())("p", conn->peer_name()) );
@@ -2073,90 +2644,151 @@ namespace eosio {
             return;
          }
 
-         boost::asio::async_read(*conn->socket,
-            conn->pending_message_buffer.get_buffer_sequence_for_boost_async_read(), completion_handler,
-            boost::asio::bind_executor( conn->strand,
-              [this,weak_conn,socket=conn->socket]( boost::system::error_code ec, std::size_t bytes_transferred ) {
-            app().post( priority::medium, [this,weak_conn, socket, ec, bytes_transferred]() {
-               auto conn = weak_conn.lock();
-               if (!conn || !conn->socket || !conn->socket->is_open() || !socket->is_open()) {
-                  return;
+         connection_wptr weak_conn = conn;
+         // pending_message_buffer and outstanding_read_bytes are only used on the strand, so the read is started
+         // there as well as completed there
+         conn->strand.post( [this, weak_conn, socket=conn->socket]() {
+            auto conn = weak_conn.lock();
+            if( !conn || !socket->is_open() ) {
+               return;
+            }
+            try {
+               std::size_t minimum_read = conn->outstanding_read_bytes ? *conn->outstanding_read_bytes : message_header_size;
+
+               if (use_socket_read_watermark) {
+                  const size_t max_socket_read_watermark = 4096;
+                  std::size_t socket_read_watermark = std::min<std::size_t>(minimum_read, max_socket_read_watermark);
+                  boost::asio::socket_base::receive_low_watermark read_watermark_opt(socket_read_watermark);
+                  boost::system::error_code ec;
+                  socket->set_option( read_watermark_opt, ec );
+                  if( ec ) {
+                     fc_elog( logger, "unable to set read watermark ${peer}: ${e1}", ("peer", conn->peer_name())( "e1", ec.message() ) );
+                  }
                }
 
-               conn->outstanding_read_bytes.reset();
+               auto completion_handler = [minimum_read](boost::system::error_code ec, std::size_t bytes_transferred) -> std::size_t {
+                  if (ec || bytes_transferred >= minimum_read ) {
+                     return 0;
+                  } else {
+                     return minimum_read - bytes_transferred;
+                  }
+               };
+
+               boost::asio::async_read(*socket,
+                  conn->pending_message_buffer.get_buffer_sequence_for_boost_async_read(), completion_handler,
+                  boost::asio::bind_executor( conn->strand,
+                    [this,weak_conn,socket]( boost::system::error_code ec, std::size_t bytes_transferred ) {
+                  auto conn = weak_conn.lock();
+                  if (!conn || !socket->is_open()) {
+                     return;
+                  }
 
-               try {
-                  if( !ec ) {
-                     if (bytes_transferred > conn->pending_message_buffer.bytes_to_write()) {
-                        fc_elog( logger,"async_read_some callback: bytes_transfered = ${bt}, buffer.bytes_to_write = ${btw}",
-                                 ("bt",bytes_transferred)("btw",conn->pending_message_buffer.bytes_to_write()) );
-                     }
-                     EOS_ASSERT(bytes_transferred <= conn->pending_message_buffer.bytes_to_write(), plugin_exception, "");
-                     conn->pending_message_buffer.advance_write_ptr(bytes_transferred);
-                     while (conn->pending_message_buffer.bytes_to_read() > 0) {
-                        uint32_t bytes_in_buffer = conn->pending_message_buffer.bytes_to_read();
-
-                        if (bytes_in_buffer < message_header_size) {
-                           conn->outstanding_read_bytes.emplace(message_header_size - bytes_in_buffer);
-                           break;
-                        } else {
-                           uint32_t message_length;
-                           auto index = conn->pending_message_buffer.read_index();
-                           conn->pending_message_buffer.peek(&message_length, sizeof(message_length), index);
-                           if(message_length > def_send_buffer_size*2 || message_length == 0) {
-                              boost::system::error_code ec;
-                              fc_elog( logger,"incoming message length unexpected (${i}), from ${p}",
-                                       ("i", message_length)("p",boost::lexical_cast<std::string>(conn->socket->remote_endpoint(ec))) );
-                              close(conn);
-                              return;
-                           }
+                  conn->outstanding_read_bytes.reset();
 
-                           auto total_message_bytes = message_length + message_header_size;
+                  vector<received_message> msgs;
+                  bool close_connection = false;
+                  try {
+                     if( !ec ) {
+                        if (bytes_transferred > conn->pending_message_buffer.bytes_to_write()) {
+                           fc_elog( logger,"async_read_some callback: bytes_transfered = ${bt}, buffer.bytes_to_write = ${btw}",
+                                    ("bt",bytes_transferred)("btw",conn->pending_message_buffer.bytes_to_write()) );
+                        }
+                        EOS_ASSERT(bytes_transferred <= conn->pending_message_buffer.bytes_to_write(), plugin_exception, "");
+                        conn->pending_message_buffer.advance_write_ptr(bytes_transferred);
+                        while (conn->pending_message_buffer.bytes_to_read() > 0) {
+                           uint32_t bytes_in_buffer = conn->pending_message_buffer.bytes_to_read();
 
-                           if (bytes_in_buffer >= total_message_bytes) {
-                              conn->pending_message_buffer.advance_read_ptr(message_header_size);
-                              if (!process_next_message(conn, message_length)) {
-                                 return;
-                              }
+                           if (bytes_in_buffer < message_header_size) {
+                              conn->outstanding_read_bytes.emplace(message_header_size - bytes_in_buffer);
+                              break;
                            } else {
-                              auto outstanding_message_bytes = total_message_bytes - bytes_in_buffer;
-                              auto available_buffer_bytes = conn->pending_message_buffer.bytes_to_write();
-                              if (outstanding_message_bytes > available_buffer_bytes) {
-                                 conn->pending_message_buffer.add_space( outstanding_message_bytes - available_buffer_bytes );
+                              uint32_t message_length;
+                              auto index = conn->pending_message_buffer.read_index();
+                              conn->pending_message_buffer.peek(&message_length, sizeof(message_length), index);
+                              if(message_length > def_send_buffer_size*2 || message_length == 0) {
+                                 fc_elog( logger,"incoming message length unexpected (${i}), from ${p}",
+                                          ("i", message_length)("p",conn->peer_name()) );
+                                 close_connection = true;
+                                 break;
                               }
 
-                              conn->outstanding_read_bytes.emplace(outstanding_message_bytes);
-                              break;
+                              auto total_message_bytes = message_length + message_header_size;
+
+                              if (bytes_in_buffer >= total_message_bytes) {
+                                 conn->pending_message_buffer.advance_read_ptr(message_header_size);
+                                 if (!process_next_message(conn, message_length, msgs)) {
+                                    close_connection = true;
+                                    break;
+                                 }
+                              } else {
+                                 auto outstanding_message_bytes = total_message_bytes - bytes_in_buffer;
+                                 auto available_buffer_bytes = conn->pending_message_buffer.bytes_to_write();
+                                 if (outstanding_message_bytes > available_buffer_bytes) {
+                                    conn->pending_message_buffer.add_space( outstanding_message_bytes - available_buffer_bytes );
+                                 }
+
+                                 conn->outstanding_read_bytes.emplace(outstanding_message_bytes);
+                                 break;
+                              }
                            }
                         }
-                     }
-                     start_read_message(conn);
-                  } else {
-                     auto pname = conn->peer_name();
-                     if (ec.value() != boost::asio::error::eof) {
-                        fc_elog( logger, "Error reading message from ${p}: ${m}",("p",pname)( "m", ec.message() ) );
                      } else {
-                        fc_ilog( logger, "Peer ${p} closed connection",("p",pname) );
+                        if (ec.value() != boost::asio::error::eof) {
+                           fc_elog( logger, "Error reading message from ${p}: ${m}",("p",conn->peer_name())( "m", ec.message() ) );
+                        } else {
+                           fc_ilog( logger, "Peer ${p} closed connection",("p",conn->peer_name()) );
+                        }
+                        close_connection = true;
                      }
+                  }
+                  catch(const std::exception &ex) {
+                     fc_elog( logger, "Exception in handling read data from ${p}: ${s}",
+                              ("p",conn->peer_name())("s",ex.what()) );
+                     close_connection = true;
+                  }
+                  catch(const fc::exception &ex) {
+                     fc_elog( logger, "Exception in handling read data from ${p}: ${s}",
+                              ("p",conn->peer_name())("s",ex.to_string()) );
+                     close_connection = true;
+                  }
+                  catch (...) {
+                     fc_elog( logger, "Undefined exception handling the read data from ${p}",( "p",conn->peer_name()) );
+                     close_connection = true;
+                  }
+
+                  app().post( priority::medium, [this, weak_conn, socket, close_connection, msgs{std::move(msgs)}]() mutable {
+                     auto conn = weak_conn.lock();
+                     if (!conn || !conn->socket || !conn->socket->is_open() || conn->socket != socket) {
+                        return;
+                     }
+                     try {
+                        handle_received_messages( conn, msgs );
+                     } catch( const fc::exception& e ) {
+                        fc_elog( logger, "Exception in handling message from ${p}: ${s}",
+                                 ("p", conn->peer_name())("s", e.to_detail_string()) );
+                        close_connection = true;
+                     } catch( const std::exception& e ) {
+                        fc_elog( logger, "Exception in handling message from ${p}: ${s}",
+                                 ("p", conn->peer_name())("s", e.what()) );
+                        close_connection = true;
+                     }
+                     if( close_connection ) {
+                        close( conn );
+                     } else if( conn->socket->is_open() ) {
+                        start_read_message( conn );
+                     }
+                  });
+               }));
+            } catch( ... ) {
+               fc_elog( logger, "Undefined exception starting a read from ${p}", ("p", conn->peer_name()) );
+               app().post( priority::medium, [this, weak_conn, socket]() {
+                  auto conn = weak_conn.lock();
+                  if( conn && conn->socket == socket ) {
                      close( conn );
                   }
-               }
-               catch(const std::exception &ex) {
-                  fc_elog( logger, "Exception in handling read data from ${p}: ${s}",
-                           ("p",conn->peer_name())("s",ex.what()) );
-                  close( conn );
-               }
-               catch(const fc::exception &ex) {
-                  fc_elog( logger, "Exception in handling read data from ${p}: ${s}",
-                           ("p",conn->peer_name())("s",ex.to_string()) );
-                  close( conn );
-               }
-               catch (...) {
-                  fc_elog( logger, "Undefined exception handling the read data from ${p}",( "p",conn->peer_name()) );
-                  close( conn );
-               }
-            });
-         }));
+               } );
+            }
+         } );
       } catch (...) {
          string pname = conn ? conn->peer_name() : "no connection name";
          fc_elog( logger, "Undefined exception handling reading ${p}",("p",pname) );
@@ -2164,66 +2796,191 @@ namespace eosio {
       }
    }
 
-   bool net_plugin_impl::process_next_message(const connection_ptr& conn, uint32_t message_length) {
+   bool net_plugin_impl::have_txn(const transaction_id_type& id) const {
+      std::lock_guard<std::mutex> g( local_txns_mtx );
+      return local_txns.contains( id );
+   }
+
+   bool net_plugin_impl::process_next_message(const connection_ptr& conn, uint32_t message_length, vector<received_message>& msgs) {
       try {
-         // if next message is a block we already have, exit early
          auto peek_ds = conn->pending_message_buffer.create_peek_datastream();
          unsigned_int which{};
          fc::raw::unpack( peek_ds, which );
-         if( which == signed_block_which ) {
-            block_header bh;
-            fc::raw::unpack( peek_ds, bh );
-
-            const controller& cc = chain_plug->chain();
-            const block_id_type blk_id = bh.id();
-            const uint32_t blk_num = bh.block_num();
-            if( !sync_master->syncing_with_peer() ) {
-               uint32_t lib = cc.last_irreversible_block_num();
-               if( blk_num < lib ) {
-                  const auto last_sent_lib = conn->last_handshake_sent.last_irreversible_block_num;
-                  if( !conn->peer_requested && blk_num < last_sent_lib ) {
-                     fc_ilog( logger, "received block ${n} less than sent lib ${lib}", ("n", blk_num)("lib", last_sent_lib) );
-                     close( conn );
-                  } else {
-                     fc_ilog( logger, "received block ${n} less than lib ${lib}", ("n", blk_num)("lib", lib) );
-                     conn->enqueue( (sync_request_message) {0, 0} );
-                     conn->send_handshake();
-                     conn->cancel_wait();
-                  }
-
-                  conn->pending_message_buffer.advance_read_ptr( message_length );
-                  return true;
-               }
-            }
-            if( cc.fetch_block_by_id( blk_id ) ) {
-               if( sync_master->syncing_with_peer() )
-                  sync_master->recv_block( conn, blk_id, blk_num );
-               conn->cancel_wait();
-               conn->pending_message_buffer.advance_read_ptr( message_length );
-               return true;
-            }
-         }
-
          auto ds = conn->pending_message_buffer.create_datastream();
-         net_message msg;
-         fc::raw::unpack( ds, msg );
-         msg_handler m( *this, conn );
-         if( msg.contains<signed_block>() ) {
-            m( std::move( msg.get<signed_block>() ) );
-         } else if( msg.contains<packed_transaction>() ) {
-            m( std::move( msg.get<packed_transaction>() ) );
-         } else {
-            msg.visit( m );
-         }
+         unpack_message( conn, which, ds, msgs, false );
       } catch( const fc::exception& e ) {
          fc_elog( logger, "Exception in handling message from ${p}: ${s}",
                   ("p", conn->peer_name())("s", e.to_detail_string()) );
-         close( conn );
+         return false;
+      } catch( const std::exception& e ) {
+         fc_elog( logger, "Exception in handling message from ${p}: ${s}",
+                  ("p", conn->peer_name())("s", e.what()) );
          return false;
       }
       return true;
    }
 
+   namespace {
+      /// collects decompressed output, refusing more than the size announced by the sender
+      struct bounded_sink {
+         typedef char                     char_type;
+         typedef boost::iostreams::sink_tag category;
+
+         std::vector<char>& out;
+         size_t             limit;
+
+         std::streamsize write( const char* s, std::streamsize n ) {
+            EOS_ASSERT( out.size() + n <= limit, plugin_exception, "compressed message larger than announced size ${s}", ("s", limit) );
+            out.insert( out.end(), s, s + n );
+            return n;
+         }
+      };
+   }
+
+   template<typename Stream>
+   void net_plugin_impl::unpack_message(const connection_ptr& conn, uint32_t which, Stream& ds, vector<received_message>& msgs, bool nested) {
+      if( which == signed_block_which ) {
+         unsigned_int w{};
+         fc::raw::unpack( ds, w );
+         received_message m;
+         auto block = std::make_shared<signed_block>();
+         fc::raw::unpack( ds, *block );
+         m.block_id = block->id();
+         m.block = std::move( block );
+         msgs.emplace_back( std::move( m ) );
+      } else if( which == packed_transaction_which ) {
+         unsigned_int w{};
+         fc::raw::unpack( ds, w );
+         auto trx = std::make_shared<packed_transaction>();
+         fc::raw::unpack( ds, *trx );
+         unpacked_transaction( std::move( trx ), msgs );
+      } else if( which == packed_transaction_batch_which ) {
+         unsigned_int w{};
+         fc::raw::unpack( ds, w );
+         unsigned_int count{};
+         fc::raw::unpack( ds, count );
+         EOS_ASSERT( count.value <= def_trx_batch_max_count * 10, plugin_exception,
+                     "packed_transaction_batch too large ${n}", ("n", count.value) );
+         for( uint32_t i = 0; i < count.value; ++i ) {
+            auto trx = std::make_shared<packed_transaction>();
+            fc::raw::unpack( ds, *trx );
+            unpacked_transaction( std::move( trx ), msgs );
+         }
+      } else if( which == compressed_message_which ) {
+         EOS_ASSERT( !nested, plugin_exception, "nested compressed_message" );
+         unsigned_int w{};
+         fc::raw::unpack( ds, w );
+         compressed_message cm;
+         fc::raw::unpack( ds, cm );
+         EOS_ASSERT( cm.compression == message_compression::zlib, plugin_exception,
+                     "unsupported message compression ${c}", ("c", (uint32_t)(uint8_t)cm.compression) );
+         EOS_ASSERT( cm.uncompressed_size <= def_max_uncompressed_size, plugin_exception,
+                     "compressed_message too large ${s}", ("s", cm.uncompressed_size) );
+
+         namespace bio = boost::iostreams;
+         std::vector<char> frames;
+         frames.reserve( cm.uncompressed_size );
+         {
+            bio::filtering_ostream decomp;
+            decomp.push( bio::zlib_decompressor() );
+            decomp.push( bounded_sink{frames, cm.uncompressed_size} );
+            bio::write( decomp, cm.data.data(), cm.data.size() );
+            bio::close( decomp );
+         }
+         EOS_ASSERT( frames.size() == cm.uncompressed_size, plugin_exception, "compressed_message size mismatch" );
+
+         fc::datastream<const char*> frames_ds( frames.data(), frames.size() );
+         while( frames_ds.remaining() > 0 ) {
+            uint32_t message_length = 0;
+            frames_ds.read( reinterpret_cast<char*>(&message_length), message_header_size );
+            EOS_ASSERT( message_length > 0 && message_length <= frames_ds.remaining(), plugin_exception,
+                        "invalid message length ${l} in compressed_message", ("l", message_length) );
+            fc::datastream<const char*> frame_ds( frames_ds.pos(), message_length );
+            auto peek_ds = frame_ds;
+            unsigned_int frame_which{};
+            fc::raw::unpack( peek_ds, frame_which );
+            unpack_message( conn, frame_which, frame_ds, msgs, true );
+            frames_ds.skip( message_length );
+         }
+      } else {
+         received_message m;
+         m.msg.emplace();
+         fc::raw::unpack( ds, *m.msg );
+         msgs.emplace_back( std::move( m ) );
+      }
+   }
+
+   void net_plugin_impl::unpacked_transaction(packed_transaction_ptr trx, vector<received_message>& msgs) {
+      auto ptrx = std::make_shared<transaction_metadata>( trx );
+      if( have_txn( ptrx->id ) ) {
+         fc_dlog( logger, "got a duplicate transaction - dropping" );
+         received_message m;
+         m.known_trx.emplace( ptrx->id, trx->expiration() );
+         msgs.emplace_back( std::move( m ) );
+         return;
+      }
+      // key recovery runs on its own pool while the transaction waits for the main thread
+      const auto max_cpu = max_trx_cpu_usage.load();
+      transaction_metadata::start_recover_keys( ptrx, key_recovery_pool->get_executor(), chain_id,
+                                                max_cpu ? fc::microseconds( max_cpu ) : fc::microseconds::maximum() );
+      received_message m;
+      m.trx = std::move( ptrx );
+      msgs.emplace_back( std::move( m ) );
+   }
+
+   bool net_plugin_impl::is_known_block(const connection_ptr& conn, const block_id_type& blk_id) {
+      // if the block is one we already have, skip it
+      const controller& cc = chain_plug->chain();
+      const uint32_t blk_num = block_header::num_from_id( blk_id );
+      if( !sync_master->syncing_with_peer() ) {
+         uint32_t lib = cc.last_irreversible_block_num();
+         if( blk_num < lib ) {
+            const auto last_sent_lib = conn->last_handshake_sent.last_irreversible_block_num;
+            if( !conn->peer_requested && blk_num < last_sent_lib ) {
+               fc_ilog( logger, "received block ${n} less than sent lib ${lib}", ("n", blk_num)("lib", last_sent_lib) );
+               close( conn );
+            } else {
+               fc_ilog( logger, "received block ${n} less than lib ${lib}", ("n", blk_num)("lib", lib) );
+               conn->enqueue( (sync_request_message) {0, 0} );
+               conn->send_handshake();
+               conn->cancel_wait();
+            }
+            return true;
+         }
+      }
+      if( cc.fetch_block_by_id( blk_id ) ) {
+         conn->cancel_wait();
+         if( sync_master->syncing_with_peer() ) {
+            sync_master->chunk_progress( conn, blk_num );
+            sync_master->recv_block( conn, blk_id, blk_num );
+            apply_deferred_blocks();
+         }
+         return true;
+      }
+      return false;
+   }
+
+   void net_plugin_impl::handle_received_messages(const connection_ptr& conn, vector<received_message>& msgs) {
+      msg_handler m( *this, conn );
+      for( auto& rm : msgs ) {
+         if( !conn->socket->is_open() ) {
+            return;
+         }
+         if( rm.block ) {
+            if( !is_known_block( conn, rm.block_id ) ) {
+               handle_message( conn, rm.block, rm.block_id );
+            }
+         } else if( rm.trx ) {
+            handle_message( conn, rm.trx );
+         } else if( rm.known_trx ) {
+            // the peer has it, never send it back
+            conn->trx_filter.insert( rm.known_trx->first, rm.known_trx->second );
+         } else if( rm.msg ) {
+            rm.msg->visit( m );
+         }
+      }
+   }
+
    size_t net_plugin_impl::count_open_sockets() const
    {
       size_t count = 0;
@@ -2239,7 +2996,34 @@ namespace eosio {
    void net_plugin_impl::send_transaction_to_all(const std::shared_ptr<std::vector<char>>& send_buffer, VerifierFunc verify) {
       for( auto &c : connections) {
          if( c->current() && verify( c )) {
-            c->enqueue_buffer( send_buffer, true, no_reason );
+            if( c->batch_transactions() ) {
+               c->enqueue_batched_transaction( send_buffer );
+            } else {
+               c->enqueue_buffer( send_buffer, true, no_reason );
+            }
+         }
+      }
+   }
+
+   void net_plugin_impl::start_trx_batch_timer() {
+      if( trx_batch_timer_active )
+         return;
+      trx_batch_timer_active = true;
+      trx_batch_timer->expires_from_now( std::chrono::microseconds( trx_batch_window.count() ) );
+      trx_batch_timer->async_wait( [this]( boost::system::error_code ec ) {
+         app().post( priority::medium, [this, ec]() {
+            trx_batch_timer_active = false;
+            if( !ec ) {
+               flush_trx_batches();
+            }
+         } );
+      } );
+   }
+
+   void net_plugin_impl::flush_trx_batches() {
+      for( auto& c : connections ) {
+         if( c->current() ) {
+            c->flush_trx_batch();
          }
       }
    }
@@ -2376,6 +3160,10 @@ namespace eosio {
       }
 
       c->last_handshake_recv = msg;
+      {
+         std::lock_guard<std::mutex> g( c->name_mtx );
+         c->handshake_p2p_address = msg.p2p_address;
+      }
       c->_logger_variant.reset();
       sync_master->recv_handshake(c,msg);
    }
@@ -2417,6 +3205,13 @@ namespace eosio {
       c->offset = (double(c->rec - c->org) + double(msg.xmt - c->dst)) / 2;
       double NsecPerUsec{1000};
 
+      // round trip excludes the time the peer held our time_message
+      const double rtt = double(msg.dst - msg.org) - double(msg.xmt - msg.rec);
+      if( rtt >= 0 ) {
+         const int64_t rtt_us = rtt / NsecPerUsec;
+         c->stats.rtt_us = c->stats.rtt_us < 0 ? rtt_us : (c->stats.rtt_us * 7 + rtt_us * 3) / 10;
+      }
+
       if(logger.is_enabled(fc::log_level::all))
          logger.log(FC_LOG_MESSAGE(all, "Clock offset is ${o}ns (${us}us)", ("o", c->offset)("us", c->offset/NsecPerUsec)));
       c->org = 0;
@@ -2449,9 +3244,10 @@ namespace eosio {
             send_req = true;
             size_t known_sum = local_txns.size();
             if( known_sum ) {
-               for( const auto& t : local_txns.get<by_id>() ) {
+               req.req_trx.ids.reserve( known_sum );
+               local_txns.for_each( [&]( const node_transaction_state& t ) {
                   req.req_trx.ids.push_back( t.id );
-               }
+               } );
             }
          }
          break;
@@ -2526,6 +3322,16 @@ namespace eosio {
 
    }
 
+   void net_plugin_impl::handle_message(const connection_ptr& c, const compressed_message& msg) {
+      // compressed messages are expanded when unpacked on the net thread pool
+      fc_elog( logger, "unexpected compressed_message from ${p}", ("p", c->peer_name()) );
+   }
+
+   void net_plugin_impl::handle_message(const connection_ptr& c, const packed_transaction_batch& msg) {
+      // batches are split into transactions when unpacked on the net thread pool
+      fc_elog( logger, "unexpected packed_transaction_batch from ${p}", ("p", c->peer_name()) );
+   }
+
    void net_plugin_impl::handle_message(const connection_ptr& c, const sync_request_message& msg) {
       if( msg.end_block == 0) {
          c->peer_requested.reset();
@@ -2544,6 +3350,10 @@ namespace eosio {
    }
 
    void net_plugin_impl::handle_message(const connection_ptr& c, const packed_transaction_ptr& trx) {
+      handle_message( c, std::make_shared<transaction_metadata>( trx ) );
+   }
+
+   void net_plugin_impl::handle_message(const connection_ptr& c, const transaction_metadata_ptr& ptrx) {
       fc_dlog(logger, "got a packed transaction, cancel wait");
       peer_ilog(c, "received packed_transaction");
       controller& cc = my_impl->chain_plug->chain();
@@ -2556,7 +3366,6 @@ namespace eosio {
          return;
       }
 
-      auto ptrx = std::make_shared<transaction_metadata>( trx );
       const auto& tid = ptrx->id;
 
       if( c->trx_in_progress_size > def_max_trx_in_progress_size ) {
@@ -2565,7 +3374,10 @@ namespace eosio {
          return;
       }
 
-      if(local_txns.get<by_id>().find(tid) != local_txns.end()) {
+      // the peer has it, never send it back
+      c->trx_filter.insert( tid, ptrx->packed_trx->expiration() );
+
+      if( local_txns.contains(tid) ) {
          fc_dlog(logger, "got a duplicate transaction - dropping");
          return;
       }
@@ -2591,12 +3403,34 @@ namespace eosio {
    }
 
    void net_plugin_impl::handle_message(const connection_ptr& c, const signed_block_ptr& msg) {
-      controller &cc = chain_plug->chain();
-      block_id_type blk_id = msg->id();
+      handle_message( c, msg, msg->id() );
+   }
+
+   void net_plugin_impl::handle_message(const connection_ptr& c, const signed_block_ptr& msg, const block_id_type& blk_id) {
       uint32_t blk_num = msg->block_num();
       fc_dlog(logger, "canceling wait on ${p}", ("p",c->peer_name()));
       c->cancel_wait();
 
+      sync_master->chunk_progress( c, blk_num );
+      if( sync_master->defer_block( c, msg, blk_id, blk_num ) ) {
+         return;
+      }
+      accept_block( c, msg, blk_id );
+      apply_deferred_blocks();
+   }
+
+   void net_plugin_impl::apply_deferred_blocks() {
+      // blocks received from other peers ahead of the last applied block can now be applied in order
+      while( auto ready = sync_master->pop_ready_block() ) {
+         ready->source->cancel_wait();
+         accept_block( ready->source, ready->block, ready->id );
+      }
+   }
+
+   void net_plugin_impl::accept_block(const connection_ptr& c, const signed_block_ptr& msg, const block_id_type& blk_id) {
+      controller &cc = chain_plug->chain();
+      uint32_t blk_num = msg->block_num();
+
       try {
          if( cc.fetch_block_by_id(blk_id)) {
             if( sync_master->syncing_with_peer() )
@@ -2636,22 +3470,19 @@ namespace eosio {
          fc_elog( logger, "handle sync block caught something else from ${p}",("num",blk_num)("p",c->peer_name()));
       }
 
-      update_block_num ubn(blk_num);
       if( reason == no_reason ) {
-         for (const auto &recpt : msg->transactions) {
-            auto id = (recpt.trx.which() == 0) ? recpt.trx.get<transaction_id_type>() : recpt.trx.get<packed_transaction>().id();
-            auto ltx = local_txns.get<by_id>().find(id);
-            if( ltx != local_txns.end()) {
-               local_txns.modify( ltx, ubn );
-            }
-            auto ctx = c->trx_state.get<by_id>().find(id);
-            if( ctx != c->trx_state.end()) {
-               c->trx_state.modify( ctx, ubn );
+         {
+            std::lock_guard<std::mutex> g( local_txns_mtx );
+            for (const auto &recpt : msg->transactions) {
+               auto id = (recpt.trx.which() == 0) ? recpt.trx.get<transaction_id_type>() : recpt.trx.get<packed_transaction>().id();
+               local_txns.set_block_num( id, blk_num );
             }
          }
+         ++c->stats.blocks_received;
          sync_master->recv_block(c, blk_id, blk_num);
       }
       else {
+         ++c->stats.blocks_rejected;
          sync_master->rejected_block(c, blk_num);
          dispatcher->rejected_block( blk_id );
       }
@@ -2707,6 +3538,7 @@ namespace eosio {
    void net_plugin_impl::start_monitors() {
       connector_check.reset(new boost::asio::steady_timer( my_impl->thread_pool->get_executor() ));
       transaction_check.reset(new boost::asio::steady_timer( my_impl->thread_pool->get_executor() ));
+      trx_batch_timer.reset(new boost::asio::steady_timer( my_impl->thread_pool->get_executor() ));
       start_conn_timer(connector_period, std::weak_ptr<connection>());
       start_txn_timer();
    }
@@ -2722,11 +3554,9 @@ namespace eosio {
       controller& cc = chain_plug->chain();
       uint32_t lib = cc.last_irreversible_block_num();
       dispatcher->expire_blocks( lib );
+      const time_point_sec now_sec( time_point::now() );
       for ( auto &c : connections ) {
-         auto &stale_txn = c->trx_state.get<by_block_num>();
-         stale_txn.erase( stale_txn.lower_bound(1), stale_txn.upper_bound(lib) );
-         auto &stale_txn_e = c->trx_state.get<by_expiry>();
-         stale_txn_e.erase(stale_txn_e.lower_bound(time_point_sec()), stale_txn_e.upper_bound(time_point::now()));
+         c->trx_filter.expire( now_sec );
          auto &stale_blk = c->blk_state.get<by_block_num>();
          stale_blk.erase( stale_blk.lower_bound(1), stale_blk.upper_bound(lib) );
       }
@@ -2735,15 +3565,10 @@ namespace eosio {
    }
 
    void net_plugin_impl::expire_local_txns() {
-      auto& old = local_txns.get<by_expiry>();
-      auto ex_lo = old.lower_bound( fc::time_point_sec(0) );
-      auto ex_up = old.upper_bound( time_point::now() );
-      old.erase( ex_lo, ex_up );
-
-      auto& stale = local_txns.get<by_block_num>();
       controller& cc = chain_plug->chain();
       uint32_t lib = cc.last_irreversible_block_num();
-      stale.erase( stale.lower_bound(1), stale.upper_bound(lib) );
+      std::lock_guard<std::mutex> g( local_txns_mtx );
+      local_txns.expire( time_point_sec( time_point::now() ), lib );
    }
 
    void net_plugin_impl::connection_monitor(std::weak_ptr<connection> from_connection) {
@@ -2785,6 +3610,7 @@ namespace eosio {
 
    void net_plugin_impl::accepted_block(const block_state_ptr& block) {
       fc_dlog(logger,"signaled, id = ${id}",("id", block->id));
+      max_trx_cpu_usage = chain_plug->chain().get_global_properties().configuration.max_transaction_cpu_usage;
       dispatcher->bcast_block(block);
    }
 
@@ -2926,6 +3752,7 @@ namespace eosio {
    net_plugin::net_plugin()
       :my( new net_plugin_impl ) {
       my_impl = my.get();
+      my->buffer_pool = std::make_shared<send_buffer_pool>();
    }
 
    net_plugin::~net_plugin() {
@@ -2950,8 +3777,21 @@ namespace eosio {
            "DEPRECATED, needless restriction. True to require exact match of peer network version.")
          ( "net-threads", bpo::value<uint16_t>()->default_value(my->thread_pool_size),
            "Number of worker threads in net_plugin thread pool" )
+         ( "p2p-key-recovery-threads", bpo::value<uint16_t>()->default_value(my->key_recovery_pool_size),
+           "Number of worker threads recovering the signature keys of transactions received from peers" )
          ( "sync-fetch-span", bpo::value<uint32_t>()->default_value(def_sync_fetch_span), "number of blocks to retrieve in a chunk from any individual peer during synchronization")
+         ( "sync-fetch-peers", bpo::value<uint32_t>()->default_value(def_sync_fetch_peers), "maximum number of peers to request chunks from at the same time during synchronization")
          ( "use-socket-read-watermark", bpo::value<bool>()->default_value(false), "Enable expirimental socket read watermark optimization")
+         ( "p2p-compression", bpo::value<string>()->default_value("zlib"),
+           "Compression of blocks sent to peers that support it, 'zlib' or 'none'. Compressed messages are always accepted.")
+         ( "p2p-compression-min-size", bpo::value<uint32_t>()->default_value(def_compression_min_size),
+           "Minimum size in bytes of a broadcast block before it is compressed")
+         ( "p2p-trx-batch-window-us", bpo::value<uint32_t>()->default_value(def_trx_batch_window_us),
+           "Microseconds relayed transactions may wait to be sent together to peers that support transaction batches")
+         ( "p2p-trx-batch-max-count", bpo::value<uint32_t>()->default_value(def_trx_batch_max_count),
+           "Maximum number of transactions in one batch sent to a peer, 0 or 1 to disable batching")
+         ( "p2p-trx-batch-max-bytes", bpo::value<uint32_t>()->default_value(def_trx_batch_max_bytes),
+           "Maximum size in bytes of one transaction batch sent to a peer")
          ( "peer-log-format", bpo::value<string>()->default_value( "[\"${_name}\" ${_ip}:${_port}]" ),
            "The string used to format peers when logging messages about them.  Variables are escaped with ${<variable name>}.\n"
            "Available Variables:\n"
@@ -2979,7 +3819,10 @@ namespace eosio {
          if( my->network_version_match )
             wlog( "network-version-match is DEPRECATED as it is a needless restriction" );
 
-         my->sync_master.reset( new sync_manager( options.at( "sync-fetch-span" ).as<uint32_t>()));
+         const auto sync_fetch_peers = options.at( "sync-fetch-peers" ).as<uint32_t>();
+         EOS_ASSERT( sync_fetch_peers > 0, chain::plugin_config_exception,
+                     "sync-fetch-peers ${num} must be greater than 0", ("num", sync_fetch_peers) );
+         my->sync_master.reset( new sync_manager( options.at( "sync-fetch-span" ).as<uint32_t>(), sync_fetch_peers ));
          my->dispatcher.reset( new dispatch_manager );
 
          my->connector_period = std::chrono::seconds( options.at( "connection-cleanup-period" ).as<int>());
@@ -3000,9 +3843,29 @@ namespace eosio {
             my->p2p_server_address = options.at( "p2p-server-address" ).as<string>();
          }
 
+         const auto& compression = options.at( "p2p-compression" ).as<string>();
+         if( compression == "none" ) {
+            my->compression = message_compression::none;
+         } else {
+            EOS_ASSERT( compression == "zlib", chain::plugin_config_exception,
+                        "p2p-compression ${c} must be 'zlib' or 'none'", ("c", compression) );
+            my->compression = message_compression::zlib;
+         }
+         my->compression_min_size = options.at( "p2p-compression-min-size" ).as<uint32_t>();
+         my->trx_batch_window = fc::microseconds( options.at( "p2p-trx-batch-window-us" ).as<uint32_t>() );
+         my->trx_batch_max_count = options.at( "p2p-trx-batch-max-count" ).as<uint32_t>();
+         my->trx_batch_max_bytes = options.at( "p2p-trx-batch-max-bytes" ).as<uint32_t>();
+         EOS_ASSERT( my->trx_batch_max_count <= def_trx_batch_max_count * 10, chain::plugin_config_exception,
+                     "p2p-trx-batch-max-count ${n} must not exceed ${m}", ("n", my->trx_batch_max_count)("m", def_trx_batch_max_count * 10) );
+         EOS_ASSERT( my->trx_batch_max_bytes <= def_send_buffer_size, chain::plugin_config_exception,
+                     "p2p-trx-batch-max-bytes ${n} must not exceed ${m}", ("n", my->trx_batch_max_bytes)("m", def_send_buffer_size) );
+
          my->thread_pool_size = options.at( "net-threads" ).as<uint16_t>();
          EOS_ASSERT( my->thread_pool_size > 0, chain::plugin_config_exception,
                      "net-threads ${num} must be greater than 0", ("num", my->thread_pool_size) );
+         my->key_recovery_pool_size = options.at( "p2p-key-recovery-threads" ).as<uint16_t>();
+         EOS_ASSERT( my->key_recovery_pool_size > 0, chain::plugin_config_exception,
+                     "p2p-key-recovery-threads ${num} must be greater than 0", ("num", my->key_recovery_pool_size) );
 
          if( options.count( "p2p-peer-address" )) {
             my->supplied_peers = options.at( "p2p-peer-address" ).as<vector<string> >();
@@ -3062,6 +3925,8 @@ namespace eosio {
 
       // currently thread_pool only used for server_ioc
       my->thread_pool.emplace( "net", my->thread_pool_size );
+      my->key_recovery_pool.emplace( "netkeys", my->key_recovery_pool_size );
+      my->compress_strand.emplace( my->thread_pool->get_executor() );
 
       shared_ptr<tcp::resolver> resolver = std::make_shared<tcp::resolver>( my_impl->thread_pool->get_executor() );
       if( my->p2p_address.size() > 0 ) {
@@ -3109,6 +3974,7 @@ namespace eosio {
       {
          cc.accepted_block.connect(  boost::bind(&net_plugin_impl::accepted_block, my.get(), _1));
       }
+      my->max_trx_cpu_usage = cc.get_global_properties().configuration.max_transaction_cpu_usage;
 
       my->keepalive_timer.reset( new boost::asio::steady_timer( my->thread_pool->get_executor() ) );
       my->ticker();
@@ -3146,6 +4012,8 @@ namespace eosio {
             my->transaction_check->cancel();
          if( my->keepalive_timer )
             my->keepalive_timer->cancel();
+         if( my->trx_batch_timer )
+            my->trx_batch_timer->cancel();
 
          my->done = true;
          if( my->acceptor ) {
@@ -3165,6 +4033,9 @@ namespace eosio {
          if( my->thread_pool ) {
             my->thread_pool->stop();
          }
+         if( my->key_recovery_pool ) {
+            my->key_recovery_pool->stop();
+         }
 
          app().post( 0, [me = my](){} ); // keep my pointer alive until queue is drained
 
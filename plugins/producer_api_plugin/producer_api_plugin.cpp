@@ -143,6 +143,12 @@ namespace eosio {
                                                              INVOKE_R_R(producer, get_account_ram_corrections,
                                                                         producer_plugin::get_account_ram_corrections_params),
                                                              201),
+                                                        CALL(producer, producer, get_timing,
+                                                             INVOKE_R_R(producer, get_timing,
+                                                                        producer_plugin::get_timing_params),
+                                                             201),
+                                                        CALL(producer, producer, get_timing_prometheus,
+                                                             INVOKE_R_V(producer, get_timing_prometheus), 201),
                                                 });
     }
 
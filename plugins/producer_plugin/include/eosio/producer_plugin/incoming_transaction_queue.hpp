@@ -0,0 +1,212 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+
+#pragma once
+
+#include <eosio/chain/transaction_metadata.hpp>
+#include <eosio/chain/trace.hpp>
+#include <eosio/chain/contract_types.hpp>
+
+#include <fc/static_variant.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace eosio {
+
+/**
+ * Incoming transactions waiting for a pending block.
+ *
+ * Ordered by the fee the transaction will be charged, then by how many transactions the same account already had
+ * queued (so accounts paying the same fee are interleaved), then by arrival. The fee of each known fee-bearing FIO
+ * action is its max_fee capped at the fee schedule for its endpoint, so declaring a max_fee above the schedule does
+ * not move a transaction ahead. Once the oldest transaction has waited longer than max_age, aged and priority pops
+ * alternate so that low fee transactions are not starved and high fee ones still go first under saturation.
+ * The estimated memory held by the queue is bounded; when full the lowest priority entries are evicted, or the new
+ * transaction is rejected if it does not outrank them.
+ */
+class incoming_transaction_queue {
+public:
+   using next_t = std::function<void(const fc::static_variant<fc::exception_ptr, chain::transaction_trace_ptr>&)>;
+   /// scheduled fee of a fee schedule end point, empty when the end point has no fee
+   using fee_lookup_t = std::function<fc::optional<uint64_t>(const std::string& end_point)>;
+
+   struct entry {
+      chain::transaction_metadata_ptr trx;
+      bool                            persist_until_expired = false;
+      next_t                          next;
+      uint64_t                        fee = 0;
+      chain::account_name             account;
+      uint32_t                        account_rank = 0;
+      uint64_t                        seq = 0;
+      fc::time_point                  received;
+      size_t                          size = 0;
+   };
+
+   void set_limits( size_t max_bytes, const fc::microseconds& max_age ) {
+      _max_bytes = max_bytes;
+      _max_age = max_age;
+   }
+
+   /// without a fee lookup no transaction is prioritized by fee
+   void set_fee_lookup( fee_lookup_t lookup ) { _fee_lookup = std::move( lookup ); }
+
+   bool   empty() const { return _queue.empty(); }
+   size_t size() const { return _queue.size(); }
+   size_t bytes_size() const { return _bytes; }
+
+   /// @return entries evicted to make room, including the new one if it was not queued
+   std::vector<entry> push( const chain::transaction_metadata_ptr& trx, bool persist_until_expired, next_t next,
+                            const fc::time_point& now ) {
+      const auto& t = trx->packed_trx->get_transaction();
+      entry e;
+      e.trx = trx;
+      e.persist_until_expired = persist_until_expired;
+      e.next = std::move( next );
+      e.fee = priority_fee( t, _fee_lookup );
+      e.account = fee_payer( t );
+      auto itr = _account_counts.find( e.account );
+      e.account_rank = itr != _account_counts.end() ? itr->second : 0;
+      e.seq = _next_seq++;
+      e.received = now;
+      // packed and unpacked copies are both held by the metadata
+      e.size = sizeof(entry) + sizeof(chain::transaction_metadata) +
+               2 * (trx->packed_trx->get_unprunable_size() + trx->packed_trx->get_prunable_size());
+
+      std::vector<entry> evicted;
+      auto& prio_idx = _queue.get<by_priority>();
+      while( _bytes + e.size > _max_bytes && !prio_idx.empty() ) {
+         auto lowest = std::prev( prio_idx.end() );
+         if( !outranks( e, *lowest ) ) break;
+         evicted.push_back( *lowest );
+         erase( prio_idx, lowest );
+      }
+      if( _bytes + e.size > _max_bytes && !_queue.empty() ) {
+         evicted.emplace_back( std::move( e ) );
+         return evicted;
+      }
+
+      ++_account_counts[e.account];
+      _bytes += e.size;
+      _queue.insert( std::move( e ) );
+      return evicted;
+   }
+
+   /// queue must not be empty
+   entry pop( const fc::time_point& now ) {
+      auto& arrival_idx = _queue.get<by_arrival>();
+      auto oldest = arrival_idx.begin();
+      if( !_last_pop_aged && _max_age > fc::microseconds() && oldest->received + _max_age <= now ) {
+         _last_pop_aged = true;
+         entry e = *oldest;
+         erase( arrival_idx, oldest );
+         return e;
+      }
+      _last_pop_aged = false;
+      auto& prio_idx = _queue.get<by_priority>();
+      auto highest = prio_idx.begin();
+      entry e = *highest;
+      erase( prio_idx, highest );
+      return e;
+   }
+
+   /// sum over the known fee-bearing FIO actions of max_fee capped at the scheduled fee of the action's end point
+   static uint64_t priority_fee( const chain::transaction& trx, const fee_lookup_t& lookup ) {
+      uint64_t fee = 0;
+      if( !lookup ) return fee;
+      for( const auto& act : trx.actions ) {
+         try {
+            add_fee<chain::trnsfiopubky>( act, "transfer_tokens_pub_key", lookup, fee ) ||
+            add_fee<chain::regaddress>( act, "register_fio_address", lookup, fee ) ||
+            add_fee<chain::regdomain>( act, "register_fio_domain", lookup, fee ) ||
+            add_fee<chain::regdomadd>( act, "register_fio_domain_address", lookup, fee ) ||
+            add_fee<chain::newfioacc>( act, "new_fio_chain_account", lookup, fee ) ||
+            add_fee<chain::trnsloctoks>( act, "transfer_locked_tokens", lookup, fee ) ||
+            add_fee<chain::xferaddress>( act, "transfer_fio_address", lookup, fee ) ||
+            add_fee<chain::xferdomain>( act, "transfer_fio_domain", lookup, fee ) ||
+            add_fee<chain::burnaddress>( act, "burn_fio_address", lookup, fee ) ||
+            add_fee<chain::updateauth>( act, "auth_update", lookup, fee ) ||
+            add_fee<chain::deleteauth>( act, "auth_delete", lookup, fee ) ||
+            add_fee<chain::linkauth>( act, "auth_link", lookup, fee );
+         } catch( ... ) {
+            // malformed action data is rejected when the transaction is applied
+         }
+      }
+      return fee;
+   }
+
+   static chain::account_name fee_payer( const chain::transaction& trx ) {
+      if( trx.actions.empty() ) return chain::account_name();
+      const auto& act = trx.actions.front();
+      return act.authorization.empty() ? act.account : act.authorization.front().actor;
+   }
+
+private:
+   struct by_priority;
+   struct by_arrival;
+
+   using entry_index = boost::multi_index_container<
+      entry,
+      boost::multi_index::indexed_by<
+         boost::multi_index::ordered_unique<boost::multi_index::tag<by_priority>,
+            boost::multi_index::composite_key<entry,
+               boost::multi_index::member<entry, uint64_t, &entry::fee>,
+               boost::multi_index::member<entry, uint32_t, &entry::account_rank>,
+               boost::multi_index::member<entry, uint64_t, &entry::seq>
+            >,
+            boost::multi_index::composite_key_compare< std::greater<uint64_t>, std::less<uint32_t>, std::less<uint64_t> >
+         >,
+         boost::multi_index::ordered_unique<boost::multi_index::tag<by_arrival>,
+            boost::multi_index::member<entry, uint64_t, &entry::seq>
+         >
+      >
+   >;
+
+   template<typename T>
+   static bool add_fee( const chain::action& act, const char* end_point, const fee_lookup_t& lookup, uint64_t& fee ) {
+      if( act.account != T::get_account() || act.name != T::get_name() ) return false;
+      const auto max_fee = fc::raw::unpack<T>( act.data ).max_fee;
+      if( max_fee <= 0 ) return true;
+      const auto scheduled = lookup( end_point );
+      if( !scheduled ) return true;
+      const uint64_t charged = std::min( static_cast<uint64_t>( max_fee ), *scheduled );
+      // saturate, a wrapped sum would rank the transaction lowest instead of highest
+      fee = fee > std::numeric_limits<uint64_t>::max() - charged ? std::numeric_limits<uint64_t>::max() : fee + charged;
+      return true;
+   }
+
+   static bool outranks( const entry& lhs, const entry& rhs ) {
+      return lhs.fee > rhs.fee || (lhs.fee == rhs.fee && lhs.account_rank < rhs.account_rank);
+   }
+
+   template<typename Index, typename Itr>
+   void erase( Index& idx, Itr itr ) {
+      auto count_itr = _account_counts.find( itr->account );
+      if( count_itr != _account_counts.end() && --count_itr->second == 0 )
+         _account_counts.erase( count_itr );
+      _bytes -= itr->size;
+      idx.erase( itr );
+   }
+
+   entry_index                                       _queue;
+   std::unordered_map<chain::account_name, uint32_t> _account_counts;
+   fee_lookup_t                                      _fee_lookup;
+   size_t                                            _bytes = 0;
+   size_t                                            _max_bytes = std::numeric_limits<size_t>::max();
+   fc::microseconds                                  _max_age;
+   uint64_t                                          _next_seq = 0;
+   bool                                              _last_pop_aged = false;
+};
+
+} // namespace eosio
@@ -73,6 +73,46 @@ public:
       optional<account_name>   more;
    };
 
+   struct timing_bucket {
+      uint64_t upper_us = 0; ///< exclusive upper bound
+      uint64_t count = 0;
+   };
+
+   struct timing_histogram {
+      std::string                phase;
+      uint64_t                   count = 0;
+      uint64_t                   sum_us = 0;
+      uint64_t                   min_us = 0;
+      uint64_t                   max_us = 0;
+      uint64_t                   p50_us = 0;
+      uint64_t                   p90_us = 0;
+      uint64_t                   p99_us = 0;
+      uint64_t                   p999_us = 0;
+      std::vector<timing_bucket> buckets; ///< non-empty buckets only
+   };
+
+   struct unapplied_transaction_stats {
+      uint64_t slices = 0;
+      uint64_t processed = 0;
+      uint64_t applied = 0;
+      uint64_t failed = 0;
+      uint64_t expired = 0;
+      uint64_t elapsed_us = 0;
+   };
+
+   struct get_timing_params {
+      bool reset = false;
+   };
+
+   struct timing_result {
+      std::vector<timing_histogram> histograms;
+      unapplied_transaction_stats   unapplied;
+   };
+
+   struct timing_prometheus_result {
+      std::string metrics; ///< prometheus text exposition format
+   };
+
    template<typename T>
    using next_function = std::function<void(const fc::static_variant<fc::exception_ptr, T>&)>;
 
@@ -114,6 +154,9 @@ public:
    fc::variants get_supported_protocol_features( const get_supported_protocol_features_params& params ) const;
 
    get_account_ram_corrections_result  get_account_ram_corrections( const get_account_ram_corrections_params& params ) const;
+
+   timing_result get_timing( const get_timing_params& params );
+   timing_prometheus_result get_timing_prometheus() const;
    
 private:
    std::shared_ptr<class producer_plugin_impl> my;
@@ -130,3 +173,9 @@ FC_REFLECT(eosio::producer_plugin::scheduled_protocol_feature_activations, (prot
 FC_REFLECT(eosio::producer_plugin::get_supported_protocol_features_params, (exclude_disabled)(exclude_unactivatable))
 FC_REFLECT(eosio::producer_plugin::get_account_ram_corrections_params, (lower_bound)(upper_bound)(limit)(reverse))
 FC_REFLECT(eosio::producer_plugin::get_account_ram_corrections_result, (rows)(more))
+FC_REFLECT(eosio::producer_plugin::timing_bucket, (upper_us)(count))
+FC_REFLECT(eosio::producer_plugin::timing_histogram, (phase)(count)(sum_us)(min_us)(max_us)(p50_us)(p90_us)(p99_us)(p999_us)(buckets))
+FC_REFLECT(eosio::producer_plugin::unapplied_transaction_stats, (slices)(processed)(applied)(failed)(expired)(elapsed_us))
+FC_REFLECT(eosio::producer_plugin::get_timing_params, (reset))
+FC_REFLECT(eosio::producer_plugin::timing_result, (histograms)(unapplied))
+FC_REFLECT(eosio::producer_plugin::timing_prometheus_result, (metrics))
@@ -3,12 +3,15 @@
  *  @copyright defined in eos/LICENSE
  */
 #include <eosio/producer_plugin/producer_plugin.hpp>
+#include <eosio/producer_plugin/incoming_transaction_queue.hpp>
 #include <eosio/chain/plugin_interface.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/transaction_object.hpp>
 #include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/fioio/fioserialize.h>
 
 #include <fc/io/json.hpp>
 #include <fc/log/logger_config.hpp>
@@ -20,6 +23,10 @@
 
 #include <iostream>
 #include <algorithm>
+#include <limits>
+#include <array>
+#include <cmath>
+#include <sstream>
 #include <boost/algorithm/string.hpp>
 #include <boost/range/adaptor/map.hpp>
 #include <boost/function_output_iterator.hpp>
@@ -169,6 +176,124 @@ using pending_snapshot_index = multi_index_container<
    >
 >;
 
+enum class timing_phase {
+   start_block,     ///< whole of start_block, includes unapplied, scheduled and incoming run from it
+   unapplied,       ///< each slice re-applying unapplied transactions
+   scheduled,       ///< scheduled transactions interleaved with incoming ones
+   incoming,        ///< queued incoming transactions
+   finalize_block,  ///< finalize_block, includes sign_block
+   sign_block,
+   commit_block,
+   apply_block,     ///< push_block of a received block
+   count
+};
+
+const char* timing_phase_name( timing_phase phase ) {
+   static const char* names[] = { "start_block", "unapplied", "scheduled", "incoming",
+                                  "finalize_block", "sign_block", "commit_block", "apply_block" };
+   static_assert( sizeof(names) / sizeof(names[0]) == static_cast<size_t>(timing_phase::count), "missing timing_phase name" );
+   return names[static_cast<size_t>(phase)];
+}
+
+/**
+ * Log-linear histogram of durations in microseconds, each power of two range is split into 8 linear buckets
+ * so recorded values are within 12.5% of their bucket bound.
+ */
+class phase_histogram {
+public:
+   void record( const fc::microseconds& d ) {
+      const uint64_t us = d.count() > 0 ? static_cast<uint64_t>( d.count() ) : 0;
+      ++_counts[bucket_index( us )];
+      ++_count;
+      _sum += us;
+      _min = std::min( _min, us );
+      _max = std::max( _max, us );
+   }
+
+   void reset() { *this = phase_histogram(); }
+
+   producer_plugin::timing_histogram info( const char* phase ) const {
+      producer_plugin::timing_histogram h;
+      h.phase = phase;
+      h.count = _count;
+      h.sum_us = _sum;
+      h.min_us = _count ? _min : 0;
+      h.max_us = _max;
+      h.p50_us = percentile( 0.5 );
+      h.p90_us = percentile( 0.9 );
+      h.p99_us = percentile( 0.99 );
+      h.p999_us = percentile( 0.999 );
+      for( size_t i = 0; i < num_buckets; ++i ) {
+         if( _counts[i] ) h.buckets.push_back( {bucket_upper_bound( i ), _counts[i]} );
+      }
+      return h;
+   }
+
+   /// cumulative buckets at powers of two from 64us to ~16.7s
+   void prometheus( std::ostream& os, const char* metric, const char* phase ) const {
+      uint64_t cumulative = 0;
+      size_t i = 0;
+      for( uint32_t p = 6; p <= 24; ++p ) {
+         const uint64_t le = uint64_t(1) << p;
+         for( ; i < num_buckets && bucket_upper_bound( i ) <= le; ++i )
+            cumulative += _counts[i];
+         os << metric << "_bucket{phase=\"" << phase << "\",le=\"" << le << "\"} " << cumulative << "\n";
+      }
+      os << metric << "_bucket{phase=\"" << phase << "\",le=\"+Inf\"} " << _count << "\n";
+      os << metric << "_sum{phase=\"" << phase << "\"} " << _sum << "\n";
+      os << metric << "_count{phase=\"" << phase << "\"} " << _count << "\n";
+   }
+
+private:
+   static constexpr uint32_t sub_bucket_bits = 3;
+   static constexpr uint32_t sub_buckets = 1 << sub_bucket_bits;
+   static constexpr uint32_t max_power = 36; // ~19 hours
+   static constexpr size_t   num_buckets = (max_power - sub_bucket_bits + 2) * sub_buckets;
+
+   static size_t bucket_index( uint64_t us ) {
+      if( us < sub_buckets ) return us;
+      uint32_t power = 63 - __builtin_clzll( us );
+      if( power > max_power ) return num_buckets - 1;
+      const uint64_t sub = (us >> (power - sub_bucket_bits)) & (sub_buckets - 1);
+      return (power - sub_bucket_bits + 1) * sub_buckets + sub;
+   }
+
+   static uint64_t bucket_upper_bound( size_t i ) {
+      if( i < sub_buckets ) return i + 1;
+      const uint32_t power = i / sub_buckets + sub_bucket_bits - 1;
+      const uint64_t sub = i % sub_buckets;
+      return (sub_buckets + sub + 1) << (power - sub_bucket_bits);
+   }
+
+   uint64_t percentile( double q ) const {
+      if( !_count ) return 0;
+      const uint64_t rank = std::max<uint64_t>( 1, static_cast<uint64_t>( std::ceil( q * _count ) ) );
+      uint64_t seen = 0;
+      for( size_t i = 0; i < num_buckets; ++i ) {
+         seen += _counts[i];
+         if( seen >= rank ) return std::min( bucket_upper_bound( i ), _max );
+      }
+      return _max;
+   }
+
+   std::array<uint64_t, num_buckets> _counts{};
+   uint64_t _count = 0;
+   uint64_t _sum = 0;
+   uint64_t _min = std::numeric_limits<uint64_t>::max();
+   uint64_t _max = 0;
+};
+
+/// records the time until it goes out of scope
+struct phase_timer {
+   explicit phase_timer( phase_histogram& h ) : histogram( h ), start( fc::time_point::now() ) {}
+   phase_timer( const phase_timer& ) = delete;
+   phase_timer& operator=( const phase_timer& ) = delete;
+   ~phase_timer() { histogram.record( fc::time_point::now() - start ); }
+
+   phase_histogram& histogram;
+   fc::time_point   start;
+};
+
 enum class pending_block_mode {
    producing,
    speculating
@@ -205,6 +330,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       bool remove_expired_persisted_trxs( const fc::time_point& deadline );
       bool remove_expired_blacklisted_trxs( const fc::time_point& deadline );
       bool process_unapplied_trxs( const fc::time_point& deadline );
+      void schedule_unapplied_trxs_continuation();
       bool process_scheduled_and_incoming_trxs( const fc::time_point& deadline, size_t& orig_pending_txn_size );
       bool process_incoming_trxs( const fc::time_point& deadline, size_t& orig_pending_txn_size );
 
@@ -266,6 +392,28 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       // keep a expected ratio between defer txn and incoming txn
       double _incoming_defer_ratio = 1.0; // 1:1
 
+      // unapplied transactions are re-executed in slices of at most this long, interleaved with incoming transactions
+      int32_t _max_unapplied_transaction_time_per_slice_ms = 20;
+      // incremented for every pending block, a continuation for an older pending block does nothing
+      uint32_t _unapplied_corelation_id = 0;
+
+      producer_plugin::unapplied_transaction_stats _unapplied_stats;
+
+      std::array<phase_histogram, static_cast<size_t>(timing_phase::count)> _phase_histograms;
+
+      phase_timer time_phase( timing_phase phase ) {
+         return phase_timer( _phase_histograms[static_cast<size_t>(phase)] );
+      }
+
+      // tables accessed by the transactions of the pending block, only recorded with experimental-table-conflict-stats
+      bool _table_conflict_stats = false;
+      std::vector<table_access_set> _pending_block_table_access;
+
+      void record_table_access(const transaction_trace_ptr& trace) {
+         if (_table_conflict_stats && trace && trace->table_access)
+            _pending_block_table_access.emplace_back(std::move(*trace->table_access));
+      }
+
       // path to write the snapshots to
       bfs::path _snapshots_dir;
 
@@ -379,6 +527,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
          // push the new block
          try {
+            auto timing = time_phase( timing_phase::apply_block );
             chain.push_block( bsf );
          } catch ( const guard_exception& e ) {
             chain_plugin::handle_guard_exception(e);
@@ -412,16 +561,53 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          }
       }
 
-      std::deque<std::tuple<transaction_metadata_ptr, bool, next_function<transaction_trace_ptr>>> _pending_incoming_transactions;
+      incoming_transaction_queue _pending_incoming_transactions;
+
+      /// suf_amount of the fio.fee fiofees row for end_point, read from the pending state
+      fc::optional<uint64_t> scheduled_fee( const std::string& end_point ) const {
+         const auto& db = chain_plug->chain().db();
+         const auto* t_id = db.find<table_id_object, by_code_scope_table>(
+               boost::make_tuple( N(fio.fee), N(fio.fee), N(fiofees) ) );
+         if( t_id == nullptr ) return {};
+         // end_point_hash is the first secondary index, which shares the table id of the primary
+         const uint128_t hash = fioio::string_to_uint128_t( end_point.c_str() );
+         const auto& sec_idx = db.get_index<index128_index, by_secondary>();
+         auto itr = sec_idx.lower_bound( boost::make_tuple( t_id->id, hash ) );
+         if( itr == sec_idx.end() || itr->t_id != t_id->id || itr->secondary_key != hash ) return {};
+         const auto* row = db.find<key_value_object, by_scope_primary>( boost::make_tuple( t_id->id, itr->primary_key ) );
+         if( row == nullptr ) return {};
+         // fiofee starts with fee_id, end_point, end_point_hash, type, suf_amount
+         fc::datastream<const char*> ds( row->value.data(), row->value.size() );
+         uint64_t fee_id = 0, type = 0, suf_amount = 0;
+         std::string row_end_point;
+         fc::raw::unpack( ds, fee_id );
+         fc::raw::unpack( ds, row_end_point );
+         ds.skip( sizeof(uint128_t) );
+         fc::raw::unpack( ds, type );
+         fc::raw::unpack( ds, suf_amount );
+         return suf_amount;
+      }
+
+      void queue_incoming_transaction(const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
+         auto evicted = _pending_incoming_transactions.push( trx, persist_until_expired, std::move(next),
+                                                                    fc::time_point::now() );
+         for( auto& e : evicted ) {
+            fc_dlog(_trx_trace_log, "[TRX_TRACE] Incoming transaction queue full, DROPPING tx: ${txid} fee: ${fee}",
+                    ("txid", e.trx->id)("fee", e.fee));
+            auto except_ptr = std::static_pointer_cast<fc::exception>( std::make_shared<resource_exhausted_exception>(
+                  FC_LOG_MESSAGE( error, "incoming transaction queue full, dropped transaction ${id}", ("id", e.trx->id) ) ) );
+            e.next( except_ptr );
+            _transaction_ack_channel.publish( priority::low, std::pair<fc::exception_ptr, transaction_metadata_ptr>( except_ptr, e.trx ) );
+         }
+      }
 
       void on_incoming_transaction_async(const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
          chain::controller& chain = chain_plug->chain();
          const auto& cfg = chain.get_global_properties().configuration;
-         signing_keys_future_type future = transaction_metadata::start_recover_keys( trx, _thread_pool->get_executor(),
+         transaction_metadata::start_recover_keys( trx, _thread_pool->get_executor(),
                chain.get_chain_id(), fc::microseconds( cfg.max_transaction_cpu_usage ) );
-         boost::asio::post( _thread_pool->get_executor(), [self = this, future, trx, persist_until_expired, next]() {
-            if( future.valid() )
-               future.wait();
+         // queued for the main thread in the order recovery completes, no pool thread blocks waiting on the keys
+         transaction_metadata::on_keys_recovered( trx, [self = this, persist_until_expired, next]( const transaction_metadata_ptr& trx ) {
             app().post(priority::low, [self, trx, persist_until_expired, next]() {
                self->process_incoming_transaction_async( trx, persist_until_expired, next );
             });
@@ -431,7 +617,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       void process_incoming_transaction_async(const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
          chain::controller& chain = chain_plug->chain();
          if (!chain.is_building_block()) {
-            _pending_incoming_transactions.emplace_back(trx, persist_until_expired, next);
+            queue_incoming_transaction(trx, persist_until_expired, next);
             return;
          }
 
@@ -489,7 +675,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
             auto trace = chain.push_transaction(trx, deadline);
             if (trace->except) {
                if (failure_is_subjective(*trace->except, deadline_is_subjective)) {
-                  _pending_incoming_transactions.emplace_back(trx, persist_until_expired, next);
+                  queue_incoming_transaction(trx, persist_until_expired, next);
                   if (_pending_block_mode == pending_block_mode::producing) {
                      fc_dlog(_trx_trace_log, "[TRX_TRACE] Block ${block_num} for producer ${prod} COULD NOT FIT, tx: ${txid} RETRYING ",
                              ("block_num", chain.head_block_num() + 1)
@@ -509,6 +695,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                   // ensure its applied to all future speculative blocks as well.
                   _persistent_transactions.insert(transaction_id_with_expiry{trx->id, trx->packed_trx->expiration()});
                }
+               record_table_access(trace);
                send_response(trace);
             }
 
@@ -622,8 +809,18 @@ void producer_plugin::set_program_options(
           "Time in microseconds allowed for a transaction that starts with insufficient CPU quota to complete and cover its CPU usage.")
          ("incoming-defer-ratio", bpo::value<double>()->default_value(1.0),
           "ratio between incoming transations and deferred transactions when both are exhausted")
+         ("max-unapplied-transaction-time-per-slice-ms", bpo::value<int32_t>()->default_value(20),
+          "Maximum wall-clock time, in milliseconds, spent re-applying previously applied transactions before yielding to incoming transactions; the rest are re-applied in further slices during the block (-1 to re-apply all at the start of the block)")
+         ("experimental-table-conflict-stats", bpo::bool_switch()->default_value(false),
+          "Record the contract tables each transaction reads and writes and log, for every produced block, how many rounds its transactions would need if non-conflicting transactions executed concurrently")
+         ("incoming-transaction-queue-size-mb", bpo::value<uint16_t>()->default_value( 1024 ),
+          "Maximum size (in MiB) of the incoming transaction queue. When full the transactions with the lowest fee are dropped")
+         ("incoming-transaction-max-queue-age-ms", bpo::value<uint32_t>()->default_value( 3000 ),
+          "Once an incoming transaction has been queued longer than this, the oldest transactions alternate with the highest fee ones (0 to always order by fee)")
          ("producer-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
-          "Number of worker threads in producer thread pool")
+          "Number of worker threads in producer thread pool, used for the signature recovery of transactions that "
+          "have not started it yet, such as those pushed over http. Transactions received over p2p recover their "
+          "keys on the p2p-key-recovery-threads pool")
          ("snapshots-dir", bpo::value<bfs::path>()->default_value("snapshots"),
           "the location of the snapshots directory (absolute path or relative to application data dir)")
          ;
@@ -764,6 +961,20 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
 
    my->_incoming_defer_ratio = options.at("incoming-defer-ratio").as<double>();
 
+   my->_max_unapplied_transaction_time_per_slice_ms = options.at("max-unapplied-transaction-time-per-slice-ms").as<int32_t>();
+
+   my->_table_conflict_stats = options.at( "experimental-table-conflict-stats" ).as<bool>();
+   chain.set_track_table_access( my->_table_conflict_stats );
+
+   const auto incoming_queue_mb = options.at( "incoming-transaction-queue-size-mb" ).as<uint16_t>();
+   EOS_ASSERT( incoming_queue_mb > 0, plugin_config_exception,
+               "incoming-transaction-queue-size-mb ${mb} must be greater than 0", ("mb", incoming_queue_mb));
+   my->_pending_incoming_transactions.set_limits( size_t(incoming_queue_mb) * 1024 * 1024,
+         fc::milliseconds( options.at( "incoming-transaction-max-queue-age-ms" ).as<uint32_t>() ) );
+   my->_pending_incoming_transactions.set_fee_lookup( [impl = my.get()]( const std::string& end_point ) {
+      return impl->scheduled_fee( end_point );
+   } );
+
    auto thread_pool_size = options.at( "producer-threads" ).as<uint16_t>();
    EOS_ASSERT( thread_pool_size > 0, plugin_config_exception,
                "producer-threads ${num} must be greater than 0", ("num", thread_pool_size));
@@ -1216,6 +1427,39 @@ producer_plugin::get_account_ram_corrections( const get_account_ram_corrections_
    return result;
 }
 
+producer_plugin::timing_result producer_plugin::get_timing( const get_timing_params& params ) {
+   timing_result result;
+   for( size_t i = 0; i < my->_phase_histograms.size(); ++i ) {
+      result.histograms.emplace_back( my->_phase_histograms[i].info( timing_phase_name( static_cast<timing_phase>(i) ) ) );
+      if( params.reset ) my->_phase_histograms[i].reset();
+   }
+   result.unapplied = my->_unapplied_stats;
+   if( params.reset ) my->_unapplied_stats = unapplied_transaction_stats();
+   return result;
+}
+
+producer_plugin::timing_prometheus_result producer_plugin::get_timing_prometheus() const {
+   static const char* metric = "producer_phase_duration_microseconds";
+   std::ostringstream os;
+   os << "# HELP " << metric << " Wall-clock time spent in each block production phase\n";
+   os << "# TYPE " << metric << " histogram\n";
+   for( size_t i = 0; i < my->_phase_histograms.size(); ++i ) {
+      my->_phase_histograms[i].prometheus( os, metric, timing_phase_name( static_cast<timing_phase>(i) ) );
+   }
+
+   const auto& u = my->_unapplied_stats;
+   os << "# HELP producer_unapplied_transactions_total Previously applied transactions re-applied after a block change\n";
+   os << "# TYPE producer_unapplied_transactions_total counter\n";
+   os << "producer_unapplied_transactions_total{result=\"applied\"} " << u.applied << "\n";
+   os << "producer_unapplied_transactions_total{result=\"failed\"} " << u.failed << "\n";
+   os << "producer_unapplied_transactions_total{result=\"expired\"} " << u.expired << "\n";
+   os << "# TYPE producer_unapplied_slices_total counter\n";
+   os << "producer_unapplied_slices_total " << u.slices << "\n";
+   os << "# TYPE producer_unapplied_microseconds_total counter\n";
+   os << "producer_unapplied_microseconds_total " << u.elapsed_us << "\n";
+   return {os.str()};
+}
+
 optional<fc::time_point> producer_plugin_impl::calculate_next_block_time(const account_name& producer_name, const block_timestamp_type& current_block_time) const {
    chain::controller& chain = chain_plug->chain();
    const auto& hbs = chain.head_block_state();
@@ -1376,6 +1620,8 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
       }
 
       chain.abort_block();
+      _pending_block_table_access.clear();
+      ++_unapplied_corelation_id;
 
       auto features_to_activate = chain.get_preactivated_protocol_features();
       if( _pending_block_mode == pending_block_mode::producing && _protocol_features_to_activate.size() > 0 ) {
@@ -1544,17 +1790,24 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
    auto& persisted_by_id = _persistent_transactions.get<by_id>();
 
    bool exhausted = false;
+   bool more = false;
    // Processing unapplied transactions...
    //
    if (_producers.empty() && persisted_by_id.empty()) {
       // if this node can never produce and has no persisted transactions,
       // there is no need for unapplied transactions they can be dropped
-      chain.get_unapplied_transactions().clear();
+      chain.clear_unapplied_transactions();
    } else {
+      const time_point pending_block_time = chain.pending_block_time();
+      const auto start = fc::time_point::now();
+      const size_t num_expired = chain.drop_expired_unapplied_transactions( pending_block_time );
+      _unapplied_stats.expired += num_expired;
+
       // derive appliable transactions from unapplied_transactions and drop droppable transactions
       unapplied_transactions_type& unapplied_trxs = chain.get_unapplied_transactions();
       if( !unapplied_trxs.empty() ) {
-         const time_point pending_block_time = chain.pending_block_time();
+         const fc::time_point slice_deadline = _max_unapplied_transaction_time_per_slice_ms < 0 ? deadline :
+               std::min<fc::time_point>( deadline, start + fc::milliseconds( _max_unapplied_transaction_time_per_slice_ms ) );
          auto unapplied_trxs_size = unapplied_trxs.size();
          int num_applied = 0;
          int num_failed = 0;
@@ -1574,10 +1827,15 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
             auto itr_next = itr; // save off next since itr may be invalidated by loop
             ++itr_next;
 
-            if( deadline <= fc::time_point::now() ) {
+            const auto now = fc::time_point::now();
+            if( deadline <= now ) {
                exhausted = true;
                break;
             }
+            if( slice_deadline <= now ) {
+               more = true;
+               break;
+            }
             const transaction_metadata_ptr trx = itr->second;
             auto category = calculate_transaction_category(trx);
             if (category == tx_category::EXPIRED ||
@@ -1614,6 +1872,7 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
                         ++num_failed;
                      }
                   } else {
+                     record_table_access(trace);
                      ++num_applied;
                   }
                } LOG_AND_DROP();
@@ -1622,15 +1881,42 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
             itr = itr_next;
          }
 
-         fc_dlog( _log, "Processed ${m} of ${n} previously applied transactions, Applied ${applied}, Failed/Dropped ${failed}",
-                  ("m", num_processed)("n", unapplied_trxs_size)("applied", num_applied)("failed", num_failed) );
+         const auto elapsed = fc::time_point::now() - start;
+         ++_unapplied_stats.slices;
+         _unapplied_stats.processed += num_processed;
+         _unapplied_stats.applied += num_applied;
+         _unapplied_stats.failed += num_failed;
+         _unapplied_stats.elapsed_us += elapsed.count();
+         _phase_histograms[static_cast<size_t>(timing_phase::unapplied)].record( elapsed );
+
+         fc_dlog( _log, "Processed ${m} of ${n} previously applied transactions in ${t}us, Applied ${applied}, Failed/Dropped ${failed}, Expired ${expired}${more}",
+                  ("m", num_processed)("n", unapplied_trxs_size)("t", elapsed.count())("applied", num_applied)
+                  ("failed", num_failed)("expired", num_expired)("more", more ? ", continuing later in the block" : "") );
       }
    }
+
+   if( more )
+      schedule_unapplied_trxs_continuation();
    return !exhausted;
 }
 
+void producer_plugin_impl::schedule_unapplied_trxs_continuation() {
+   std::weak_ptr<producer_plugin_impl> weak_this = shared_from_this();
+   // same priority as incoming transactions so the two are interleaved
+   app().post( priority::low, [weak_this, cid = _unapplied_corelation_id]() {
+      auto self = weak_this.lock();
+      if( !self || cid != self->_unapplied_corelation_id ) return;
+      chain::controller& chain = self->chain_plug->chain();
+      if( !chain.is_building_block() ) return;
+      try {
+         self->process_unapplied_trxs( self->calculate_block_deadline( chain.pending_block_time() ) );
+      } LOG_AND_DROP();
+   });
+}
+
 bool producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_point& deadline, size_t& pending_incoming_process_limit )
 {
+   auto timing = time_phase( timing_phase::scheduled );
    chain::controller& chain = chain_plug->chain();
    const time_point pending_block_time = chain.pending_block_time();
    auto& blacklist_by_id = _blacklisted_transactions.get<by_id>();
@@ -1671,16 +1957,16 @@ bool producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
 
       // configurable ratio of incoming txns vs deferred txns
       while (incoming_trx_weight >= 1.0 && pending_incoming_process_limit && _pending_incoming_transactions.size()) {
-         if (deadline <= fc::time_point::now()) {
+         const auto now = fc::time_point::now();
+         if (deadline <= now) {
             exhausted = true;
             break;
          }
 
-         auto e = _pending_incoming_transactions.front();
-         _pending_incoming_transactions.pop_front();
+         auto e = _pending_incoming_transactions.pop(now);
          --pending_incoming_process_limit;
          incoming_trx_weight -= 1.0;
-         process_incoming_transaction_async(std::get<0>(e), std::get<1>(e), std::get<2>(e));
+         process_incoming_transaction_async(e.trx, e.persist_until_expired, e.next);
       }
 
       if (deadline <= fc::time_point::now()) {
@@ -1708,6 +1994,7 @@ bool producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
                num_failed++;
             }
          } else {
+            record_table_access(trace);
             num_applied++;
          }
       } LOG_AND_DROP();
@@ -1728,18 +2015,20 @@ bool producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
 
 bool producer_plugin_impl::process_incoming_trxs( const fc::time_point& deadline, size_t& pending_incoming_process_limit )
 {
+   auto timing = time_phase( timing_phase::incoming );
    bool exhausted = false;
    if (!_pending_incoming_transactions.empty()) {
-      fc_dlog(_log, "Processing ${n} pending transactions", ("n", _pending_incoming_transactions.size()));
+      fc_dlog(_log, "Processing ${n} pending transactions, ${b} bytes",
+              ("n", _pending_incoming_transactions.size())("b", _pending_incoming_transactions.bytes_size()));
       while (pending_incoming_process_limit && _pending_incoming_transactions.size()) {
-         if( deadline <= fc::time_point::now() ) {
+         const auto now = fc::time_point::now();
+         if( deadline <= now ) {
             exhausted = true;
             break;
          }
-         auto e = _pending_incoming_transactions.front();
-         _pending_incoming_transactions.pop_front();
+         auto e = _pending_incoming_transactions.pop(now);
          --pending_incoming_process_limit;
-         process_incoming_transaction_async(std::get<0>(e), std::get<1>(e), std::get<2>(e));
+         process_incoming_transaction_async(e.trx, e.persist_until_expired, e.next);
       }
    }
    return !exhausted;
@@ -1750,7 +2039,11 @@ void producer_plugin_impl::schedule_production_loop() {
    _timer.cancel();
    std::weak_ptr<producer_plugin_impl> weak_this = shared_from_this();
 
-   auto result = start_block();
+   start_block_result result;
+   {
+      auto timing = time_phase( timing_phase::start_block );
+      result = start_block();
+   }
 
    if (result == start_block_result::failed) {
       elog("Failed to start a pending block, will try again later");
@@ -1900,12 +2193,19 @@ void producer_plugin_impl::produce_block() {
    }
 
    //idump( (fc::time_point::now() - chain.pending_block_time()) );
-   chain.finalize_block( [&]( const digest_type& d ) {
-      auto debug_logger = maybe_make_debug_time_logger();
-      return signature_provider_itr->second(d);
-   } );
+   {
+      auto timing = time_phase( timing_phase::finalize_block );
+      chain.finalize_block( [&]( const digest_type& d ) {
+         auto debug_logger = maybe_make_debug_time_logger();
+         auto sign_timing = time_phase( timing_phase::sign_block );
+         return signature_provider_itr->second(d);
+      } );
+   }
 
-   chain.commit_block();
+   {
+      auto timing = time_phase( timing_phase::commit_block );
+      chain.commit_block();
+   }
 
    block_state_ptr new_bs = chain.head_block_state();
 
@@ -1914,6 +2214,13 @@ void producer_plugin_impl::produce_block() {
         ("n",new_bs->block_num)("t",new_bs->header.timestamp)
         ("count",new_bs->block->transactions.size())("lib",chain.last_irreversible_block_num())("confs", new_bs->header.confirmed));
 
+   if (_table_conflict_stats && !_pending_block_table_access.empty()) {
+      // rounds is the critical path length if non-conflicting transactions were executed concurrently
+      const auto rounds = conflict_rounds(_pending_block_table_access);
+      ilog("Table conflicts in block #${n}: ${trxs} trxs could execute in ${rounds} rounds",
+           ("n",new_bs->block_num)("trxs",_pending_block_table_access.size())("rounds",rounds));
+      _pending_block_table_access.clear();
+   }
 }
 
 } // namespace eosio
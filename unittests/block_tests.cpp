@@ -4,6 +4,10 @@
  */
 #include <boost/test/unit_test.hpp>
 #include <eosio/testing/tester.hpp>
+#include <eosio/chain/block_log.hpp>
+#include <fc/io/fstream.hpp>
+
+#include <fstream>
 
 using namespace eosio;
 using namespace testing;
@@ -191,4 +195,209 @@ BOOST_AUTO_TEST_SUITE(block_tests)
 
     }
 
+/**
+ * Ensure that the raw bytes served from the block log match the serialization of the stored block
+ */
+    BOOST_AUTO_TEST_CASE(serialized_block_from_log_test) {
+        tester chain;
+
+        chain.produce_blocks(20);
+        const uint32_t lib = chain.control->last_irreversible_block_num();
+        BOOST_REQUIRE(lib > 2);
+
+        const size_t prefix_size = 5;
+        for (uint32_t block_num = 2; block_num <= chain.control->head_block_num(); ++block_num) {
+            auto b = chain.control->fetch_block_by_number(block_num);
+            BOOST_REQUIRE(b);
+            bytes packed = fc::raw::pack(*b);
+
+            std::vector<char> serialized;
+            BOOST_REQUIRE(chain.control->fetch_serialized_block_by_number(block_num, serialized, prefix_size));
+            BOOST_REQUIRE_EQUAL(serialized.size(), packed.size() + prefix_size);
+            BOOST_CHECK(std::equal(packed.begin(), packed.end(), serialized.begin() + prefix_size));
+        }
+
+        std::vector<char> serialized;
+        BOOST_CHECK(!chain.control->fetch_serialized_block_by_number(chain.control->head_block_num() + 1, serialized));
+    }
+
+/**
+ * Ensure that a block log split into segments keeps serving retained blocks and archives old segments
+ */
+    BOOST_AUTO_TEST_CASE(split_block_log_test) {
+        tester chain;
+        chain.produce_blocks(30);
+        BOOST_REQUIRE(chain.control->head_block_num() > 30);
+
+        fc::temp_directory tempdir;
+        block_log_config cfg;
+        cfg.stride = 10;
+        cfg.max_retained_files = 2;
+        {
+            block_log blog(tempdir.path(), cfg);
+            blog.reset(chain.get_config().genesis, chain.control->fetch_block_by_number(1));
+            for (uint32_t block_num = 2; block_num <= 30; ++block_num) {
+                blog.append(chain.control->fetch_block_by_number(block_num));
+            }
+
+            BOOST_CHECK(fc::exists(tempdir.path() / "archive" / "blocks-1-10.log"));
+            BOOST_CHECK(fc::exists(tempdir.path() / "blocks-11-20.log"));
+            BOOST_CHECK(fc::exists(tempdir.path() / "blocks-21-30.log"));
+            BOOST_CHECK_EQUAL(blog.first_block_num(), 11u);
+            BOOST_CHECK_EQUAL(blog.head()->block_num(), 30u);
+            BOOST_CHECK(!blog.read_block_by_num(5));
+            BOOST_CHECK_EQUAL(blog.read_block_by_num(15)->block_num(), 15u);
+            BOOST_CHECK_EQUAL(blog.read_block_by_num(30)->block_num(), 30u);
+        }
+
+        // segment indexes are rebuilt when missing
+        fc::remove(tempdir.path() / "blocks-11-20.index");
+        {
+            block_log blog(tempdir.path(), cfg);
+            BOOST_CHECK(fc::exists(tempdir.path() / "blocks-11-20.index"));
+            BOOST_CHECK_EQUAL(blog.head()->block_num(), 30u);
+            BOOST_CHECK_EQUAL(blog.read_block_by_num(20)->id(), chain.control->fetch_block_by_number(20)->id());
+
+            blog.append(chain.control->fetch_block_by_number(31));
+            BOOST_CHECK_EQUAL(blog.head()->block_num(), 31u);
+            BOOST_CHECK_EQUAL(blog.read_block_by_num(31)->block_num(), 31u);
+        }
+
+        // existing segments are not silently ignored without a stride
+        BOOST_CHECK_THROW(block_log(tempdir.path(), block_log_config()), block_log_exception);
+    }
+
+/**
+ * Ensure that repairing a split block log keeps its retained and archived segments
+ */
+    BOOST_AUTO_TEST_CASE(repair_split_block_log_test) {
+        tester chain;
+        chain.produce_blocks(30);
+        BOOST_REQUIRE(chain.control->head_block_num() > 30);
+
+        fc::temp_directory tempdir;
+        const auto blocks_dir = tempdir.path() / "blocks";
+        block_log_config cfg;
+        cfg.stride = 10;
+        cfg.max_retained_files = 2;
+        {
+            block_log blog(blocks_dir, cfg);
+            blog.reset(chain.get_config().genesis, chain.control->fetch_block_by_number(1));
+            for (uint32_t block_num = 2; block_num <= 35; ++block_num) {
+                blog.append(chain.control->fetch_block_by_number(block_num));
+            }
+        }
+        BOOST_REQUIRE(fc::exists(blocks_dir / "archive" / "blocks-1-10.log"));
+
+        const auto backup_dir = block_log::repair_log(blocks_dir, 0, cfg.retained_dir, cfg.archive_dir);
+        BOOST_CHECK(fc::exists(blocks_dir / "archive" / "blocks-1-10.log"));
+        BOOST_CHECK(fc::exists(blocks_dir / "blocks-11-20.log"));
+        BOOST_CHECK(fc::exists(blocks_dir / "blocks-21-30.log"));
+        BOOST_CHECK(!fc::exists(backup_dir / "archive"));
+        {
+            block_log blog(blocks_dir, cfg);
+            BOOST_CHECK_EQUAL(blog.first_block_num(), 11u);
+            BOOST_CHECK_EQUAL(blog.head()->block_num(), 35u);
+            BOOST_CHECK_EQUAL(blog.read_block_by_num(15)->id(), chain.control->fetch_block_by_number(15)->id());
+            BOOST_CHECK_EQUAL(blog.read_block_by_num(33)->id(), chain.control->fetch_block_by_number(33)->id());
+        }
+    }
+
+/**
+ * Ensure that the block log index is rebuilt from the position trailers, and by a sequential scan when a trailer
+ * is damaged
+ */
+    BOOST_AUTO_TEST_CASE(block_log_index_rebuild_test) {
+        tester chain;
+        chain.produce_blocks(30);
+        BOOST_REQUIRE(chain.control->head_block_num() > 30);
+
+        fc::temp_directory tempdir;
+        const auto block_file = tempdir.path() / "blocks.log";
+        const auto index_file = tempdir.path() / "blocks.index";
+        {
+            block_log blog(tempdir.path());
+            blog.reset(chain.get_config().genesis, chain.control->fetch_block_by_number(1));
+            for (uint32_t block_num = 2; block_num <= 30; ++block_num) {
+                blog.append(chain.control->fetch_block_by_number(block_num));
+            }
+        }
+        std::string index;
+        fc::read_file_contents(index_file, index);
+        BOOST_REQUIRE_EQUAL(index.size(), 30 * sizeof(uint64_t));
+
+        auto rebuilt_index = [&]() {
+            fc::remove(index_file);
+            block_log::construct_index(block_file, index_file);
+            std::string rebuilt;
+            fc::read_file_contents(index_file, rebuilt);
+            return rebuilt;
+        };
+        BOOST_CHECK(rebuilt_index() == index);
+
+        // damage the position trailer of block 15, which sits just before block 16
+        uint64_t block_16_pos = 0;
+        memcpy(&block_16_pos, index.data() + 15 * sizeof(uint64_t), sizeof(block_16_pos));
+        {
+            std::fstream block_stream(block_file.generic_string(), std::ios::in | std::ios::out | std::ios::binary);
+            const uint64_t bad_pos = 1;
+            block_stream.seekp(block_16_pos - sizeof(bad_pos));
+            block_stream.write((const char *) &bad_pos, sizeof(bad_pos));
+        }
+        BOOST_CHECK(rebuilt_index() == index);
+
+        block_log blog(tempdir.path());
+        BOOST_CHECK_EQUAL(blog.head()->block_num(), 30u);
+        BOOST_CHECK_EQUAL(blog.read_block_by_num(15)->id(), chain.control->fetch_block_by_number(15)->id());
+        BOOST_CHECK_EQUAL(blog.read_block_by_num(16)->id(), chain.control->fetch_block_by_number(16)->id());
+    }
+
+/**
+ * Ensure that the expiration buckets of unapplied transactions do not outgrow the transactions they index
+ */
+    BOOST_AUTO_TEST_CASE(unapplied_expirations_test) {
+        tester chain;
+        chain.produce_block();
+
+        chain.create_accounts({N(unappa), N(unappb), N(unappc)});
+        chain.control->abort_block();
+        auto &unapplied = chain.control->get_unapplied_transactions();
+        BOOST_REQUIRE_EQUAL(unapplied.size(), 3u);
+        BOOST_CHECK_EQUAL(chain.control->unapplied_expiration_entries(), 3u);
+
+        // applying them and aborting again, as a producer does every block, does not pile up buckets
+        for (int i = 0; i < 10; ++i) {
+            chain.control->start_block(chain.control->head_block_time() + fc::microseconds(config::block_interval_us));
+            const auto trxs = unapplied; // pushing erases them from the map
+            for (const auto &t : trxs) {
+                auto trace = chain.control->push_transaction(t.second, fc::time_point::maximum(),
+                                                             DEFAULT_BILLED_CPU_TIME_US);
+                BOOST_REQUIRE(!trace->except);
+            }
+            BOOST_REQUIRE(unapplied.empty());
+            chain.control->abort_block();
+            BOOST_REQUIRE_EQUAL(unapplied.size(), 3u);
+        }
+        BOOST_CHECK_EQUAL(chain.control->unapplied_expiration_entries(), 3u);
+
+        // the buckets of a map cleared directly are dropped once transactions are added again
+        unapplied.clear();
+        chain.create_account(N(unappd));
+        chain.control->abort_block();
+        BOOST_REQUIRE_EQUAL(unapplied.size(), 1u);
+        BOOST_CHECK_EQUAL(chain.control->unapplied_expiration_entries(), 1u);
+        BOOST_CHECK_EQUAL(chain.control->drop_expired_unapplied_transactions(fc::time_point::maximum()), 1u);
+        BOOST_CHECK(unapplied.empty());
+        BOOST_CHECK_EQUAL(chain.control->unapplied_expiration_entries(), 0u);
+
+        chain.create_account(N(unappe));
+        chain.control->abort_block();
+        BOOST_REQUIRE_EQUAL(unapplied.size(), 1u);
+        chain.control->clear_unapplied_transactions();
+        BOOST_CHECK(unapplied.empty());
+        BOOST_CHECK_EQUAL(chain.control->unapplied_expiration_entries(), 0u);
+
+        chain.produce_block();
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -654,4 +654,97 @@ static const char large_maligned_host_ptr[] = R"=====(
    ))
  )
 )
-)=====";
\ No newline at end of file
+)=====";
+static const char db_lookup_cache_wast[] = R"=====(
+(module
+ (import "env" "eosio_assert" (func $eosio_assert (param i32 i32)))
+ (import "env" "db_idx64_store" (func $db_idx64_store (param i64 i64 i64 i64 i32) (result i32)))
+ (import "env" "db_idx64_update" (func $db_idx64_update (param i32 i64 i32)))
+ (import "env" "db_idx64_remove" (func $db_idx64_remove (param i32)))
+ (import "env" "db_idx64_find_secondary" (func $db_idx64_find_secondary (param i64 i64 i64 i32 i32) (result i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (data (i32.const 64) "missing table\00")
+ (data (i32.const 80) "stored row\00")
+ (data (i32.const 96) "cached miss\00")
+ (data (i32.const 112) "updated row\00")
+ (data (i32.const 128) "old key\00")
+ (data (i32.const 144) "removed table\00")
+ (data (i32.const 160) "recreated table\00")
+ (export "apply" (func $apply))
+ (func $find (param $0 i64) (param $1 i64) (result i32)
+  (i64.store (i32.const 16) (get_local $1))
+  (i64.store (i32.const 32) (i64.const 0))
+  (call $db_idx64_find_secondary (get_local $0) (get_local $0) (i64.const 1) (i32.const 16) (i32.const 32))
+ )
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (local $3 i32)
+  (if (i64.eq (get_local $2) (i64.const 0)) (then
+   (call $eosio_assert (i32.eq (call $find (get_local $0) (i64.const 5)) (i32.const -1)) (i32.const 64))
+   (set_local $3 (call $db_idx64_store (get_local $0) (i64.const 1) (get_local $0) (i64.const 1) (i32.const 16)))
+   (call $eosio_assert (i32.ge_s (call $find (get_local $0) (i64.const 5)) (i32.const 0)) (i32.const 80))
+   (call $eosio_assert (i64.eq (i64.load (i32.const 32)) (i64.const 1)) (i32.const 80))
+   (call $eosio_assert (i32.lt_s (call $find (get_local $0) (i64.const 7)) (i32.const -1)) (i32.const 96))
+   (call $db_idx64_update (get_local $3) (i64.const 0) (i32.const 16))
+   (call $eosio_assert (i32.ge_s (call $find (get_local $0) (i64.const 7)) (i32.const 0)) (i32.const 112))
+   (call $eosio_assert (i64.eq (i64.load (i32.const 32)) (i64.const 1)) (i32.const 112))
+   (call $eosio_assert (i32.lt_s (call $find (get_local $0) (i64.const 5)) (i32.const -1)) (i32.const 128))
+   (call $db_idx64_remove (get_local $3))
+   (call $eosio_assert (i32.eq (call $find (get_local $0) (i64.const 7)) (i32.const -1)) (i32.const 144))
+  ))
+  (if (i64.eq (get_local $2) (i64.const 1)) (then
+   (call $eosio_assert (i32.eq (call $find (get_local $0) (i64.const 7)) (i32.const -1)) (i32.const 144))
+   (drop (call $db_idx64_store (get_local $0) (i64.const 1) (get_local $0) (i64.const 2) (i32.const 16)))
+   (call $eosio_assert (i32.ge_s (call $find (get_local $0) (i64.const 7)) (i32.const 0)) (i32.const 160))
+   (call $eosio_assert (i64.eq (i64.load (i32.const 32)) (i64.const 2)) (i32.const 160))
+  ))
+ )
+)
+)=====";
+
+static const char native_contract_wast[] = R"=====(
+(module
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (data (i32.const 16) "row")
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (drop (call $db_store_i64 (get_local $0) (i64.const 1) (get_local $0) (get_local $2) (i32.const 16) (i32.const 3)))
+ )
+)
+)=====";
+
+static const char wasm_cache_wast[] = R"=====(
+(module
+ (memory $$0 1)
+ (data (i32.const 16) "${ID}")
+ (export "apply" (func $$apply))
+ (func $$apply (param $$0 i64) (param $$1 i64) (param $$2 i64))
+)
+)=====";
+
+static const char tiered_compilation_wast[] = R"=====(
+(module
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (table 0 anyfunc)
+ (memory $0 1)
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (local $i i64)
+  (local $acc i64)
+  (set_local $acc (i64.const 1))
+  (block $done
+   (loop $next
+    (br_if $done (i64.ge_u (get_local $i) (i64.const 1000)))
+    (set_local $acc (i64.xor (i64.add (i64.mul (get_local $acc) (i64.const 6364136223846793005)) (get_local $i))
+                             (i64.shr_u (get_local $acc) (i64.const 29))))
+    (set_local $i (i64.add (get_local $i) (i64.const 1)))
+    (br $next)
+   )
+  )
+  (i64.store (i32.const 16) (get_local $acc))
+  (drop (call $db_store_i64 (get_local $0) (i64.const 1) (get_local $0) (get_local $2) (i32.const 16) (i32.const 8)))
+ )
+)
+)=====";
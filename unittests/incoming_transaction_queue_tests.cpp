@@ -0,0 +1,170 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#include <eosio/producer_plugin/incoming_transaction_queue.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+
+using namespace eosio;
+using namespace eosio::chain;
+
+namespace {
+
+    // one trnsfiopubky action per transaction, unique by amount
+    transaction_metadata_ptr make_transfer(account_name actor, int64_t max_fee) {
+        static int64_t amount = 0;
+        signed_transaction trx;
+        trnsfiopubky t{"FIO7uRvrLVrZCbCM2DtCgUMospqUMnP3JUC1sKHA8zNoF835kJBvN", ++amount, max_fee, actor, ""};
+        trx.actions.emplace_back(vector<permission_level>{{actor, config::active_name}}, t);
+        trx.expiration = fc::time_point_sec(fc::time_point::now() + fc::seconds(60));
+        return std::make_shared<transaction_metadata>(trx);
+    }
+
+    incoming_transaction_queue::fee_lookup_t fee_schedule(uint64_t transfer_fee) {
+        return [transfer_fee](const std::string &end_point) -> fc::optional<uint64_t> {
+            if (end_point == "transfer_tokens_pub_key") return transfer_fee;
+            return {};
+        };
+    }
+
+    int64_t max_fee_of(const incoming_transaction_queue::entry &e) {
+        return fc::raw::unpack<trnsfiopubky>(e.trx->packed_trx->get_transaction().actions.front().data).max_fee;
+    }
+
+    account_name actor_of(const incoming_transaction_queue::entry &e) {
+        return e.trx->packed_trx->get_transaction().actions.front().authorization.front().actor;
+    }
+
+}
+
+BOOST_AUTO_TEST_SUITE(incoming_transaction_queue_tests)
+
+    BOOST_AUTO_TEST_CASE(fee_capped_at_schedule) {
+        try {
+            incoming_transaction_queue q;
+            q.set_fee_lookup(fee_schedule(100));
+            const auto now = fc::time_point::now();
+
+            q.push(make_transfer(N(alice), 50), false, {}, now);
+            q.push(make_transfer(N(bob), 1000000), false, {}, now);
+            q.push(make_transfer(N(carol), 100), false, {}, now);
+
+            // a max_fee above the schedule ranks the same as paying the schedule, earlier arrival goes first
+            auto e = q.pop(now);
+            BOOST_CHECK_EQUAL(e.fee, 100u);
+            BOOST_CHECK_EQUAL(actor_of(e), N(bob));
+            e = q.pop(now);
+            BOOST_CHECK_EQUAL(e.fee, 100u);
+            BOOST_CHECK_EQUAL(actor_of(e), N(carol));
+            e = q.pop(now);
+            BOOST_CHECK_EQUAL(e.fee, 50u);
+            BOOST_CHECK(q.empty());
+
+            // without a fee schedule nothing is prioritized
+            incoming_transaction_queue unscheduled;
+            unscheduled.push(make_transfer(N(alice), 50), false, {}, now);
+            unscheduled.push(make_transfer(N(bob), 1000000), false, {}, now);
+            BOOST_CHECK_EQUAL(actor_of(unscheduled.pop(now)), N(alice));
+            BOOST_CHECK_EQUAL(actor_of(unscheduled.pop(now)), N(bob));
+        } FC_LOG_AND_RETHROW()
+    }
+
+    BOOST_AUTO_TEST_CASE(ordering) {
+        try {
+            incoming_transaction_queue q;
+            q.set_fee_lookup(fee_schedule(100));
+            const auto now = fc::time_point::now();
+
+            q.push(make_transfer(N(alice), 90), false, {}, now);
+            q.push(make_transfer(N(alice), 90), false, {}, now);
+            q.push(make_transfer(N(bob), 90), false, {}, now);
+            q.push(make_transfer(N(alice), 10), false, {}, now);
+            q.push(make_transfer(N(carol), 0), false, {}, now);
+            BOOST_CHECK_EQUAL(q.size(), 5u);
+
+            // highest fee first, accounts paying the same fee interleaved, then arrival
+            auto e = q.pop(now);
+            BOOST_CHECK_EQUAL(actor_of(e), N(alice));
+            BOOST_CHECK_EQUAL(max_fee_of(e), 90);
+            e = q.pop(now);
+            BOOST_CHECK_EQUAL(actor_of(e), N(bob));
+            e = q.pop(now);
+            BOOST_CHECK_EQUAL(actor_of(e), N(alice));
+            BOOST_CHECK_EQUAL(max_fee_of(e), 90);
+            e = q.pop(now);
+            BOOST_CHECK_EQUAL(max_fee_of(e), 10);
+            e = q.pop(now);
+            BOOST_CHECK_EQUAL(actor_of(e), N(carol));
+            BOOST_CHECK(q.empty());
+            BOOST_CHECK_EQUAL(q.bytes_size(), 0u);
+        } FC_LOG_AND_RETHROW()
+    }
+
+    BOOST_AUTO_TEST_CASE(aging) {
+        try {
+            incoming_transaction_queue q;
+            q.set_fee_lookup(fee_schedule(100));
+            q.set_limits(std::numeric_limits<size_t>::max(), fc::milliseconds(100));
+            const auto start = fc::time_point::now();
+
+            q.push(make_transfer(N(alice), 0), false, {}, start);
+            q.push(make_transfer(N(bob), 100), false, {}, start + fc::milliseconds(50));
+
+            // not aged yet, priority order
+            BOOST_CHECK_EQUAL(actor_of(q.pop(start + fc::milliseconds(60))), N(bob));
+            q.push(make_transfer(N(bob), 100), false, {}, start + fc::milliseconds(60));
+
+            // aged zero fee transaction is taken ahead of the higher fee one
+            BOOST_CHECK_EQUAL(actor_of(q.pop(start + fc::milliseconds(100))), N(alice));
+            BOOST_CHECK_EQUAL(actor_of(q.pop(start + fc::milliseconds(100))), N(bob));
+            BOOST_CHECK(q.empty());
+        } FC_LOG_AND_RETHROW()
+    }
+
+    BOOST_AUTO_TEST_CASE(saturation) {
+        try {
+            incoming_transaction_queue q;
+            q.set_fee_lookup(fee_schedule(100));
+            q.set_limits(std::numeric_limits<size_t>::max(), fc::milliseconds(100));
+            const auto start = fc::time_point::now();
+            const auto later = start + fc::seconds(10);
+
+            // every entry is aged, a backlog of zero fee transactions queued ahead of fee paying ones
+            for (int i = 0; i < 10; ++i)
+                q.push(make_transfer(N(spammer), 0), false, {}, start);
+            for (int i = 0; i < 10; ++i)
+                q.push(make_transfer(N(payer), 100), false, {}, start);
+
+            // aged and priority pops alternate rather than degrading to plain FIFO
+            std::map<account_name, uint32_t> first_ten;
+            for (int i = 0; i < 10; ++i)
+                ++first_ten[actor_of(q.pop(later))];
+            BOOST_CHECK_EQUAL(first_ten[N(spammer)], 5u);
+            BOOST_CHECK_EQUAL(first_ten[N(payer)], 5u);
+            while (!q.empty())
+                q.pop(later);
+
+            // eviction when full drops the lowest fee and rejects what does not outrank the queue
+            const size_t entry_size = [&]() {
+                incoming_transaction_queue one;
+                one.push(make_transfer(N(payer), 0), false, {}, start);
+                return one.bytes_size();
+            }();
+            q.set_limits(entry_size * 2, fc::microseconds());
+            BOOST_CHECK(q.push(make_transfer(N(spammer), 0), false, {}, start).empty());
+            BOOST_CHECK(q.push(make_transfer(N(spammer), 0), false, {}, start).empty());
+            auto evicted = q.push(make_transfer(N(payer), 100), false, {}, start);
+            BOOST_REQUIRE_EQUAL(evicted.size(), 1u);
+            BOOST_CHECK_EQUAL(actor_of(evicted.front()), N(spammer));
+            evicted = q.push(make_transfer(N(spammer), 0), false, {}, start);
+            BOOST_REQUIRE_EQUAL(evicted.size(), 1u);
+            BOOST_CHECK_EQUAL(evicted.front().fee, 0u);
+            BOOST_CHECK_EQUAL(q.size(), 2u);
+            BOOST_CHECK_EQUAL(actor_of(q.pop(start)), N(payer));
+        } FC_LOG_AND_RETHROW()
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
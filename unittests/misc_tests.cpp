@@ -8,6 +8,7 @@
 #include <eosio/chain/chain_config.hpp>
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/table_access_set.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <fc/io/json.hpp>
@@ -1203,6 +1204,36 @@ BOOST_CHECK_EQUAL(i, results.at(i));
 } FC_LOG_AND_RETHROW()
 }
 
+        BOOST_AUTO_TEST_CASE(table_access_conflict_test) {
+            try {
+                auto key = [](name table, name scope) {
+                    return table_access_set::table_key(N(fio.address), scope, table);
+                };
+                table_access_set a, b, c, d, e;
+                a.reads.insert(key(N(domains), N(fio)));
+                a.writes.insert(key(N(fionames), N(fio)));
+                b.reads.insert(key(N(domains), N(fio)));
+                b.writes.insert(key(N(fionames), N(alice)));
+                c.reads.insert(key(N(fionames), N(fio)));
+                d.writes.insert(key(N(domains), N(fio)));
+                e.writes.insert(key(N(fionames), N(fio)));
+
+                BOOST_CHECK(!a.conflicts_with(b)); // shared reads only
+                BOOST_CHECK(a.conflicts_with(c));  // read after write
+                BOOST_CHECK(c.conflicts_with(a));
+                BOOST_CHECK(a.conflicts_with(d));  // write after read
+                BOOST_CHECK(!c.conflicts_with(d));
+
+                BOOST_CHECK_EQUAL(0u, conflict_rounds({}));
+                BOOST_CHECK_EQUAL(1u, conflict_rounds({a, b}));
+                BOOST_CHECK_EQUAL(2u, conflict_rounds({a, b, c}));
+                // d must follow the reads of a and b, c only depends on a
+                BOOST_CHECK_EQUAL(2u, conflict_rounds({a, b, c, d}));
+                BOOST_CHECK_EQUAL(3u, conflict_rounds({a, c, e}));
+
+            } FC_LOG_AND_RETHROW()
+        }
+
 
 BOOST_AUTO_TEST_SUITE_END()
 
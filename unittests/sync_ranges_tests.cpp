@@ -0,0 +1,96 @@
+/**
+ *  @file
+ *  @copyright defined in fio/LICENSE
+ */
+#include <eosio/net_plugin/sync_ranges.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace eosio;
+
+namespace {
+
+    uint32_t length(const sync_range &r) { return r.first > r.second ? 0 : r.second - r.first + 1; }
+
+}
+
+BOOST_AUTO_TEST_SUITE(sync_ranges_tests)
+
+    BOOST_AUTO_TEST_CASE(next_range) {
+        // a full span, starting after the last requested block or the next expected one
+        BOOST_CHECK(next_sync_range(100, 50, 1000, 100) == sync_range(101, 200));
+        BOOST_CHECK(next_sync_range(0, 51, 1000, 100) == sync_range(51, 150));
+        // only the final tail is shorter
+        BOOST_CHECK(next_sync_range(950, 900, 1000, 100) == sync_range(951, 1000));
+        BOOST_CHECK(next_sync_range(999, 900, 1000, 100) == sync_range(1000, 1000));
+        // nothing left
+        BOOST_CHECK_EQUAL(length(next_sync_range(1000, 900, 1000, 100)), 0u);
+    }
+
+    BOOST_AUTO_TEST_CASE(retake_range) {
+        // the few blocks left at the end of a chunk are widened back to a full span
+        BOOST_CHECK(retake_sync_range(101, 200, 200, 100) == sync_range(101, 200));
+        BOOST_CHECK(retake_sync_range(101, 250, 240, 100) == sync_range(151, 250));
+        // a remainder of at least a span is taken as is
+        BOOST_CHECK(retake_sync_range(101, 250, 120, 100) == sync_range(120, 250));
+        BOOST_CHECK(retake_sync_range(101, 200, 101, 100) == sync_range(101, 200));
+        // a final tail chunk shorter than the span is retaken whole
+        BOOST_CHECK(retake_sync_range(951, 1000, 999, 100) == sync_range(951, 1000));
+        // nothing missing
+        BOOST_CHECK_EQUAL(length(retake_sync_range(101, 200, 201, 100)), 0u);
+        // never shorter than a span unless the chunk is
+        for (uint32_t end = 101; end < 400; ++end) {
+            for (uint32_t missing = 101; missing <= end; ++missing) {
+                const auto r = retake_sync_range(101, end, missing, 100);
+                BOOST_REQUIRE_GE(length(r), std::min<uint32_t>(100, end - 100));
+                BOOST_REQUIRE_LE(r.first, missing);
+                BOOST_REQUIRE_GE(r.first, 101u);
+                BOOST_REQUIRE_EQUAL(r.second, end);
+            }
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(split_range) {
+        auto parts = split_sync_range({1, 100}, 100);
+        BOOST_CHECK(parts.first == sync_range(1, 100));
+        BOOST_CHECK_EQUAL(length(parts.second), 0u);
+        // fewer than two spans is requested whole rather than leaving a short rest
+        parts = split_sync_range({1, 199}, 100);
+        BOOST_CHECK(parts.first == sync_range(1, 199));
+        BOOST_CHECK_EQUAL(length(parts.second), 0u);
+        parts = split_sync_range({1, 200}, 100);
+        BOOST_CHECK(parts.first == sync_range(1, 100));
+        BOOST_CHECK(parts.second == sync_range(101, 200));
+        for (uint32_t end = 1; end < 1000; ++end) {
+            parts = split_sync_range({1, end}, 100);
+            BOOST_REQUIRE_EQUAL(length(parts.first) + length(parts.second), end);
+            if (length(parts.second))
+                BOOST_REQUIRE_GE(length(parts.second), 100u);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(add_range) {
+        std::set<sync_range> ranges;
+        add_sync_range(ranges, {10, 20});
+        add_sync_range(ranges, {30, 40});
+        BOOST_CHECK_EQUAL(ranges.size(), 2u);
+        // adjoining ranges merge, single blocks do not stay separate requests
+        add_sync_range(ranges, {21, 21});
+        add_sync_range(ranges, {22, 29});
+        BOOST_REQUIRE_EQUAL(ranges.size(), 1u);
+        BOOST_CHECK(*ranges.begin() == sync_range(10, 40));
+        // overlapping and covering ranges merge
+        add_sync_range(ranges, {50, 60});
+        add_sync_range(ranges, {5, 55});
+        BOOST_REQUIRE_EQUAL(ranges.size(), 1u);
+        BOOST_CHECK(*ranges.begin() == sync_range(5, 60));
+        add_sync_range(ranges, {70, 80});
+        add_sync_range(ranges, {75, 76});
+        BOOST_REQUIRE_EQUAL(ranges.size(), 2u);
+        BOOST_CHECK(*ranges.rbegin() == sync_range(70, 80));
+        // empty ranges are ignored
+        add_sync_range(ranges, {90, 89});
+        BOOST_CHECK_EQUAL(ranges.size(), 2u);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,13 +6,20 @@
 #include <utility>
 
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/apply_context.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/intrinsic_profiler.hpp>
 #include <eosio/chain/resource_limits.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain/wasm_eosio_constraints.hpp>
+#include <eosio/chain/wasm_eosio_injection.hpp>
+#include <eosio/chain/wasm_eosio_validation.hpp>
 #include <eosio/chain/wast_to_wasm.hpp>
 #include <eosio/testing/tester.hpp>
 
+#include <Inline/Serialization.h>
 #include <Runtime/Runtime.h>
+#include <WASM/WASM.h>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -129,6 +136,48 @@ BOOST_AUTO_TEST_SUITE(wasm_tests)
 
     } FC_LOG_AND_RETHROW() /// basic_test
 
+#ifdef EOSIO_INTRINSIC_PROFILER
+/**
+ * Intrinsic calls are only counted while the profiler is enabled, and are attributed to the receiver and action
+ */
+    BOOST_FIXTURE_TEST_CASE(intrinsic_profile_test, tester) try {
+        create_accounts({N(asserter)});
+        set_code(N(asserter), contracts::asserter_wasm());
+        produce_block();
+
+        auto push_assert = [&](const string &message) {
+            signed_transaction trx;
+            trx.actions.emplace_back(vector<permission_level>{{N(asserter), config::active_name}},
+                                     assertdef{1, message});
+            set_transaction_headers(trx);
+            trx.sign(get_private_key(N(asserter), "active"), control->get_chain_id());
+            push_transaction(trx);
+        };
+
+        intrinsic_profiler::snapshot(true);
+        push_assert("not profiled");
+        BOOST_CHECK(intrinsic_profiler::snapshot(true).empty());
+
+        intrinsic_profiler::set_enabled(true);
+        push_assert("profiled");
+        intrinsic_profiler::set_enabled(false);
+
+        const auto entries = intrinsic_profiler::snapshot(true);
+        BOOST_REQUIRE(!entries.empty());
+        auto read_action_data = std::find_if(entries.begin(), entries.end(), [](const auto &e) {
+            return e.intrinsic == "read_action_data";
+        });
+        BOOST_REQUIRE(read_action_data != entries.end());
+        BOOST_CHECK_EQUAL(read_action_data->receiver.to_string(), name(N(asserter)).to_string());
+        BOOST_CHECK_EQUAL(read_action_data->action.to_string(), name(N(procassert)).to_string());
+        BOOST_CHECK_EQUAL(read_action_data->calls, 1u);
+        BOOST_CHECK_GT(read_action_data->bytes, 0u);
+        for (const auto &e : entries)
+            BOOST_CHECK_EQUAL(e.receiver.to_string(), name(N(asserter)).to_string());
+        BOOST_CHECK(intrinsic_profiler::snapshot(false).empty());
+    } FC_LOG_AND_RETHROW() /// intrinsic_profile_test
+#endif
+
 /**
  * Prove the modifications to global variables are wiped between runs
  */
@@ -629,6 +678,225 @@ BOOST_AUTO_TEST_SUITE(wasm_tests)
         BOOST_CHECK_EQUAL(transaction_receipt::executed, receipt.status);
     } FC_LOG_AND_RETHROW()
 
+//Make sure the lookups cached for a transaction follow stores, updates and removes, across its actions
+    BOOST_FIXTURE_TEST_CASE(db_lookup_cache_invalidation, TESTER) try {
+        produce_blocks(2);
+
+        create_accounts({N(dbcache)});
+        produce_block();
+
+        set_code(N(dbcache), db_lookup_cache_wast);
+        produce_blocks(1);
+
+        signed_transaction trx;
+        for (uint64_t n : {0ULL, 1ULL}) {
+            action act;
+            act.account = N(dbcache);
+            act.name = n;
+            act.authorization = vector<permission_level>{{N(dbcache), config::active_name}};
+            trx.actions.push_back(act);
+        }
+
+        set_transaction_headers(trx);
+        trx.sign(get_private_key(N(dbcache), "active"), control->get_chain_id());
+        push_transaction(trx);
+        produce_blocks(1);
+        BOOST_REQUIRE_EQUAL(true, chain_has_transaction(trx.id()));
+        const auto &receipt = get_transaction_receipt(trx.id());
+        BOOST_CHECK_EQUAL(transaction_receipt::executed, receipt.status);
+    } FC_LOG_AND_RETHROW()
+
+//Make sure the wasm cache evicts down to its budget, never the module about to run, and counts hits and misses
+    BOOST_FIXTURE_TEST_CASE(wasm_cache_budget, TESTER) try {
+        produce_blocks(2);
+
+        create_accounts({N(cachea), N(cacheb)});
+        produce_block();
+
+        set_code(N(cachea), fc::format_string(wasm_cache_wast, fc::mutable_variant_object()("ID", "a")).c_str());
+        set_code(N(cacheb), fc::format_string(wasm_cache_wast, fc::mutable_variant_object()("ID", "b")).c_str());
+        produce_blocks(1);
+
+        uint32_t pushed = 0;
+        auto push = [&](account_name account) {
+            signed_transaction trx;
+            action act;
+            act.account = account;
+            act.name = N();
+            act.authorization = vector<permission_level>{{account, config::active_name}};
+            trx.actions.push_back(act);
+            //a distinct expiration for every push, so repeated pushes are not duplicates
+            set_transaction_headers(trx, DEFAULT_EXPIRATION_DELTA + ++pushed);
+            trx.sign(get_private_key(account, "active"), control->get_chain_id());
+            push_transaction(trx);
+        };
+
+        auto &wasmif = control->get_wasm_interface();
+        push(N(cachea));
+        push(N(cacheb));
+        const auto unbounded = wasmif.get_cache_stats();
+        BOOST_CHECK_EQUAL(unbounded.budget, 0u);
+        BOOST_CHECK_EQUAL(unbounded.budget_evictions, 0u);
+        BOOST_CHECK_GE(unbounded.entries, 2u);
+        BOOST_CHECK_GT(unbounded.code_bytes, 0u);
+        BOOST_CHECK_GE(unbounded.compiles, 2u);
+
+        //a single byte only leaves room for the module that is running
+        wasmif.set_cache_budget(1, wasm_interface::cache_policy::lru);
+        BOOST_CHECK_EQUAL(wasmif.get_cache_stats().code_bytes, 0u);
+        push(N(cachea));
+        push(N(cacheb));
+        push(N(cachea));
+        const auto bounded = wasmif.get_cache_stats();
+        BOOST_CHECK_EQUAL(bounded.budget, 1u);
+        BOOST_CHECK_GE(bounded.misses, unbounded.misses + 3);
+        BOOST_CHECK_GE(bounded.budget_evictions, unbounded.entries + 2);
+        BOOST_CHECK_EQUAL(bounded.entries, 1u);
+        BOOST_CHECK_GT(bounded.code_bytes, 0u);
+
+        wasmif.set_cache_budget(0, wasm_interface::cache_policy::lfu);
+        push(N(cachea));
+        push(N(cachea));
+        const auto reopened = wasmif.get_cache_stats();
+        BOOST_CHECK_GE(reopened.hits, bounded.hits + 1);
+        BOOST_CHECK_EQUAL(reopened.budget_evictions, bounded.budget_evictions);
+    } FC_LOG_AND_RETHROW()
+
+//Make sure tiered compilation interprets new code first, installs the compiled module later, and both agree
+    BOOST_AUTO_TEST_CASE(tiered_compilation) try {
+        fc::temp_directory tempdir;
+        auto cfg = validating_tester::default_config();
+        cfg.blocks_dir = tempdir.path() / config::default_blocks_dir_name;
+        cfg.state_dir = tempdir.path() / config::default_state_dir_name;
+        cfg.wasm_runtime = wasm_interface::vm_type::wavm;
+        cfg.wasm_tiered_compilation = true;
+        tester chain(cfg);
+        chain.execute_setup_policy(setup_policy::full);
+        chain.produce_blocks(2);
+
+        chain.create_accounts({N(tiered)});
+        chain.produce_block();
+        chain.set_code(N(tiered), tiered_compilation_wast);
+        chain.produce_blocks(1);
+
+        uint64_t expected = 1;
+        for (uint64_t i = 0; i < 1000; ++i)
+            expected = (expected * 6364136223846793005ull + i) ^ (expected >> 29);
+
+        auto push = [&](uint64_t n) {
+            signed_transaction trx;
+            action act;
+            act.account = N(tiered);
+            act.name = n;
+            act.authorization = vector<permission_level>{{N(tiered), config::active_name}};
+            trx.actions.push_back(act);
+            chain.set_transaction_headers(trx);
+            trx.sign(chain.get_private_key(N(tiered), "active"), chain.control->get_chain_id());
+            chain.push_transaction(trx);
+        };
+        auto result = [&](uint64_t n) {
+            const auto row = chain.get_row_by_account(N(tiered), N(tiered), 1, name(n));
+            BOOST_REQUIRE_EQUAL(row.size(), sizeof(uint64_t));
+            uint64_t value;
+            memcpy(&value, row.data(), sizeof(value));
+            return value;
+        };
+
+        auto &wasmif = chain.control->get_wasm_interface();
+        const auto code_hash = chain.control->db().get<account_metadata_object, by_name>(N(tiered)).code_hash;
+        uint64_t n = 1;
+        push(n);
+        BOOST_REQUIRE(!wasmif.is_compiled(code_hash, 0, 0));
+        BOOST_CHECK_EQUAL(result(n), expected);
+
+        //the compiled module is installed at the start of an apply, once the background compile has finished
+        const auto deadline = fc::time_point::now() + fc::seconds(60);
+        while (!wasmif.is_compiled(code_hash, 0, 0) && fc::time_point::now() < deadline) {
+            chain.produce_block();
+            push(++n);
+        }
+        BOOST_REQUIRE(wasmif.is_compiled(code_hash, 0, 0));
+        push(++n);
+        BOOST_CHECK_EQUAL(result(n - 1), expected);
+        BOOST_CHECK_EQUAL(result(n), expected);
+        chain.produce_block();
+    } FC_LOG_AND_RETHROW()
+
+//Make sure shadow mode compares a native contract implementation with the wasm, and native mode replaces the wasm
+    BOOST_FIXTURE_TEST_CASE(native_contract_execution, TESTER) try {
+        produce_blocks(2);
+
+        create_accounts({N(nativecode)});
+        produce_block();
+
+        set_code(N(nativecode), native_contract_wast);
+        produce_blocks(1);
+
+        auto store_row = [](uint64_t id, const string &value) {
+            return [id, value](apply_context &context) {
+                context.db_store_i64(context.get_receiver().value, 1, context.get_receiver(), id, value.data(),
+                                     value.size());
+            };
+        };
+        auto &natives = control->get_native_contracts();
+        const auto code_hash = control->db().get<account_metadata_object, by_name>(N(nativecode)).code_hash;
+        natives.add(code_hash, name(1), store_row(1, "row"));
+        natives.add(code_hash, name(2), store_row(2, "not the wasm row"));
+        natives.add(code_hash, name(3), store_row(3, "row"));
+        natives.add(code_hash, name(4), [](apply_context &context) {
+            context.db_store_i64(context.get_receiver().value, 2, context.get_receiver(), 4, "row", 3);
+        });
+
+        auto push_action = [&](uint64_t n) {
+            signed_transaction trx;
+            action act;
+            act.account = N(nativecode);
+            act.name = n;
+            act.authorization = vector<permission_level>{{N(nativecode), config::active_name}};
+            trx.actions.push_back(act);
+            set_transaction_headers(trx);
+            trx.sign(get_private_key(N(nativecode), "active"), control->get_chain_id());
+            return push_transaction(trx);
+        };
+        auto row_count = [&]() {
+            const auto *tab = control->db().find<table_id_object, by_code_scope_table>(
+                    boost::make_tuple(N(nativecode), N(nativecode), name(1)));
+            return tab ? tab->count : 0;
+        };
+
+        natives.set_mode(native_contract_mode::shadow);
+        push_action(1);
+        BOOST_CHECK_EQUAL(natives.get_stats().shadow_runs, 1u);
+        BOOST_CHECK_EQUAL(natives.get_stats().mismatches, 0u);
+        BOOST_CHECK_EQUAL(row_count(), 1u);
+
+        // the state changes are always the wasm's in shadow mode
+        push_action(2);
+        BOOST_CHECK_EQUAL(natives.get_stats().shadow_runs, 2u);
+        BOOST_CHECK_EQUAL(natives.get_stats().mismatches, 1u);
+        BOOST_CHECK_EQUAL(row_count(), 2u);
+
+        // the undone native run leaves no tables in the conflict data
+        control->set_track_table_access(true);
+        auto trace = push_action(4);
+        control->set_track_table_access(false);
+        BOOST_CHECK_EQUAL(natives.get_stats().mismatches, 2u);
+        BOOST_REQUIRE(trace->table_access);
+        BOOST_CHECK_EQUAL(trace->table_access->writes.count(
+                table_access_set::table_key(N(nativecode), N(nativecode), name(1))), 1u);
+        BOOST_CHECK_EQUAL(trace->table_access->writes.count(
+                table_access_set::table_key(N(nativecode), N(nativecode), name(2))), 0u);
+        BOOST_CHECK_EQUAL(row_count(), 3u);
+
+        natives.set_mode(native_contract_mode::native);
+        push_action(3);
+        BOOST_CHECK_EQUAL(natives.get_stats().native_runs, 1u);
+        BOOST_CHECK_EQUAL(row_count(), 4u);
+
+        natives.set_mode(native_contract_mode::off);
+        produce_blocks(1);
+    } FC_LOG_AND_RETHROW()
+
 //Make sure we can create a wasm with maximum pages, but not grow it any
     BOOST_FIXTURE_TEST_CASE(big_memory, TESTER) try {
         produce_blocks(2);
@@ -815,6 +1083,50 @@ BOOST_AUTO_TEST_SUITE(wasm_tests)
     } FC_LOG_AND_RETHROW()
 
 
+    // validating and injecting the functions of a module in parallel gives the results of doing it serially
+    BOOST_AUTO_TEST_CASE(parallel_validation_injection) try {
+        named_thread_pool pool("valid", 3);
+        auto parse = [](const std::vector<uint8_t> &code) {
+            IR::Module module;
+            Serialization::MemoryInputStream stream(code.data(), code.size());
+            WASM::serialize(stream, module);
+            return module;
+        };
+        auto serialize = [](IR::Module &module) {
+            Serialization::ArrayOutputStream stream;
+            WASM::serialize(stream, module);
+            return stream.getBytes();
+        };
+
+        for (const auto &code : {contracts::eosio_system_wasm(), contracts::eosio_msig_wasm()}) {
+            IR::Module serial = parse(code);
+            IR::Module parallel = parse(code);
+            wasm_validations::wasm_binary_validation(serial, true).validate();
+            wasm_validations::wasm_binary_validation(parallel, true).validate(&pool.get_executor(), 3, 0);
+            wasm_injections::wasm_binary_injection(serial).inject();
+            wasm_injections::wasm_binary_injection(parallel).inject(&pool.get_executor(), 3, 0);
+            BOOST_CHECK(serialize(serial) == serialize(parallel));
+        }
+
+        // every if with an else leaves the nesting depth one deeper, and the depth carries over from one function
+        // to the next, so only the two functions together exceed the limit
+        std::stringstream ss;
+        ss << "(module (export \"apply\" (func $apply)) (func $apply (param $0 i64) (param $1 i64) (param $2 i64)";
+        for (unsigned int i = 0; i < 600; ++i)
+            ss << "(if (i32.const 0) (then (nop)) (else (nop)))";
+        ss << ") (func $other";
+        for (unsigned int i = 0; i < 600; ++i)
+            ss << "(if (i32.const 0) (then (nop)) (else (nop)))";
+        ss << "))";
+        IR::Module nested = parse(wast_to_wasm(ss.str()));
+        BOOST_CHECK_THROW(wasm_validations::wasm_binary_validation(nested, true).validate(),
+                          eosio::chain::wasm_execution_error);
+        BOOST_CHECK_THROW(wasm_validations::wasm_binary_validation(nested, true).validate(&pool.get_executor(), 3, 0),
+                          eosio::chain::wasm_execution_error);
+        wasm_validations::wasm_binary_validation(nested, false).validate(&pool.get_executor(), 3, 0);
+
+    } FC_LOG_AND_RETHROW()
+
     BOOST_FIXTURE_TEST_CASE(lotso_globals, TESTER) try {
         produce_blocks(2);
 